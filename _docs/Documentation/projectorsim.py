@@ -0,0 +1,405 @@
+#!/usr/bin/env python3
+# Projector simulator for BeamerControl
+#
+# Answers the BenQ and Canon RS232 commands used by the firmware on a
+# pseudo terminal (default) or a real serial port, so polling and power
+# commands can be tried without a projector. The ESP is connected with an
+# USB-to-RS232 converter and --device, tools on the same PC use the PTY.
+#
+#   python3 projectorsim.py --model canon
+#   python3 projectorsim.py --model benq --device /dev/ttyUSB0 --baud 115200
+#   python3 projectorsim.py --model canon --noise 0.01 --drop 0.01 --latency 40
+#   python3 projectorsim.py --model canon --error-after 120 --record session.txt
+#
+# Only the Python 3 standard library is needed (Linux/macOS).
+
+import argparse
+import os
+import pty
+import random
+import select
+import sys
+import termios
+import time
+import tty
+
+BAUDRATES = {
+	9600: termios.B9600,
+	19200: termios.B19200,
+	38400: termios.B38400,
+	57600: termios.B57600,
+	115200: termios.B115200,
+}
+
+# Power states
+OFF = "off"
+WARMUP = "warmup"
+ON = "on"
+COOLING = "cooling"
+ERROR = "error"  # error standby, e.g. lamp or fan failure
+
+# Canon error codes (DATA01, DATA02)
+CANON_UNKNOWN_COMMAND = (0x00, 0x00)
+CANON_NOT_POSSIBLE = (0x02, 0x03)
+CANON_POWER_OFF_INHIBITED = (0x02, 0x0D)
+CANON_MODEL_CODE = 0x40
+
+
+class Projector:
+	def __init__(self, args):
+		self.args = args
+		self.state = OFF
+		self.since = time.monotonic()
+		self.blank = False
+		self.mute = False
+		self.freeze = False
+		self.lamp_hours = 1234
+		self.on_power = None  # called with True/False for every power command
+		self.decoded = None  # state the firmware decodes from the last status response
+
+	def log(self, text):
+		print("%9.3f %-7s %s" % (time.monotonic() % 100000, self.state, text), file=sys.stderr)
+
+	def update(self):
+		# Timed state changes
+		elapsed = time.monotonic() - self.since
+		if self.state == WARMUP and elapsed >= self.args.warmup:
+			self.set_state(ON)
+		elif self.state == COOLING and elapsed >= self.args.cooldown:
+			self.set_state(OFF)
+		elif self.state == ON and self.args.error_after and elapsed >= self.args.error_after:
+			self.set_state(ERROR)
+
+	def set_state(self, state):
+		self.state = state
+		self.since = time.monotonic()
+		self.log("-> " + state)
+
+	def power(self, on):
+		# Returns False if the projector is busy with the opposite transition
+		if self.on_power:
+			self.on_power(on)
+		if on:
+			if self.state in (COOLING, ERROR):
+				return False
+			if self.state == OFF:
+				self.set_state(WARMUP if self.args.warmup > 0 else ON)
+		else:
+			if self.state == WARMUP:
+				return False
+			if self.state == ON:
+				self.set_state(COOLING if self.args.cooldown > 0 else OFF)
+				self.blank = self.mute = self.freeze = False
+			elif self.state == ERROR:
+				self.set_state(OFF)
+		return True
+
+
+class BenQ(Projector):
+	# ASCII commands "*<item>=<value>#" terminated by CR, the projector
+	# echoes the command and answers on a new line
+	def __init__(self, args):
+		super().__init__(args)
+		self.line = bytearray()
+
+	def feed(self, data):
+		responses = []
+		for b in data:
+			if b == 0x0D:
+				if self.line:
+					responses.append(self.command(self.line.decode("ascii", "replace")))
+				self.line = bytearray()
+			elif len(self.line) < 64:
+				self.line.append(b)
+		return responses
+
+	def command(self, line):
+		self.log("<- %r" % line)
+		echo = (">" + line + "\r\n").encode()
+		cmd = line.strip().lower()
+		if not (cmd.startswith("*") and cmd.endswith("#") and "=" in cmd):
+			return echo + b"*Illegal format#\r\n"
+
+		item, value = cmd[1:-1].split("=", 1)
+		if item == "pow":
+			if value == "?":
+				self.decoded = OFF if self.state in (OFF, ERROR) else ON
+				return echo + ("*POW=%s#\r\n" % self.decoded.upper()).encode()
+			if value in ("on", "off"):
+				if not self.power(value == "on"):
+					return echo + b"*Block item#\r\n"
+				return echo + ("*POW=%s#\r\n" % value.upper()).encode()
+		elif item == "ltim" and value == "?":
+			return echo + ("*LTIM=%d#\r\n" % self.lamp_hours).encode()
+		elif item == "lampm" and value == "?":
+			return echo + b"*LAMPM=ECO#\r\n"
+		elif item == "sour" and value == "?":
+			if self.state != ON:
+				return echo + b"*Block item#\r\n"
+			return echo + b"*SOUR=HDMI#\r\n"
+		elif item in ("blank", "mute", "freeze"):
+			if self.state != ON:
+				return echo + b"*Block item#\r\n"
+			if value == "?":
+				return echo + ("*%s=%s#\r\n" % (item.upper(), "ON" if getattr(self, item) else "OFF")).encode()
+			if value in ("on", "off"):
+				setattr(self, item, value == "on")
+				return echo + ("*%s=%s#\r\n" % (item.upper(), value.upper())).encode()
+		return echo + b"*Unsupported item#\r\n"
+
+
+class Canon(Projector):
+	# Binary frames: ID1 ID2 00H 00H LEN DATA... CKS
+	# Responses: ID1|20H ID2 01H <model> LEN DATA... CKS, failures ID1|A0H
+	def __init__(self, args):
+		super().__init__(args)
+		self.frame = bytearray()
+
+	@staticmethod
+	def checksum(data):
+		return sum(data) & 0xFF
+
+	def response(self, id1, id2, data=b""):
+		frame = bytes([id1 | 0x20, id2, 0x01, CANON_MODEL_CODE, len(data)]) + bytes(data)
+		return frame + bytes([self.checksum(frame)])
+
+	def error(self, id1, id2, code):
+		frame = bytes([id1 | 0xA0, id2, 0x01, CANON_MODEL_CODE, 0x02, code[0], code[1]])
+		return frame + bytes([self.checksum(frame)])
+
+	def feed(self, data):
+		responses = []
+		self.frame.extend(data)
+		while len(self.frame) >= 6:
+			length = 5 + self.frame[4] + 1
+			if length > 64 or self.frame[2:4] != b"\x00\x00":
+				# Not a frame start, resync on the next byte
+				self.frame.pop(0)
+				continue
+			if len(self.frame) < length:
+				break
+			frame = bytes(self.frame[:length])
+			del self.frame[:length]
+			self.log("<- " + frame.hex(" "))
+			if self.checksum(frame[:-1]) != frame[-1]:
+				self.log("checksum wrong, ignored")
+				continue
+			responses.append(self.command(frame[0], frame[1], frame[5:-1]))
+		return responses
+
+	def status(self):
+		codes = {OFF: 0x00, WARMUP: 0x04, ON: 0x04, COOLING: 0x05, ERROR: 0x06}
+		self.decoded = OFF if self.state in (OFF, ERROR) else ON
+		data = bytearray(16)
+		data[0] = 0x02
+		data[1] = codes[self.state]
+		data[2] = 0x00 if self.state == ON else 0x01  # picture or no signal
+		data[3] = 0x01
+		data[4] = 0x01 if self.state == ON else 0xFF
+		data[5] = 0xFF
+		data[6] = int(self.blank)
+		data[7] = int(self.mute)
+		return data
+
+	def command(self, id1, id2, data):
+		if (id1, id2) == (0x00, 0xBF) and data == b"\x02":
+			return self.response(id1, id2, self.status())
+		if (id1, id2) in ((0x02, 0x00), (0x02, 0x01)):
+			on = id2 == 0x00
+			if not self.power(on):
+				return self.error(id1, id2, CANON_NOT_POSSIBLE if on else CANON_POWER_OFF_INHIBITED)
+			return self.response(id1, id2)
+		if id1 == 0x02 and id2 in (0x10, 0x11, 0x12, 0x13):
+			if self.state != ON:
+				return self.error(id1, id2, CANON_NOT_POSSIBLE)
+			if id2 in (0x10, 0x11):
+				self.blank = id2 == 0x10
+			else:
+				self.mute = id2 == 0x12
+			return self.response(id1, id2)
+		return self.error(id1, id2, CANON_UNKNOWN_COMMAND)
+
+
+def open_port(args):
+	# Returns (fd, fd to read the line settings from, name)
+	if args.device:
+		fd = os.open(args.device, os.O_RDWR | os.O_NOCTTY)
+		tty.setraw(fd)
+		attrs = termios.tcgetattr(fd)
+		attrs[4] = attrs[5] = BAUDRATES[args.baud]
+		termios.tcsetattr(fd, termios.TCSANOW, attrs)
+		return fd, None, args.device
+	master, slave = pty.openpty()
+	tty.setraw(slave)
+	attrs = termios.tcgetattr(slave)
+	attrs[4] = attrs[5] = BAUDRATES[args.baud]
+	termios.tcsetattr(slave, termios.TCSANOW, attrs)
+	# The slave stays open, so clients can come and go
+	return master, slave, os.ttyname(slave)
+
+
+def baud_mismatch(slave, args):
+	# On a PTY the baud rate is only a setting, compare it to the simulated one
+	if slave is None:
+		return False
+	speed = termios.tcgetattr(slave)[5]
+	return speed != BAUDRATES[args.baud]
+
+
+def line_baud(slave, args):
+	# Baud rate of the client for transcripts, the simulated one on real ports
+	if slave is not None:
+		speed = termios.tcgetattr(slave)[5]
+		for baud, value in BAUDRATES.items():
+			if value == speed:
+				return baud
+	return args.baud
+
+
+def garble(data):
+	# Roughly what a receiver sees with the wrong baud rate
+	return bytes(random.choice((0x00, 0x80, 0xF8, 0xFE, 0xFF, b ^ 0x55)) for b in data)
+
+
+def distort(data, args):
+	out = bytearray()
+	for b in data:
+		if random.random() < args.drop:
+			continue
+		if random.random() < args.noise:
+			out.append(random.randrange(256))
+		out.append(b)
+	return bytes(out)
+
+
+class Transcript:
+	# Serial transcript, one line per chunk:
+	#   <ms> > <baud> <hex>   sent to the projector
+	#   <ms> < <baud> <hex>   received from the projector
+	#   <ms> = <state>        state the firmware reports afterwards (on, off, unknown)
+	# Lines starting with # are comments, "# model <name>" names the protocol.
+	def __init__(self, file, model, comment=None):
+		self.file = file
+		self.start = time.monotonic()
+		self.file.write("# BeamerControl serial transcript\n# model %s\n" % model)
+		if comment:
+			self.file.write("# %s\n" % comment)
+
+	def line(self, text):
+		self.file.write("%.1f %s\n" % ((time.monotonic() - self.start) * 1000, text))
+		self.file.flush()
+
+	def data(self, direction, baud, data):
+		self.line("%s %d %s" % (direction, baud, data.hex(" ")))
+
+	def expect(self, state):
+		self.line("= " + state)
+
+
+def read_transcript(path):
+	# Returns (model, [(ms, direction, baud, bytes or state)])
+	model, entries = None, []
+	with open(path) as f:
+		for number, text in enumerate(f, 1):
+			text = text.strip()
+			if text.startswith("# model "):
+				model = text[8:].strip()
+			if not text or text.startswith("#"):
+				continue
+			fields = text.split(None, 3)
+			try:
+				if fields[1] == "=" and fields[2] in (ON, OFF, "unknown"):
+					entries.append((float(fields[0]), "=", None, fields[2]))
+				elif fields[1] in ("<", ">"):
+					entries.append((float(fields[0]), fields[1], int(fields[2]), bytes.fromhex(fields[3] if len(fields) > 3 else "")))
+				else:
+					raise ValueError("unknown direction %r" % fields[1])
+			except (IndexError, ValueError) as e:
+				raise ValueError("%s:%d: %s" % (path, number, e))
+	return model, entries
+
+
+def add_arguments(parser):
+	parser.add_argument("--model", choices=("benq", "canon"), default="canon")
+	parser.add_argument("--device", help="serial port to serve instead of a pseudo terminal")
+	parser.add_argument("--baud", type=int, choices=sorted(BAUDRATES), default=19200)
+	parser.add_argument("--state", choices=(OFF, ON), default=OFF, help="initial power state")
+	parser.add_argument("--warmup", type=float, default=30, help="warm-up time in s")
+	parser.add_argument("--cooldown", type=float, default=60, help="cool-down time in s")
+	parser.add_argument("--error-after", type=float, default=0, help="go to error standby after s switched on")
+	parser.add_argument("--latency", type=float, default=10, help="response latency in ms")
+	parser.add_argument("--jitter", type=float, default=0, help="additional random latency in ms")
+	parser.add_argument("--noise", type=float, default=0, help="probability of a random byte per response byte")
+	parser.add_argument("--drop", type=float, default=0, help="probability to drop a response byte")
+	parser.add_argument("--silent", type=float, default=0, help="probability to not answer a command at all")
+	parser.add_argument("--seed", type=int, help="random seed for reproducible runs")
+	parser.add_argument("--record", type=argparse.FileType("w"), help="write a transcript of the serial traffic")
+
+
+def create(args):
+	# Returns (projector, fd, slave fd, port name)
+	random.seed(args.seed)
+	projector = (BenQ if args.model == "benq" else Canon)(args)
+	projector.state = args.state
+	fd, slave, name = open_port(args)
+	print("%s projector on %s (%d baud)" % (args.model, name, args.baud), file=sys.stderr)
+	if args.record:
+		args.record = Transcript(args.record, args.model, "recorded with projectorsim.py")
+	return projector, fd, slave, name
+
+
+def serve(projector, fd, slave, args):
+	pending = []  # (due time, bytes, decoded state)
+	while True:
+		now = time.monotonic()
+		timeout = min([p[0] for p in pending], default=now + 0.1) - now
+		readable, _, _ = select.select([fd], [], [], max(timeout, 0))
+		projector.update()
+
+		if readable:
+			try:
+				data = os.read(fd, 256)
+			except OSError:
+				# PTY without client
+				time.sleep(0.1)
+				continue
+			if args.record:
+				args.record.data(">", line_baud(slave, args), data)
+			if baud_mismatch(slave, args):
+				data = garble(data)
+			for response in projector.feed(data):
+				decoded, projector.decoded = projector.decoded, None
+				if random.random() < args.silent:
+					projector.log("response suppressed")
+					continue
+				delay = (args.latency + random.uniform(0, args.jitter)) / 1000
+				pending.append((time.monotonic() + delay, response, decoded))
+
+		now = time.monotonic()
+		for item in [p for p in pending if p[0] <= now]:
+			pending.remove(item)
+			response = distort(item[1], args)
+			if baud_mismatch(slave, args):
+				response = garble(response)
+			projector.log("-> " + response.hex(" "))
+			os.write(fd, response)
+			if args.record:
+				args.record.data("<", line_baud(slave, args), response)
+				# Only an undisturbed status response has a known outcome
+				if item[2] and response == item[1]:
+					args.record.expect(item[2])
+
+
+def main():
+	parser = argparse.ArgumentParser(description="BenQ/Canon projector simulator")
+	add_arguments(parser)
+	args = parser.parse_args()
+	projector, fd, slave, _ = create(args)
+	serve(projector, fd, slave, args)
+
+
+if __name__ == "__main__":
+	try:
+		main()
+	except KeyboardInterrupt:
+		pass
@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+# Serial transcript replay for BeamerControl
+#
+# Plays recorded projector sessions (transcripts/*.txt, format see
+# projectorsim.Transcript) back to a board: every request of the board is
+# answered with the next recorded response, with the recorded timing, and
+# power commands of the transcript are sent to the board over MQTT. The
+# power states published by the board (<prefix>/<hostname>/status) are
+# compared with the expected ones ("=" lines) of the transcript.
+#
+#   python3 replay.py --broker 192.168.1.10 --device /dev/ttyUSB0 transcripts/canon-*.txt
+#   python3 replay.py --broker 192.168.1.10 --device /dev/ttyUSB0 --board beamercontrol.local transcripts/*.txt
+#
+# The board must use the same broker, MQTT prefix, beamer model and baud
+# rate as the transcripts. With --board the parsing times of /bench are
+# reported as well. Only the Python 3 standard library is needed.
+
+import argparse
+import base64
+import json
+import os
+import select
+import sys
+import threading
+import time
+import urllib.request
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import projectorsim  # noqa: E402
+import soak  # noqa: E402
+
+# Requests of the firmware (src/projector.cpp)
+POLL_REQUESTS = {
+	"benq": b"\r*pow=?#\r",
+	"canon": bytes.fromhex("00bf00000102c2"),
+}
+# Low priority BenQ queries the board sends behind the power query
+# (pollBenq() in src/main.cpp). They are not part of the transcripts and
+# answered at once, the board matches the replies by key.
+BENQ_ANSWERS = {
+	b"\r*sour=?#\r": b"\r\n*SOUR=HDMI#\r\n",
+	b"\r*ltim=?#\r": b"\r\n*LTIM=1234#\r\n",
+	b"\r*lampm=?#\r": b"\r\n*LAMPM=ECO#\r\n",
+	b"\r*blank=?#\r": b"\r\n*BLANK=OFF#\r\n",
+	b"\r*mute=?#\r": b"\r\n*MUTE=OFF#\r\n",
+	b"\r*freeze=?#\r": b"\r\n*FREEZE=OFF#\r\n",
+}
+POWER_COMMANDS = {
+	b"\r*pow=on#\r": "on",
+	b"\r*pow=off#\r": "off",
+	bytes.fromhex("020000000002"): "on",
+	bytes.fromhex("020100000003"): "off",
+}
+
+
+def collapse(states):
+	# Drops repetitions, the board publishes changes only
+	out = []
+	for state in states:
+		if not out or out[-1] != state:
+			out.append(state)
+	return out
+
+
+class Board:
+	def __init__(self, args):
+		self.args = args
+		self.states = []  # (time, published power state)
+		self.lock = threading.Lock()
+		self.mqtt = None
+		if args.broker:
+			host, _, port = args.broker.partition(":")
+			self.prefix = args.prefix + "/" if args.prefix else ""
+			self.mqtt = soak.MQTT(host, int(port or 1883), "replay-%d" % os.getpid(), args.mqtt_user, args.mqtt_password)
+			self.mqtt.subscribe(self.prefix + "+/status")
+			threading.Thread(target=self.mqtt.loop, args=(self.message,), daemon=True).start()
+
+	def message(self, topic, payload):
+		try:
+			status = json.loads(payload)
+			state = status.get("pwrstate")
+		except (ValueError, AttributeError):
+			return
+		if status.get("pwrcommand") == "pending":
+			# Requested state, not polled yet
+			return
+		if state:
+			with self.lock:
+				self.states.append((time.monotonic(), state))
+
+	def state(self):
+		with self.lock:
+			return self.states[-1][1] if self.states else None
+
+	def since(self, start):
+		with self.lock:
+			return [state for t, state in self.states if t >= start]
+
+	def power(self, state):
+		if self.mqtt:
+			self.mqtt.publish(self.prefix + "cmd", '{"pwrstate":"%s"}' % state)
+
+
+class Replay:
+	def __init__(self, fd, board, args):
+		self.fd = fd
+		self.board = board
+		self.args = args
+		self.received = bytearray()
+		self.poll = b""
+		self.model = None
+
+	def repeat(self, answer):
+		time.sleep(self.args.latency / 1000)
+		for data in answer:
+			os.write(self.fd, data)
+
+	def answer_queries(self):
+		if self.model != "benq":
+			return
+		for query, reply in BENQ_ANSWERS.items():
+			index = self.received.find(query)
+			while index >= 0:
+				del self.received[index:index + len(query)]
+				os.write(self.fd, reply)
+				index = self.received.find(query)
+
+	def request(self, data, answer, timeout):
+		# Waits for data from the board and returns what was received instead
+		# of it, None on timeout. Polls in between (e.g. before a power command
+		# over MQTT is executed) are answered with the last answer.
+		end = time.monotonic() + timeout
+		while True:
+			self.answer_queries()
+			if self.received.startswith(data):
+				break
+			if self.poll != data and self.received.startswith(self.poll):
+				del self.received[:len(self.poll)]
+				self.repeat(answer)
+				continue
+			if len(self.received) >= max(len(data), len(self.poll)):
+				break
+			readable, _, _ = select.select([self.fd], [], [], max(end - time.monotonic(), 0))
+			if not readable:
+				return None
+			try:
+				self.received.extend(os.read(self.fd, 256))
+			except OSError:
+				time.sleep(0.1)
+		request = bytes(self.received[:len(data)])
+		del self.received[:len(data)]
+		return request
+
+	def run(self, path, model, entries):
+		self.poll = POLL_REQUESTS[model]
+		self.model = model
+		expected = []
+		sent = polls = 0
+		answer = []  # last answer to a poll, repeated at the end
+		polling = False
+		anchor = None  # (time, transcript ms) of the last request
+		initial = self.board.state()
+		start = time.monotonic()
+
+		for ms, direction, baud, data in entries:
+			if direction == "=":
+				expected.append(data)
+			elif direction == ">":
+				if data in POWER_COMMANDS:
+					self.board.power(POWER_COMMANDS[data])
+				request = self.request(data, answer, self.args.timeout)
+				if request is None:
+					print("%s: no request from the board within %.0f s" % (path, self.args.timeout))
+					return False
+				if request != data:
+					print("%s: %.1f ms: board sent %s instead of %s" % (path, ms, request.hex(" "), data.hex(" ")))
+				anchor = (time.monotonic(), ms)
+				polling = data == self.poll
+				if polling:
+					polls += 1
+					answer = []
+			else:
+				if anchor:
+					time.sleep(max(anchor[0] + (ms - anchor[1]) / 1000 - time.monotonic(), 0))
+				os.write(self.fd, data)
+				sent += len(data)
+				if polling:
+					answer.append(data)
+
+		# Keep the last state until the board has published it
+		end = time.monotonic() + self.args.settle
+		while time.monotonic() < end:
+			if self.request(self.poll, answer, end - time.monotonic()) is not None:
+				self.repeat(answer)
+		elapsed = time.monotonic() - start
+
+		print("%s: %d polls, %d bytes in %.1f s" % (path, polls, sent, elapsed))
+		if not self.board.mqtt:
+			print("  expected: %s" % " ".join(collapse(expected)))
+			return True
+		want = collapse([initial] + expected)[1:]
+		got = collapse([initial] + self.board.since(start))[1:]
+		if want != got:
+			print("  FAIL expected %s, board published %s" % (" ".join(want) or "-", " ".join(got) or "-"))
+			return False
+		print("  ok %s" % (" ".join(want) or "-"))
+		return True
+
+
+def bench(args):
+	# Parsing time of the firmware for the fixed responses of /bench
+	request = urllib.request.Request("http://%s/bench" % args.board)
+	token = base64.b64encode(("%s:%s" % (args.admin_user, args.admin_password)).encode()).decode()
+	request.add_header("Authorization", "Basic " + token)
+	with urllib.request.urlopen(request, timeout=60) as response:
+		results = json.loads(response.read().decode(errors="replace"))
+	sizes = {"canon_response": 22, "benq_response": 20}
+	for result in results["results"]:
+		if result["name"] in sizes and result["avg_ns"]:
+			size = sizes[result["name"]]
+			print("%s: %d bytes in %.1f us avg (%.1f us max), %.2f MB/s" % (
+				result["name"], size, result["avg_ns"] / 1000, result["max_ns"] / 1000, size * 1000 / result["avg_ns"]))
+
+
+def main():
+	parser = argparse.ArgumentParser(description="BeamerControl serial transcript replay")
+	parser.add_argument("transcripts", nargs="+", help="transcript files")
+	parser.add_argument("--device", help="serial port to replay on instead of a pseudo terminal")
+	parser.add_argument("--broker", help="MQTT broker host[:port], without only the expected states are printed")
+	parser.add_argument("--mqtt-user")
+	parser.add_argument("--mqtt-password")
+	parser.add_argument("--prefix", default="beamercontrol", help="MQTT prefix of the board")
+	parser.add_argument("--board", help="hostname or IP of the BeamerControl to report /bench")
+	parser.add_argument("--admin-user", default="admin")
+	parser.add_argument("--admin-password", default="admin")
+	parser.add_argument("--timeout", type=float, default=10, help="max. wait for a request of the board in s")
+	parser.add_argument("--settle", type=float, default=3, help="time to hold the last state in s")
+	parser.add_argument("--latency", type=float, default=10, help="latency of the repeated last answer in ms")
+	args = parser.parse_args()
+
+	transcripts = [(path, projectorsim.read_transcript(path)) for path in args.transcripts]
+	for path, (model, _) in transcripts:
+		if model not in POLL_REQUESTS:
+			parser.error("%s: unknown model %r" % (path, model))
+	bauds = {baud for _, (_, entries) in transcripts for _, direction, baud, _ in entries if direction == ">"}
+	args.baud = min(bauds, default=19200)
+	if len(bauds) > 1:
+		print("transcripts with different baud rates, port set to %d" % args.baud, file=sys.stderr)
+	fd, _, name = projectorsim.open_port(args)
+	print("replaying on %s (%d baud)" % (name, args.baud), file=sys.stderr)
+
+	board = Board(args)
+	replay = Replay(fd, board, args)
+	failed = [path for path, (model, entries) in transcripts if not replay.run(path, model, entries)]
+	if args.board:
+		bench(args)
+	if failed:
+		print("%d of %d transcripts failed" % (len(failed), len(transcripts)))
+		sys.exit(1)
+
+
+if __name__ == "__main__":
+	try:
+		main()
+	except KeyboardInterrupt:
+		pass
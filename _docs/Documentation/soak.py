@@ -0,0 +1,453 @@
+#!/usr/bin/env python3
+# Load and soak test for BeamerControl
+#
+# Drives a board over MQTT (<prefix>/cmd) and the REST API while the
+# projector simulator (projectorsim.py, same directory) answers on the
+# serial line, and dashboards are simulated by fetching the status page.
+# Command-to-actuation latency is measured from sending a command to the
+# power frame arriving at the simulator. /metrics is scraped for the heap
+# and loop jitter trend.
+#
+#   mosquitto -p 1883 &
+#   python3 soak.py --board 192.168.1.50 --broker 192.168.1.10 \
+#       --device /dev/ttyUSB0 --duration 4h --mqtt-rate 200 --api-rate 20 --dashboard-rate 30
+#
+# The board must use the same broker and MQTT prefix, and the beamer model
+# and baud rate of the simulator (--model, --baud). Only the Python 3
+# standard library is needed.
+#
+# Without board and broker, --host runs the host build of the projector
+# handling (test/host/beamerhost, built with make) against the simulator
+# and sends the commands on its stdin at --mqtt-rate. With --max-dropped
+# and --max-p99 the exit code is 1 if the run failed, so it can run
+# unattended, e.g. in CI:
+#
+#   python3 soak.py --host --duration 30m --mqtt-rate 300 --max-dropped 0 --max-p99 500
+
+import argparse
+import base64
+import csv
+import os
+import random
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import time
+import urllib.request
+from collections import deque
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+HOST_DIR = os.path.join(HERE, "..", "..", "test", "host")
+sys.path.insert(0, HERE)
+import projectorsim  # noqa: E402
+
+
+class MQTT:
+	# Minimal MQTT 3.1.1 client, QoS 0 only
+	def __init__(self, host, port, client_id, user=None, password=None, keepalive=30):
+		self.sock = socket.create_connection((host, port), timeout=10)
+		self.lock = threading.Lock()
+		self.keepalive = keepalive
+		flags = 0x02  # clean session
+		payload = self.string(client_id)
+		if user:
+			flags |= 0x80
+			payload += self.string(user)
+			if password:
+				flags |= 0x40
+				payload += self.string(password)
+		header = self.string("MQTT") + bytes([4, flags]) + struct.pack(">H", keepalive)
+		self.send(0x10, header + payload)
+		packet, body = self.read()
+		if packet != 0x20 or body[1] != 0:
+			raise ConnectionError("MQTT connect refused (%r)" % body)
+		self.sock.settimeout(None)
+
+	@staticmethod
+	def string(text):
+		data = text.encode()
+		return struct.pack(">H", len(data)) + data
+
+	def send(self, header, body):
+		length = bytearray()
+		n = len(body)
+		while True:
+			b = n % 128
+			n //= 128
+			length.append(b | (0x80 if n else 0))
+			if not n:
+				break
+		with self.lock:
+			self.sock.sendall(bytes([header]) + bytes(length) + body)
+
+	def recv(self, n):
+		data = b""
+		while len(data) < n:
+			chunk = self.sock.recv(n - len(data))
+			if not chunk:
+				raise ConnectionError("MQTT connection closed")
+			data += chunk
+		return data
+
+	def read(self):
+		header = self.recv(1)[0]
+		length, shift = 0, 0
+		while True:
+			b = self.recv(1)[0]
+			length |= (b & 0x7F) << shift
+			shift += 7
+			if not b & 0x80:
+				break
+		return header & 0xF0, self.recv(length)
+
+	def publish(self, topic, payload):
+		self.send(0x30, self.string(topic) + payload.encode())
+
+	def subscribe(self, topic):
+		self.send(0x82, struct.pack(">H", 1) + self.string(topic) + b"\x00")
+
+	def loop(self, callback):
+		# Runs in its own thread, calls callback(topic, payload) for messages
+		threading.Thread(target=self.ping, daemon=True).start()
+		while True:
+			packet, body = self.read()
+			if packet == 0x30:
+				n = struct.unpack(">H", body[:2])[0]
+				callback(body[2:2 + n].decode(errors="replace"), body[2 + n:])
+
+	def ping(self):
+		while True:
+			time.sleep(self.keepalive / 2)
+			self.send(0xC0, b"")
+
+
+class Host:
+	# Host build of the projector handling on the simulator's pseudo terminal
+	def __init__(self, path, port, args, on_stats):
+		if path == HOST_DIR:
+			subprocess.run(["make", "-C", HOST_DIR, "beamerhost"], check=True, stdout=subprocess.DEVNULL)
+			path = os.path.join(HOST_DIR, "beamerhost")
+		self.process = subprocess.Popen([path, port, args.model, str(args.baud)],
+										stdin=subprocess.PIPE, stdout=subprocess.PIPE, text=True)
+		self.lock = threading.Lock()
+		self.on_stats = on_stats
+		threading.Thread(target=self.read, daemon=True).start()
+
+	def read(self):
+		# "stats <ms> <polls> <failed polls> <allocations> <max. lateness ms>"
+		for line in self.process.stdout:
+			fields = line.split()
+			if fields and fields[0] == "stats":
+				self.on_stats(*[int(f) for f in fields[2:6]])
+
+	def send(self, command):
+		with self.lock:
+			self.process.stdin.write(command + "\n")
+			self.process.stdin.flush()
+
+	def power(self, on):
+		self.send("power on" if on else "power off")
+
+	def close(self):
+		try:
+			self.send("quit")
+			self.process.wait(timeout=5)
+		except (OSError, subprocess.TimeoutExpired):
+			self.process.kill()
+
+
+def percentile(values, p):
+	if not values:
+		return float("nan")
+	values = sorted(values)
+	return values[min(len(values) - 1, int(round(p / 100 * (len(values) - 1))))]
+
+
+def slope(points):
+	# Least squares slope of (x, y) points in y per x
+	if len(points) < 2:
+		return 0.0
+	n = len(points)
+	mx = sum(x for x, _ in points) / n
+	my = sum(y for _, y in points) / n
+	den = sum((x - mx) ** 2 for x, _ in points)
+	return sum((x - mx) * (y - my) for x, y in points) / den if den else 0.0
+
+
+def duration(text):
+	units = {"s": 1, "m": 60, "h": 3600}
+	if text[-1] in units:
+		return float(text[:-1]) * units[text[-1]]
+	return float(text)
+
+
+class Soak:
+	def __init__(self, args):
+		self.args = args
+		self.lock = threading.Lock()
+		self.start = time.monotonic()
+		self.outstanding = {True: deque(), False: deque()}  # power on/off -> (sent, source)
+		self.latency = {}  # source -> [s]
+		self.sent = {}
+		self.dropped = {}
+		self.http_errors = {}
+		self.status_messages = 0
+		self.samples = []  # (t, heap, max block, loop avg us, loop max lateness ms)
+		self.host_samples = []  # (t, polls, failed polls, allocations, max poll lateness ms)
+		self.next_power = {}
+
+	def count(self, table, key, n=1):
+		with self.lock:
+			table[key] = table.get(key, 0) + n
+
+	# Commands
+
+	def command(self, source, send):
+		# Alternates on/off per source, every command must reach the projector
+		on = self.next_power.get(source, True)
+		self.next_power[source] = not on
+		with self.lock:
+			self.outstanding[on].append((time.monotonic(), source))
+		self.count(self.sent, source)
+		try:
+			send(on)
+		except Exception as e:
+			self.count(self.http_errors, "%s: %s" % (source, type(e).__name__))
+
+	def actuated(self, on):
+		# Called by the simulator for every power frame
+		now = time.monotonic()
+		with self.lock:
+			if self.outstanding[on]:
+				sent, source = self.outstanding[on].popleft()
+				self.latency.setdefault(source, []).append(now - sent)
+
+	def expire(self):
+		now = time.monotonic()
+		with self.lock:
+			for queue in self.outstanding.values():
+				while queue and now - queue[0][0] > self.args.timeout:
+					_, source = queue.popleft()
+					self.dropped[source] = self.dropped.get(source, 0) + 1
+
+	# HTTP
+
+	def http(self, path, user=None, password=None):
+		request = urllib.request.Request("http://%s%s" % (self.args.board, path))
+		if user:
+			token = base64.b64encode(("%s:%s" % (user, password)).encode()).decode()
+			request.add_header("Authorization", "Basic " + token)
+		with urllib.request.urlopen(request, timeout=10) as response:
+			return response.read().decode(errors="replace")
+
+	def api(self, on):
+		self.http("/api/on" if on else "/api/off", self.args.api_user, self.args.api_password)
+
+	def dashboard(self):
+		try:
+			self.http("/")
+		except Exception as e:
+			self.count(self.http_errors, "/: %s" % type(e).__name__)
+
+	def scrape(self):
+		try:
+			text = self.http("/metrics")
+		except Exception as e:
+			self.count(self.http_errors, "/metrics: %s" % type(e).__name__)
+			return
+		values = {}
+		lateness = 0
+		for line in text.splitlines():
+			if line.startswith("#") or " " not in line:
+				continue
+			name, value = line.rsplit(" ", 1)
+			if name.startswith("beamercontrol_task_max_lateness_milliseconds"):
+				lateness = max(lateness, float(value))
+			values[name] = float(value)
+		loop_count = values.get("beamercontrol_loop_time_microseconds_count", 0)
+		loop_avg = values.get("beamercontrol_loop_time_microseconds_sum", 0) / loop_count if loop_count else 0
+		sample = (time.monotonic() - self.start, values.get("beamercontrol_heap_free_bytes", 0),
+				  values.get("beamercontrol_heap_max_block_bytes", 0), loop_avg, lateness)
+		with self.lock:
+			self.samples.append(sample)
+		if self.args.csv:
+			self.args.csv.writerow(["%.1f" % sample[0]] + [int(v) for v in sample[1:]])
+			self.args.csv_file.flush()
+
+	def host_stats(self, polls, failed, allocations, lateness):
+		sample = (time.monotonic() - self.start, polls, failed, allocations, lateness)
+		with self.lock:
+			self.host_samples.append(sample)
+		if self.args.csv:
+			self.args.csv.writerow(["%.1f" % sample[0]] + list(sample[1:]))
+			self.args.csv_file.flush()
+
+	# Report
+
+	def report(self, final=False):
+		self.expire()
+		with self.lock:
+			elapsed = time.monotonic() - self.start
+			print("\n== %s after %.0f s ==" % ("Result" if final else "Status", elapsed))
+			print("%-10s %6s %6s %6s %8s %8s %8s %8s" % ("source", "sent", "ok", "drop", "p50 ms", "p90 ms", "p99 ms", "max ms"))
+			for source in sorted(self.sent):
+				lat = self.latency.get(source, [])
+				print("%-10s %6d %6d %6d %8.0f %8.0f %8.0f %8.0f" % (
+					source, self.sent[source], len(lat), self.dropped.get(source, 0),
+					percentile(lat, 50) * 1000, percentile(lat, 90) * 1000, percentile(lat, 99) * 1000,
+					max(lat, default=float("nan")) * 1000))
+			if self.samples:
+				heap = [(t / 3600, h) for t, h, _, _, _ in self.samples]
+				print("heap: first %d, last %d, min %d bytes, trend %+.0f bytes/h, min max block %d bytes" % (
+					heap[0][1], heap[-1][1], min(h for _, h in heap), slope(heap),
+					min(s[2] for s in self.samples)))
+				print("loop: avg pass %.0f us, max task lateness %d ms" % (self.samples[-1][3], max(s[4] for s in self.samples)))
+			if self.host_samples:
+				first, last = self.host_samples[0], self.host_samples[-1]
+				allocations = [(t / 3600, a) for t, _, _, a, _ in self.host_samples]
+				print("polls: %d, failed %d, max poll lateness %d ms" % (last[1], last[2], max(s[4] for s in self.host_samples)))
+				print("allocations: %d since the first sample, trend %+.0f per hour" % (last[3] - first[3], slope(allocations)))
+			if not self.args.host:
+				print("status messages: %d" % self.status_messages)
+			for error, n in sorted(self.http_errors.items()):
+				print("error %s: %d" % (error, n))
+		sys.stdout.flush()
+
+
+	def verdict(self):
+		# Reasons the run failed the --max-dropped and --max-p99 limits
+		failures = []
+		with self.lock:
+			sent = sum(self.sent.values())
+			dropped = sum(self.dropped.values())
+			latency = [value for values in self.latency.values() for value in values]
+		if self.args.max_dropped is not None and sent and dropped / sent > self.args.max_dropped:
+			failures.append("%d of %d commands dropped" % (dropped, sent))
+		if self.args.max_p99 is not None:
+			if not latency:
+				failures.append("no command actuated")
+			elif percentile(latency, 99) * 1000 > self.args.max_p99:
+				failures.append("p99 latency %.0f ms" % (percentile(latency, 99) * 1000))
+		return failures
+
+
+def every(interval, function, stop):
+	# Calls function with random spacing averaging interval seconds
+	def run():
+		while not stop.is_set():
+			if stop.wait(random.expovariate(1 / interval)):
+				break
+			function()
+	thread = threading.Thread(target=run, daemon=True)
+	thread.start()
+	return thread
+
+
+def main():
+	parser = argparse.ArgumentParser(description="BeamerControl load and soak test")
+	parser.add_argument("--board", help="hostname or IP of the BeamerControl")
+	parser.add_argument("--broker", help="MQTT broker host[:port]")
+	parser.add_argument("--host", nargs="?", const=HOST_DIR, help="run the host build instead of a board (default test/host/beamerhost)")
+	parser.add_argument("--mqtt-user")
+	parser.add_argument("--mqtt-password")
+	parser.add_argument("--prefix", default="beamercontrol", help="MQTT prefix of the board")
+	parser.add_argument("--api-user", default="api")
+	parser.add_argument("--api-password", default="api")
+	parser.add_argument("--duration", type=duration, default=3600, help="run time, e.g. 600, 30m or 4h")
+	parser.add_argument("--mqtt-rate", type=float, default=60, help="MQTT commands per minute (host commands with --host)")
+	parser.add_argument("--api-rate", type=float, default=10, help="REST API calls per minute")
+	parser.add_argument("--dashboard-rate", type=float, default=30, help="status page requests per minute")
+	parser.add_argument("--scrape-interval", type=float, default=10, help="/metrics interval in s")
+	parser.add_argument("--report-interval", type=float, default=300, help="interim report interval in s")
+	parser.add_argument("--timeout", type=float, default=10, help="command counts as dropped after s")
+	parser.add_argument("--csv", type=argparse.FileType("w"), help="write the /metrics samples to a CSV file")
+	parser.add_argument("--max-dropped", type=float, help="fail if more than this fraction of the commands is dropped")
+	parser.add_argument("--max-p99", type=float, help="fail if the p99 command latency is above ms")
+	projectorsim.add_arguments(parser)
+	parser.set_defaults(warmup=0, cooldown=0, latency=5)
+	args = parser.parse_args()
+	if not args.host and not (args.board and args.broker):
+		parser.error("--board and --broker are needed without --host")
+	if args.csv:
+		args.csv_file = args.csv
+		args.csv = csv.writer(args.csv_file)
+		if args.host:
+			args.csv.writerow(["time_s", "polls", "failed_polls", "allocations", "max_lateness_ms"])
+		else:
+			args.csv.writerow(["time_s", "heap_free", "heap_max_block", "loop_avg_us", "max_lateness_ms"])
+
+	soak = Soak(args)
+
+	# Projector simulator
+	projector, fd, slave, port = projectorsim.create(args)
+	projector.log = lambda text: None
+	projector.on_power = soak.actuated
+	threading.Thread(target=projectorsim.serve, args=(projector, fd, slave, args), daemon=True).start()
+
+	stop = threading.Event()
+	if args.host:
+		host = Host(args.host, port, args, soak.host_stats)
+		if args.mqtt_rate > 0:
+			every(60 / args.mqtt_rate, lambda: soak.command("host", host.power), stop)
+
+		def scrape():
+			host.send("stats")
+	else:
+		scrape = soak.scrape
+		start_board(soak, args, stop)
+
+	end = time.monotonic() + args.duration
+	next_scrape = next_report = time.monotonic()
+	try:
+		while time.monotonic() < end:
+			now = time.monotonic()
+			if now >= next_scrape:
+				scrape()
+				next_scrape = now + args.scrape_interval
+			if now >= next_report + args.report_interval:
+				soak.report()
+				next_report = now
+			time.sleep(0.5)
+	except KeyboardInterrupt:
+		pass
+	stop.set()
+	time.sleep(args.timeout)  # let the last commands arrive
+	if args.host:
+		scrape()
+		time.sleep(0.5)
+		host.close()
+	soak.report(final=True)
+	failures = soak.verdict()
+	for failure in failures:
+		print("FAIL: " + failure)
+	sys.exit(1 if failures else 0)
+
+
+def start_board(soak, args, stop):
+	# MQTT commands, REST API calls and dashboards against a board
+	host, _, port = args.broker.partition(":")
+	prefix = args.prefix + "/" if args.prefix else ""
+	mqtt = MQTT(host, int(port or 1883), "soak-%d" % os.getpid(), args.mqtt_user, args.mqtt_password)
+
+	def message(topic, payload):
+		if topic.endswith("/status"):
+			soak.status_messages += 1
+
+	mqtt.subscribe(prefix + "+/status")
+	threading.Thread(target=mqtt.loop, args=(message,), daemon=True).start()
+
+	def mqtt_command(on):
+		mqtt.publish(prefix + "cmd", '{"pwrstate":"%s"}' % ("on" if on else "off"))
+
+	if args.mqtt_rate > 0:
+		every(60 / args.mqtt_rate, lambda: soak.command("mqtt", mqtt_command), stop)
+	if args.api_rate > 0:
+		every(60 / args.api_rate, lambda: soak.command("api", soak.api), stop)
+	if args.dashboard_rate > 0:
+		every(60 / args.dashboard_rate, soak.dashboard, stop)
+
+
+if __name__ == "__main__":
+	main()
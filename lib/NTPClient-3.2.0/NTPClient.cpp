@@ -48,6 +48,16 @@ NTPClient::NTPClient(UDP& udp, const char* poolServerName, long timeOffset, unsi
   this->_updateInterval = updateInterval;
 }
 
+void NTPClient::setClock(MillisFunction millisFunction, DelayFunction delayFunction) {
+  this->_millis = millisFunction;
+  this->_delay  = delayFunction;
+}
+
+void NTPClient::setResolver(ResolveFunction resolveFunction) {
+  this->_resolve        = resolveFunction;
+  this->_serverResolved = false;
+}
+
 void NTPClient::begin() {
   this->begin(NTP_DEFAULT_LOCAL_PORT);
 }
@@ -65,46 +75,178 @@ bool NTPClient::forceUpdate() {
     Serial.println("Update from NTP Server");
   #endif
 
+  if (!this->_udpSetup) this->begin();
+
+  if (!this->resolveServer(this->_millis())) return false;
   this->sendNTPPacket();
 
   // Wait till data is there or timeout...
-  byte timeout = 0;
-  int cb = 0;
   do {
-    delay ( 10 );
-    cb = this->_udp->parsePacket();
-    if (timeout > 100) return false; // timeout after 1000 ms
-    timeout++;
-  } while (cb == 0);
+    this->_delay(10);
+    if (this->readNTPPacket(this->_millis())) return true;
+  } while (this->_millis() - this->_requestSentAt < NTP_REQUEST_TIMEOUT);
+
+  this->_requestPending = false;
+  this->_failedRequests++;
+  this->nextServer();
+  return false;
+}
+
+bool NTPClient::update() {
+  unsigned long now = this->_millis();
+
+  if (this->_requestPending) {
+    if (this->readNTPPacket(now)) return true;
+    if (now - this->_requestSentAt < NTP_REQUEST_TIMEOUT) return true;  // Still waiting
+
+    #ifdef DEBUG_NTPClient
+      Serial.println("NTP request timed out");
+    #endif
+    this->_requestPending = false;
+    this->_failedRequests++;
+    this->nextServer();
+    return false;
+  }
+
+  bool due = !this->_timeSet || (now - this->_lastUpdate >= this->_updateInterval);
+  bool retryWait = (this->_lastAttempt != 0) && (now - this->_lastAttempt < NTP_RETRY_INTERVAL);
+  if (due && !retryWait) {
+    if (!this->_udpSetup) this->begin();                         // setup the UDP client if needed
+    if (this->resolveServer(now)) this->sendNTPPacket();
+  }
+  return true;
+}
 
-  this->_lastUpdate = millis() - (10 * (timeout + 1)); // Account for delay in reading the time
+bool NTPClient::readNTPPacket(unsigned long receivedAt) {
+  int cb = this->_udp->parsePacket();
+  if (cb == 0) return false;
+  if (cb < NTP_PACKET_SIZE) {
+    this->_udp->flush();
+    return false;
+  }
 
   this->_udp->read(this->_packetBuffer, NTP_PACKET_SIZE);
 
-  unsigned long highWord = word(this->_packetBuffer[40], this->_packetBuffer[41]);
-  unsigned long lowWord = word(this->_packetBuffer[42], this->_packetBuffer[43]);
-  // combine the four bytes (two words) into a long integer
-  // this is NTP time (seconds since Jan 1 1900):
-  unsigned long secsSince1900 = highWord << 16 | lowWord;
+  // Only accept a server response (mode 4) to our last request, stratum 0 is a kiss-o'-death
+  uint32_t origin = ((uint32_t)this->_packetBuffer[28] << 24) | ((uint32_t)this->_packetBuffer[29] << 16) |
+                    ((uint32_t)this->_packetBuffer[30] << 8) | this->_packetBuffer[31];
+  if ((this->_packetBuffer[0] & 0x07) != 4 || this->_packetBuffer[1] == 0 || origin != this->_requestNonce) {
+    return false;
+  }
+
+  // Server receive (T2) and transmit (T3) timestamps in ms since 1970
+  unsigned long long timestamps[2];
+  for (uint8_t t = 0; t < 2; t++) {
+    const byte* p = this->_packetBuffer + 32 + 8 * t;
+    unsigned long long secs = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    unsigned long long frac = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 8) | p[7];
+    timestamps[t] = (secs - SEVENZYYEARS) * 1000ULL + ((frac * 1000ULL) >> 32);
+  }
+
+  // Round trip without the processing time on the server, half of it is the way back
+  long serverTime = (long)(timestamps[1] - timestamps[0]);
+  long roundTrip = (long)(receivedAt - this->_requestSentAt) - serverTime;
+  if (roundTrip < 0) roundTrip = 0;
+  unsigned long long epochMs = timestamps[1] + roundTrip / 2;
+
+  if (this->_timeSet) {
+    long correction = (long)(epochMs - this->localEpochMillis(receivedAt));
+    unsigned long elapsed = receivedAt - this->_lastUpdate;
+    // Only learn from regular intervals, a large step means the server or the network misbehaved
+    if (elapsed >= 10000 && correction > -1000 && correction < 1000) {
+      long residual = (long)(((long long)correction * 1000000LL) / (long long)elapsed);
+      this->_driftPPM += residual / 2;
+      if (this->_driftPPM > NTP_MAX_DRIFT_PPM) this->_driftPPM = NTP_MAX_DRIFT_PPM;
+      if (this->_driftPPM < -NTP_MAX_DRIFT_PPM) this->_driftPPM = -NTP_MAX_DRIFT_PPM;
+    }
+    this->_lastCorrection = correction;
+  }
 
-  this->_currentEpoc = secsSince1900 - SEVENZYYEARS;
+  this->_currentEpocMs = epochMs;
+  this->_lastUpdate = receivedAt;
+  this->_lastRoundTrip = roundTrip;
+  this->_lastAttempt = 0;
+  this->_timeSet = true;
+  this->_requestPending = false;
 
   return true;
 }
 
-bool NTPClient::update() {
-  if ((millis() - this->_lastUpdate >= this->_updateInterval)     // Update after _updateInterval
-    || this->_lastUpdate == 0) {                                // Update if there was no update yet.
-    if (!this->_udpSetup) this->begin();                         // setup the UDP client if needed
-    return this->forceUpdate();
+// Looks up the address of the current server unless it is cached, false while none is known
+bool NTPClient::resolveServer(unsigned long now) {
+  if (!this->_resolve || this->_serverResolved) return true;
+  if (this->_lookupBackoff != 0 && now - this->_lookupFailedAt < this->_lookupBackoff) return false;
+
+  if (this->_resolve(this->_poolServerName, this->_serverIP)) {
+    this->_serverResolved = true;
+    this->_lookupBackoff  = 0;
+    return true;
   }
-  return true;
+
+  #ifdef DEBUG_NTPClient
+    Serial.println("NTP server lookup failed");
+  #endif
+  this->_failedLookups++;
+  this->_lookupFailedAt = this->_millis();  // The lookup itself may have taken a while
+  this->_lookupBackoff  = this->_lookupBackoff == 0 ? NTP_RETRY_INTERVAL : this->_lookupBackoff * 2;
+  if (this->_lookupBackoff > NTP_MAX_LOOKUP_BACKOFF) this->_lookupBackoff = NTP_MAX_LOOKUP_BACKOFF;
+  this->nextServer();
+  return false;
+}
+
+// Called after a failure, the address of the (next) server is looked up again
+void NTPClient::nextServer() {
+  this->_serverResolved = false;
+  if (this->_serverCount > 1) {
+    this->_serverIndex = (this->_serverIndex + 1) % this->_serverCount;
+    this->_poolServerName = this->_serverNames[this->_serverIndex];
+  }
+}
+
+unsigned long long NTPClient::localEpochMillis(unsigned long now) const {
+  unsigned long elapsed = now - this->_lastUpdate;
+  return this->_currentEpocMs + elapsed + ((long long)elapsed * this->_driftPPM) / 1000000LL;
+}
+
+unsigned long long NTPClient::getEpochMillis() const {
+  return this->_timeOffset * 1000LL + // User offset
+         this->localEpochMillis(this->_millis()); // Epoc returned by the NTP server and time since last update
 }
 
 unsigned long NTPClient::getEpochTime() const {
-  return this->_timeOffset + // User offset
-         this->_currentEpoc + // Epoc returned by the NTP server
-         ((millis() - this->_lastUpdate) / 1000); // Time since last update
+  return this->getEpochMillis() / 1000;
+}
+
+bool NTPClient::isTimeSet() const {
+  return this->_timeSet;
+}
+
+unsigned long NTPClient::getLastUpdateAge() const {
+  return this->_millis() - this->_lastUpdate;
+}
+
+long NTPClient::getDriftPPM() const {
+  return this->_driftPPM;
+}
+
+long NTPClient::getLastCorrection() const {
+  return this->_lastCorrection;
+}
+
+unsigned long NTPClient::getLastRoundTrip() const {
+  return this->_lastRoundTrip;
+}
+
+unsigned long NTPClient::getFailedRequests() const {
+  return this->_failedRequests;
+}
+
+unsigned long NTPClient::getFailedLookups() const {
+  return this->_failedLookups;
+}
+
+const char* NTPClient::getServerName() const {
+  return this->_poolServerName;
 }
 
 int NTPClient::getDay() const {
@@ -183,6 +325,19 @@ void NTPClient::setUpdateInterval(unsigned long updateInterval) {
 
 void NTPClient::setPoolServerName(const char* poolServerName) {
     this->_poolServerName = poolServerName;
+    this->_serverCount    = 0;
+    this->_serverResolved = false;
+}
+
+void NTPClient::setPoolServerNames(const char* const* serverNames, uint8_t count) {
+    if (count > NTP_MAX_SERVERS) count = NTP_MAX_SERVERS;
+    for (uint8_t i = 0; i < count; i++) {
+      this->_serverNames[i] = serverNames[i];
+    }
+    this->_serverCount    = count;
+    this->_serverIndex    = 0;
+    if (count > 0) this->_poolServerName = serverNames[0];
+    this->_serverResolved = false;
 }
 
 void NTPClient::sendNTPPacket() {
@@ -199,10 +354,24 @@ void NTPClient::sendNTPPacket() {
   this->_packetBuffer[13]  = 0x4E;
   this->_packetBuffer[14]  = 49;
   this->_packetBuffer[15]  = 52;
+  // Transmit timestamp is only used as nonce, the server echoes it as originate timestamp
+  this->_requestNonce      = micros() ^ (this->_requestNonce << 7);
+  this->_packetBuffer[44]  = this->_requestNonce >> 24;
+  this->_packetBuffer[45]  = this->_requestNonce >> 16;
+  this->_packetBuffer[46]  = this->_requestNonce >> 8;
+  this->_packetBuffer[47]  = this->_requestNonce;
 
   // all NTP fields have been given values, now
   // you can send a packet requesting a timestamp:
-  this->_udp->beginPacket(this->_poolServerName, 123); //NTP requests are to port 123
+  if (this->_resolve) {
+    this->_udp->beginPacket(this->_serverIP, 123);      // NTP requests are to port 123
+  } else {
+    this->_udp->beginPacket(this->_poolServerName, 123);
+  }
   this->_udp->write(this->_packetBuffer, NTP_PACKET_SIZE);
   this->_udp->endPacket();
+
+  this->_requestSentAt  = this->_millis();
+  this->_lastAttempt    = this->_requestSentAt;
+  this->_requestPending = true;
 }
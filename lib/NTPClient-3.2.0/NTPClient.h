@@ -7,25 +7,65 @@
 #define SEVENZYYEARS 2208988800UL
 #define NTP_PACKET_SIZE 48
 #define NTP_DEFAULT_LOCAL_PORT 1337
+#define NTP_REQUEST_TIMEOUT 1000   // In ms, waiting time for a response before the next server is asked
+#define NTP_RETRY_INTERVAL 5000    // In ms, waiting time before the next request after a failed one
+#define NTP_MAX_DRIFT_PPM 2000     // Limit of the estimated local clock drift
+#define NTP_MAX_LOOKUP_BACKOFF 300000 // In ms, longest wait before the next lookup after failed ones
+#define NTP_MAX_SERVERS 4
 #define LEAP_YEAR(Y) ((Y > 0) && !(Y % 4) && ((Y % 100) || !(Y % 400)))
 
 class NTPClient {
+  public:
+    typedef unsigned long (*MillisFunction)();
+    typedef void (*DelayFunction)(unsigned long ms);
+    typedef bool (*ResolveFunction)(const char* host, IPAddress& ip);
+
   private:
     UDP*          _udp;
+    MillisFunction _millis        = defaultMillis;
+    DelayFunction _delay          = defaultDelay;
+    ResolveFunction _resolve      = nullptr;
     bool          _udpSetup       = false;
 
     const char*   _poolServerName = "pool.ntp.org"; // Default time server
+    const char*   _serverNames[NTP_MAX_SERVERS];    // Fallback list, empty if only _poolServerName is used
+    uint8_t       _serverCount    = 0;
+    uint8_t       _serverIndex    = 0;
     int           _port           = NTP_DEFAULT_LOCAL_PORT;
+
+    IPAddress     _serverIP;                // Address of _poolServerName, if resolved
+    bool          _serverResolved = false;
+    unsigned long _lookupFailedAt = 0;      // In ms
+    unsigned long _lookupBackoff  = 0;      // In ms, 0 after a successful lookup
+    unsigned long _failedLookups  = 0;
     long          _timeOffset     = 0;
 
     unsigned long _updateInterval = 60000;  // In ms
 
-    unsigned long _currentEpoc    = 0;      // In s
+    unsigned long long _currentEpocMs = 0;  // In ms, epoch at _lastUpdate
     unsigned long _lastUpdate     = 0;      // In ms
+    bool          _timeSet        = false;
+
+    bool          _requestPending = false;
+    unsigned long _requestSentAt  = 0;      // In ms
+    unsigned long _lastAttempt    = 0;      // In ms
+    uint32_t      _requestNonce   = 0;      // Sent as transmit timestamp, echoed back by the server
+
+    long          _driftPPM       = 0;      // Estimated local clock drift in ppm (> 0: local clock is slow)
+    long          _lastCorrection = 0;      // In ms, difference between prediction and server time at last sync
+    unsigned long _lastRoundTrip  = 0;      // In ms, network delay of the last sync
+    unsigned long _failedRequests = 0;
 
     byte          _packetBuffer[NTP_PACKET_SIZE];
 
     void          sendNTPPacket();
+    bool          readNTPPacket(unsigned long receivedAt);
+    bool          resolveServer(unsigned long now);
+    void          nextServer();
+    unsigned long long localEpochMillis(unsigned long now) const;
+
+    static unsigned long defaultMillis() { return millis(); }
+    static void   defaultDelay(unsigned long ms) { delay(ms); }
 
   public:
     NTPClient(UDP& udp);
@@ -41,6 +81,34 @@ class NTPClient {
      */
     void setPoolServerName(const char* poolServerName);
 
+    /**
+     * Set a list of time servers which are asked in turn if a server does not respond.
+     * The list is not copied and must stay valid.
+     *
+     * @param serverNames
+     * @param count (max. NTP_MAX_SERVERS)
+     */
+    void setPoolServerNames(const char* const* serverNames, uint8_t count);
+
+    /**
+     * Set the time source used for all timing, millis() and delay() by default.
+     * Lets the application run the client on its own (e.g. a virtual) clock.
+     *
+     * @param millisFunction
+     * @param delayFunction
+     */
+    void setClock(MillisFunction millisFunction, DelayFunction delayFunction);
+
+    /**
+     * Set the DNS lookup for the time server names. The address is cached and only looked up
+     * again after a request failed; failed lookups are retried with exponential backoff up to
+     * NTP_MAX_LOOKUP_BACKOFF. Without a lookup function the UDP client resolves the name
+     * on every request.
+     *
+     * @param resolveFunction returns false if the name could not be resolved
+     */
+    void setResolver(ResolveFunction resolveFunction);
+
     /**
      * Starts the underlying UDP client with the default local port
      */
@@ -54,18 +122,24 @@ class NTPClient {
     /**
      * This should be called in the main loop of your application. By default an update from the NTP Server is only
      * made every 60 seconds. This can be configured in the NTPClient constructor.
+     * The call never blocks: a request is sent and the response is picked up by one of the following calls.
      *
-     * @return true on success, false on failure
+     * @return false if the last request failed, true otherwise
      */
     bool update();
 
     /**
-     * This will force the update from the NTP Server.
+     * This will force the update from the NTP Server. Blocks up to NTP_REQUEST_TIMEOUT.
      *
      * @return true on success, false on failure
      */
     bool forceUpdate();
 
+    /**
+     * @return true if the time was synced at least once
+     */
+    bool isTimeSet() const;
+
     int getDay() const;
     int getHours() const;
     int getMinutes() const;
@@ -98,6 +172,46 @@ class NTPClient {
      */
     unsigned long getEpochTime() const;
 
+    /**
+     * @return time in milliseconds since Jan. 1, 1970, corrected by the estimated drift
+     */
+    unsigned long long getEpochMillis() const;
+
+    /**
+     * @return ms since the last successful sync
+     */
+    unsigned long getLastUpdateAge() const;
+
+    /**
+     * @return estimated drift of the local clock in ppm
+     */
+    long getDriftPPM() const;
+
+    /**
+     * @return correction applied at the last sync in ms
+     */
+    long getLastCorrection() const;
+
+    /**
+     * @return network round trip (without server processing time) of the last sync in ms
+     */
+    unsigned long getLastRoundTrip() const;
+
+    /**
+     * @return number of requests without a valid response
+     */
+    unsigned long getFailedRequests() const;
+
+    /**
+     * @return number of failed DNS lookups of the time server names
+     */
+    unsigned long getFailedLookups() const;
+
+    /**
+     * @return name of the time server currently in use
+     */
+    const char* getServerName() const;
+
     /**
      * Stops the underlying UDP client
      */
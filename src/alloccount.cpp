@@ -0,0 +1,67 @@
+#include "alloccount.h"
+
+static volatile uint32_t allocations = 0;
+static volatile uint32_t minFreeHeap = UINT32_MAX;
+static volatile uint32_t lowWater = UINT32_MAX;
+
+static inline void allocated()
+{
+  allocations++;
+  uint32_t free = ESP.getFreeHeap();
+  if (free < minFreeHeap)
+  {
+    minFreeHeap = free;
+  }
+  if (free < lowWater)
+  {
+    lowWater = free;
+  }
+}
+
+extern "C"
+{
+  void *__real_malloc(size_t size);
+  void *__real_calloc(size_t count, size_t size);
+  void *__real_realloc(void *ptr, size_t size);
+
+  void *IRAM_ATTR __wrap_malloc(size_t size)
+  {
+    void *ptr = __real_malloc(size);
+    allocated();
+    return ptr;
+  }
+
+  void *IRAM_ATTR __wrap_calloc(size_t count, size_t size)
+  {
+    void *ptr = __real_calloc(count, size);
+    allocated();
+    return ptr;
+  }
+
+  void *IRAM_ATTR __wrap_realloc(void *ptr, size_t size)
+  {
+    ptr = __real_realloc(ptr, size);
+    allocated();
+    return ptr;
+  }
+}
+
+uint32_t allocCount()
+{
+  return allocations;
+}
+
+uint32_t allocMinFreeHeap()
+{
+  return minFreeHeap;
+}
+
+uint32_t allocLowWater()
+{
+  return lowWater;
+}
+
+void allocResetLowWater()
+{
+  lowWater = UINT32_MAX;
+}
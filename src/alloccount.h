@@ -0,0 +1,22 @@
+#ifndef alloccount_h
+#define alloccount_h
+
+#include <Arduino.h>
+
+// Counts heap allocations. malloc(), calloc() and realloc() are wrapped by
+// the linker (see build_flags in platformio.ini), 'new' and String end up
+// there as well. Without the wrap flags the count stays 0.
+// The free heap is checked after every allocation, so the low-water marks
+// also catch buffers which are freed again right away.
+
+// Number of heap allocations since boot
+uint32_t allocCount();
+
+// Lowest free heap after an allocation since boot, UINT32_MAX without allocation
+uint32_t allocMinFreeHeap();
+
+// Lowest free heap after an allocation since the last allocResetLowWater()
+uint32_t allocLowWater();
+void allocResetLowWater();
+
+#endif
@@ -0,0 +1,124 @@
+#include "bench.h"
+#include "alloccount.h"
+#include "projector.h"
+#include "config.h"
+
+static uint32_t cyclesToNanos(uint64_t cycles)
+{
+  return cycles * 1000 / ESP.getCpuFreqMHz();
+}
+
+void benchRun(benchmark_t &bench)
+{
+  bench.minCycles = UINT32_MAX;
+  bench.maxCycles = 0;
+  bench.totalCycles = 0;
+
+  // One untimed run to fill caches and lazy initialised buffers
+  bench.callback();
+
+  uint32_t allocs = allocCount();
+  for (uint32_t n = 0; n < bench.iterations; n++)
+  {
+    uint32_t start = ESP.getCycleCount();
+    bench.callback();
+    uint32_t cycles = ESP.getCycleCount() - start;
+
+    bench.totalCycles += cycles;
+    if (cycles < bench.minCycles)
+    {
+      bench.minCycles = cycles;
+    }
+    if (cycles > bench.maxCycles)
+    {
+      bench.maxCycles = cycles;
+    }
+  }
+  bench.allocs = allocCount() - allocs;
+}
+
+uint32_t benchAvgTime(const benchmark_t &bench)
+{
+  return bench.iterations ? cyclesToNanos(bench.totalCycles / bench.iterations) : 0;
+}
+
+uint32_t benchMinTime(const benchmark_t &bench)
+{
+  return bench.iterations ? cyclesToNanos(bench.minCycles) : 0;
+}
+
+uint32_t benchMaxTime(const benchmark_t &bench)
+{
+  return cyclesToNanos(bench.maxCycles);
+}
+
+int benchFormat(const benchmark_t &bench, char *buffer, size_t size)
+{
+  return snprintf_P(buffer, size, PSTR("{\"name\":\"%s\",\"iterations\":%u,\"min_ns\":%u,\"avg_ns\":%u,\"max_ns\":%u,\"allocs\":%u}"),
+                    bench.name, (unsigned int)bench.iterations, (unsigned int)benchMinTime(bench), (unsigned int)benchAvgTime(bench),
+                    (unsigned int)benchMaxTime(bench), (unsigned int)bench.allocs);
+}
+
+// Fixed inputs, so results compare across versions
+static const uint8_t CANON_RESPONSE[] = {0x20, 0xbf, 0x01, 0x40, 0x10, 0x02, 0x04, 0x00, 0x01, 0x01, 0xff, 0x00, 0x00,
+                                         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x37};
+static const char BENQ_RESPONSE[] = ">*pow=?#\r\n*POW=ON#\r\n";
+static const char BENQ_BATCH_REPLIES[] = "\r\n*POW=ON#\r\n\r\n*SOUR=HDMI#\r\n\r\n*LTIM=1234#\r\n\r\n*Block item#\r\n";
+static const BenqQuery BENQ_BATCH_QUERIES[] = {BenqQuery::POWER, BenqQuery::SOURCE, BenqQuery::LAMP_HOURS, BenqQuery::LAMP_MODE};
+
+static void benchResponse(BeamerModel model, const uint8_t *data, size_t length)
+{
+  responseParser_t parser;
+  State state;
+  projectorParserBegin(parser, model);
+  for (size_t n = 0; n < length; n++)
+  {
+    projectorParserFeed(parser, data[n]);
+  }
+  projectorParserResult(parser, state);
+}
+
+static void benchCanonResponse()
+{
+  benchResponse(BeamerModel::CANON, CANON_RESPONSE, sizeof(CANON_RESPONSE));
+}
+
+static void benchBenQResponse()
+{
+  benchResponse(BeamerModel::BENQ, (const uint8_t *)BENQ_RESPONSE, sizeof(BENQ_RESPONSE) - 1);
+}
+
+static void benchBenQBatch()
+{
+  static benqBatch_t batch;
+  BenqQuery query;
+  const char *value;
+  projectorBenqBatchBegin(batch);
+  for (BenqQuery q : BENQ_BATCH_QUERIES)
+  {
+    projectorBenqBatchAdd(batch, q);
+  }
+  for (size_t n = 0; n < sizeof(BENQ_BATCH_REPLIES) - 1; n++)
+  {
+    if (projectorBenqBatchFeed(batch, BENQ_BATCH_REPLIES[n], query, value) && value)
+    {
+      projectorBenqValue(query, value);
+    }
+  }
+}
+
+static void benchSettings()
+{
+  static configData_t scratch;
+  configApply(scratch, "hostname", " beamer ");
+  configApply(scratch, "mqtt_port", "1883");
+  configApply(scratch, "syslog_port", "514");
+}
+
+benchmark_t benchProjectorCases[] = {
+    BENCHMARK("canon_response", benchCanonResponse, 500),
+    BENCHMARK("benq_response", benchBenQResponse, 500),
+    BENCHMARK("benq_batch", benchBenQBatch, 500),
+    BENCHMARK("settings_apply", benchSettings, 500),
+};
+const size_t BENCH_PROJECTOR_CASES = sizeof(benchProjectorCases) / sizeof(*benchProjectorCases);
@@ -0,0 +1,44 @@
+#ifndef bench_h
+#define bench_h
+
+#include <Arduino.h>
+
+// Micro-benchmarks for the hot paths. Each case runs a number of times
+// and is timed in CPU cycles, results are kept per case so they can be
+// printed in one go. On the host (native env) the cycles are counted for
+// an 80 MHz CPU from the real time.
+
+typedef void (*benchCase_t)();
+
+typedef struct
+{
+    const char *name;     // Shown in the results
+    benchCase_t callback; // Function to time
+    uint32_t iterations;  // Runs per benchmark
+    uint32_t minCycles;   // fastest run in CPU cycles
+    uint32_t maxCycles;   // slowest run in CPU cycles
+    uint64_t totalCycles; // sum of all runs in CPU cycles
+    uint32_t allocs;      // heap allocations of all runs
+} benchmark_t;
+
+// Creates a benchmark entry, results are zeroed
+#define BENCHMARK(name, callback, iterations) {name, callback, iterations, UINT32_MAX, 0, 0, 0}
+
+// Runs the benchmark and stores the results in it
+void benchRun(benchmark_t &bench);
+
+// Helpers to convert the results to ns per run
+uint32_t benchAvgTime(const benchmark_t &bench);
+uint32_t benchMinTime(const benchmark_t &bench);
+uint32_t benchMaxTime(const benchmark_t &bench);
+
+// Results as JSON object ("name", "iterations", "min_ns", "avg_ns",
+// "max_ns", "allocs"), returns the length like snprintf()
+int benchFormat(const benchmark_t &bench, char *buffer, size_t size);
+
+// Cases of the projector protocol and the settings form, shared by /bench
+// and the native benchmark (test/test_bench)
+extern benchmark_t benchProjectorCases[];
+extern const size_t BENCH_PROJECTOR_CASES;
+
+#endif
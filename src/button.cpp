@@ -0,0 +1,113 @@
+#include "button.h"
+#include "clock.h"
+
+typedef struct
+{
+  uint32_t time; // micros() of the edge
+  uint8_t level; // level after the edge
+} buttonEdge_t;
+
+// Entries and head are written by the ISR only, tail by the main loop only
+static buttonEdge_t queue[BUTTON_QUEUE_SIZE];
+static volatile uint8_t queueHead = 0;
+static volatile uint8_t queueTail = 0;
+static volatile uint32_t overflows = 0;
+
+// Used by the main loop only
+static uint8_t buttonPin;
+static uint32_t longPress;
+static uint8_t rawLevel = HIGH;     // level after the last edge
+static uint32_t lastEdge = 0;       // micros() of the last edge
+static uint8_t stableLevel = HIGH;  // debounced level
+static uint32_t pressStart = 0;     // clockMillis() of debounced press
+static uint32_t lastRelease = 0;    // clockMillis() of debounced release
+static uint8_t presses = 0;         // short presses in current sequence
+static bool longFired = false;      // long press already emitted for current press
+
+static void IRAM_ATTR buttonISR()
+{
+  uint8_t head = queueHead;
+  if ((uint8_t)(head - queueTail) >= BUTTON_QUEUE_SIZE)
+  {
+    overflows++;
+    return;
+  }
+  queue[head % BUTTON_QUEUE_SIZE].time = micros();
+  queue[head % BUTTON_QUEUE_SIZE].level = digitalRead(buttonPin);
+  queueHead = head + 1; // publish after the entry is written
+}
+
+void buttonBegin(uint8_t pin, uint32_t longPressTime)
+{
+  buttonPin = pin;
+  longPress = longPressTime;
+  pinMode(pin, INPUT_PULLUP);
+  rawLevel = stableLevel = digitalRead(pin);
+  lastEdge = micros();
+  attachInterrupt(digitalPinToInterrupt(pin), buttonISR, CHANGE);
+}
+
+ButtonEvent buttonPoll(uint8_t &count)
+{
+  uint32_t now = micros();
+
+  // Consume edges, only the last one matters for debouncing
+  uint8_t tail = queueTail;
+  while (tail != queueHead)
+  {
+    const buttonEdge_t &edge = queue[tail % BUTTON_QUEUE_SIZE];
+    rawLevel = edge.level;
+    lastEdge = edge.time;
+    tail++;
+    queueTail = tail; // release the entry after it was read
+  }
+
+  // Resync if an edge got lost
+  if (now - lastEdge >= BUTTON_DEBOUNCE_TIME * 1000UL && digitalRead(buttonPin) != rawLevel)
+  {
+    rawLevel = !rawLevel;
+    lastEdge = now;
+  }
+
+  if (rawLevel != stableLevel && now - lastEdge >= BUTTON_DEBOUNCE_TIME * 1000UL)
+  {
+    stableLevel = rawLevel;
+    if (stableLevel == LOW)
+    {
+      pressStart = clockMillis();
+      longFired = false;
+    }
+    else if (!longFired)
+    {
+      presses++;
+      lastRelease = clockMillis();
+    }
+  }
+
+  if (stableLevel == LOW && !longFired && clockMillis() - pressStart >= longPress)
+  {
+    longFired = true;
+    presses = 0;
+    count = 1;
+    return ButtonEvent::LONG;
+  }
+
+  if (stableLevel == HIGH && presses > 0 && clockMillis() - lastRelease >= BUTTON_MULTIPRESS_WINDOW)
+  {
+    count = presses;
+    presses = 0;
+    return count == 1 ? ButtonEvent::SHORT : ButtonEvent::MULTI;
+  }
+
+  return ButtonEvent::NONE;
+}
+
+uint32_t buttonHeldTime()
+{
+  return stableLevel == LOW ? clockMillis() - pressStart : 0;
+}
+
+uint32_t buttonOverflows()
+{
+  return overflows;
+}
@@ -0,0 +1,34 @@
+#ifndef button_h
+#define button_h
+
+#include <Arduino.h>
+
+// Interrupt driven push button. The GPIO interrupt only timestamps edges
+// into a single-producer/single-consumer queue, debouncing and press
+// detection run in buttonPoll() without any delay.
+
+#define BUTTON_QUEUE_SIZE 16         // Must be a power of 2
+#define BUTTON_DEBOUNCE_TIME 30      // in ms, level must be stable this long
+#define BUTTON_MULTIPRESS_WINDOW 400 // in ms, max. time between releases of a multi-press
+
+enum class ButtonEvent : uint8_t
+{
+    NONE,
+    SHORT, // Pressed and released once
+    MULTI, // Pressed and released several times in a row, see count
+    LONG   // Held for the long press time (emitted while still held)
+};
+
+// Button is active low with internal pull-up
+void buttonBegin(uint8_t pin, uint32_t longPressTime);
+
+// Processes queued edges and returns the next event, count is the number of presses
+ButtonEvent buttonPoll(uint8_t &count);
+
+// Time the button is held down in ms, 0 if released
+uint32_t buttonHeldTime();
+
+// Edges lost because the queue was full
+uint32_t buttonOverflows();
+
+#endif
@@ -0,0 +1,158 @@
+#include "cache.h"
+#include "clock.h"
+#include "projector.h"
+
+static const char *stateText(int32_t value)
+{
+  switch ((State)value)
+  {
+  case State::ON:
+    return "on";
+  case State::OFF:
+    return "off";
+  default:
+    return "unknown";
+  }
+}
+
+static const char *switchText(int32_t value)
+{
+  return value ? "on" : "off";
+}
+
+static const char *lampText(int32_t value)
+{
+  return projectorCanonLampName((uint8_t)value);
+}
+
+static const char *displayText(int32_t value)
+{
+  return projectorCanonDisplayName((uint8_t)value);
+}
+
+static const char *inputText(int32_t value)
+{
+  return value >= PROJECTOR_BENQ_SOURCE ? projectorBenqSourceName(value) : projectorCanonInputName((uint8_t)value);
+}
+
+static const char *lampModeText(int32_t value)
+{
+  return projectorBenqLampModeName(value);
+}
+
+static const char *videoText(int32_t value)
+{
+  return projectorCanonVideoName((uint8_t)value);
+}
+
+#define CACHE_ENTRY(name, ttl, text, optional) {name, ttl, text, 0, 0, false, optional, 0}
+
+// In the order of Attribute, all polled every second
+static cacheEntry_t entries[] = {
+    CACHE_ENTRY("power", 5000, stateText, false),
+    // Canon status response, input, blank, sound_mute and freeze also BenQ
+    CACHE_ENTRY("lamp", 5000, lampText, true),
+    CACHE_ENTRY("error", 5000, nullptr, true),
+    CACHE_ENTRY("display", 5000, displayText, true),
+    CACHE_ENTRY("input", 5000, inputText, true),
+    CACHE_ENTRY("terminal", 5000, nullptr, true),
+    CACHE_ENTRY("video", 5000, videoText, true),
+    CACHE_ENTRY("blank", 5000, switchText, true),
+    CACHE_ENTRY("sound_mute", 5000, switchText, true),
+    CACHE_ENTRY("onscreen_mute", 5000, switchText, true),
+    CACHE_ENTRY("freeze", 5000, switchText, true),
+    // BenQ only
+    CACHE_ENTRY("lamp_hours", 5000, nullptr, true),
+    CACHE_ENTRY("lamp_mode", 5000, lampModeText, true),
+};
+
+static_assert(sizeof(entries) / sizeof(*entries) == (size_t)Attribute::COUNT, "one cache entry per attribute");
+
+static cacheStats_t stats = {0, 0, 0};
+static void (*requestFunction)() = nullptr;
+
+static bool fresh(const cacheEntry_t &entry, uint32_t maxAge)
+{
+  return entry.valid && clockMillis() - entry.updated <= (maxAge ? maxAge : entry.ttl);
+}
+
+static bool polled(const cacheEntry_t &entry)
+{
+  // Optional attributes the model never reported are not waited for
+  return entry.valid || !entry.optional;
+}
+
+static void requestRefresh()
+{
+  stats.refreshes++;
+  if (requestFunction)
+  {
+    requestFunction();
+  }
+}
+
+void cacheBegin(void (*requestRefresh)())
+{
+  requestFunction = requestRefresh;
+}
+
+bool cacheSet(Attribute attr, int32_t value)
+{
+  cacheEntry_t &entry = entries[(size_t)attr];
+  bool changed = !entry.valid || entry.value != value;
+  entry.value = value;
+  entry.updated = clockMillis();
+  entry.valid = true;
+  if (changed)
+  {
+    entry.changes++;
+  }
+  return changed;
+}
+
+bool cacheGet(Attribute attr, int32_t &value, uint32_t maxAge)
+{
+  const cacheEntry_t &entry = entries[(size_t)attr];
+  if (!fresh(entry, maxAge))
+  {
+    stats.misses++;
+    // Without maxAge the regular poll is soon enough
+    if (maxAge && polled(entry))
+    {
+      requestRefresh();
+    }
+    return false;
+  }
+  stats.hits++;
+  value = entry.value;
+  return true;
+}
+
+bool cacheRefresh(uint32_t maxAge)
+{
+  for (const cacheEntry_t &entry : entries)
+  {
+    if (polled(entry) && !fresh(entry, maxAge))
+    {
+      requestRefresh();
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t cacheAge(Attribute attr)
+{
+  const cacheEntry_t &entry = entries[(size_t)attr];
+  return entry.valid ? clockMillis() - entry.updated : UINT32_MAX;
+}
+
+const cacheEntry_t &cacheEntry(Attribute attr)
+{
+  return entries[(size_t)attr];
+}
+
+const cacheStats_t &cacheGetStats()
+{
+  return stats;
+}
@@ -0,0 +1,74 @@
+#ifndef cache_h
+#define cache_h
+
+#include <Arduino.h>
+
+// Cache of the projector attributes. Each attribute has its own TTL and
+// last update time, values older than the TTL are stale. Readers give the
+// age they accept and never get an older value. A reader asking for a
+// maximum age requests a refresh instead, the poll task then polls as
+// soon as possible. Readers do not poll themselves, so HTTP and MQTT
+// handlers neither wait for the serial line nor re-enter the status
+// publishing of the poll.
+
+enum class Attribute : uint8_t
+{
+    POWER,         // State
+    LAMP,          // Canon processing status (DATA02)
+    ERROR,         // 1 in error standby
+    DISPLAY,       // Canon indicate contents (DATA03)
+    SOURCE,        // Canon input type (DATA05), BenQ source (PROJECTOR_BENQ_SOURCE + n)
+    TERMINAL,      // Canon input terminal number (DATA04)
+    VIDEO,         // Canon video signal type (DATA06)
+    BLANK,         // 1 if on
+    SOUND_MUTE,    // 1 if on
+    ONSCREEN_MUTE, // 1 if on
+    FREEZE,        // 1 if on
+    LAMP_HOURS,    // BenQ lamp hours
+    LAMP_MODE,     // BenQ lamp mode
+    COUNT
+};
+
+typedef struct
+{
+    const char *name;              // field name in JSON
+    uint32_t ttl;                  // in ms, older values are stale
+    const char *(*text)(int32_t);  // name of an enum value, nullptr for numbers
+    int32_t value;                 // last value
+    uint32_t updated;              // clockMillis() of the last update
+    bool valid;                    // a value was stored since boot
+    bool optional;                 // not reported by every model, ignored by cacheRefresh without a value
+    uint32_t changes;              // value changes since boot
+} cacheEntry_t;
+
+typedef struct
+{
+    uint32_t hits;      // reads served from the cache
+    uint32_t refreshes; // reads which requested a refresh
+    uint32_t misses;    // reads without a value of the accepted age
+} cacheStats_t;
+
+// Sets the function which requests a refresh, e.g. brings the next poll
+// forward. Called by readers, so it must not poll itself.
+void cacheBegin(void (*requestRefresh)());
+
+// Stores a value, returns true if it changed
+bool cacheSet(Attribute attr, int32_t value);
+
+// Reads a value not older than maxAge ms (0 = the TTL of the attribute).
+// Returns false if there is no such value, with maxAge a refresh is
+// requested then (optional attributes only once they have a value).
+bool cacheGet(Attribute attr, int32_t &value, uint32_t maxAge = 0);
+
+// Requests a refresh if any attribute is older than maxAge ms (0 = the
+// TTL), optional ones only once they have a value. Returns true if all
+// are fresh.
+bool cacheRefresh(uint32_t maxAge);
+
+// Age of the value in ms, UINT32_MAX if there is none
+uint32_t cacheAge(Attribute attr);
+
+const cacheEntry_t &cacheEntry(Attribute attr);
+const cacheStats_t &cacheGetStats();
+
+#endif
@@ -0,0 +1,131 @@
+#include "capture.h"
+
+static uint32_t times[CAPTURE_BUFFER_SIZE];
+static uint8_t bytes[CAPTURE_BUFFER_SIZE];
+static uint8_t sent[CAPTURE_BUFFER_SIZE / 8]; // direction bits
+static uint32_t writePos = 0;                 // total bytes captured, index is writePos % CAPTURE_BUFFER_SIZE
+static bool active = false;
+
+// Baud rate from byte 'pos' on, the bytes before the oldest kept change are dropped
+static struct
+{
+  uint32_t pos;
+  uint32_t baud;
+} rates[CAPTURE_RATE_CHANGES];
+static uint32_t rateCount = 0; // total changes since captureStart(), index is % CAPTURE_RATE_CHANGES
+static uint32_t baudRate = 0;
+
+static void addRate()
+{
+  // A change before any byte at the new rate replaces the last one
+  if (rateCount > 0 && rates[(rateCount - 1) % CAPTURE_RATE_CHANGES].pos == writePos)
+  {
+    rates[(rateCount - 1) % CAPTURE_RATE_CHANGES].baud = baudRate;
+    return;
+  }
+  rates[rateCount % CAPTURE_RATE_CHANGES].pos = writePos;
+  rates[rateCount % CAPTURE_RATE_CHANGES].baud = baudRate;
+  rateCount++;
+}
+
+// Position of the oldest byte still in the buffer with a known baud rate
+static uint32_t firstPos()
+{
+  uint32_t first = writePos > CAPTURE_BUFFER_SIZE ? writePos - CAPTURE_BUFFER_SIZE : 0;
+  if (rateCount > CAPTURE_RATE_CHANGES)
+  {
+    first = max(first, rates[rateCount % CAPTURE_RATE_CHANGES].pos);
+  }
+  return first;
+}
+
+static uint32_t rateAt(uint32_t pos)
+{
+  for (uint32_t n = rateCount; n > 0 && rateCount - n < CAPTURE_RATE_CHANGES; n--)
+  {
+    if (rates[(n - 1) % CAPTURE_RATE_CHANGES].pos <= pos)
+    {
+      return rates[(n - 1) % CAPTURE_RATE_CHANGES].baud;
+    }
+  }
+  return baudRate;
+}
+
+static void capture(uint32_t time, uint8_t data, bool out)
+{
+  size_t i = writePos++ % CAPTURE_BUFFER_SIZE;
+  times[i] = time;
+  bytes[i] = data;
+  if (out)
+  {
+    sent[i / 8] |= 1 << (i % 8);
+  }
+  else
+  {
+    sent[i / 8] &= ~(1 << (i % 8));
+  }
+}
+
+void captureStart()
+{
+  writePos = 0;
+  rateCount = 0;
+  addRate();
+  active = true;
+}
+
+void captureStop()
+{
+  active = false;
+}
+
+bool captureActive()
+{
+  return active;
+}
+
+void captureBaudRate(uint32_t baud)
+{
+  baudRate = baud;
+  if (active)
+  {
+    addRate();
+  }
+}
+
+void captureWrite(const uint8_t *data, size_t length, uint32_t start, uint32_t byteTime)
+{
+  if (active)
+  {
+    for (size_t i = 0; i < length; i++)
+    {
+      capture(start + i * byteTime, data[i], true);
+    }
+  }
+}
+
+void captureRead(uint8_t data, uint32_t time)
+{
+  if (active)
+  {
+    capture(time, data, false);
+  }
+}
+
+size_t captureCount()
+{
+  return writePos - firstPos();
+}
+
+uint32_t captureOverwritten()
+{
+  return firstPos();
+}
+
+captureEntry_t captureEntry(size_t index)
+{
+  uint32_t pos = firstPos() + index;
+  size_t i = pos % CAPTURE_BUFFER_SIZE;
+  captureEntry_t entry = {times[i], rateAt(pos), bytes[i], (sent[i / 8] & (1 << (i % 8))) != 0};
+  return entry;
+}
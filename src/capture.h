@@ -0,0 +1,46 @@
+#ifndef capture_h
+#define capture_h
+
+#include <Arduino.h>
+
+// Capture of the serial traffic to the projector. Every byte sent and
+// received is stored with its micros() timestamp in a fixed ring buffer,
+// the oldest bytes are overwritten when it is full. Recording costs a few
+// stores per byte, so a capture can run during normal polling.
+//
+// Sent bytes are stamped with the write time plus their position on the
+// wire, received bytes when the transport drains them from the serial
+// driver (transportAvailable(), every ms while a reply is awaited).
+
+#define CAPTURE_BUFFER_SIZE 1024 // bytes of serial traffic kept, power of two
+#define CAPTURE_RATE_CHANGES 8   // baud rate changes kept, older bytes are dropped with them
+
+typedef struct
+{
+    uint32_t time; // micros() of the byte
+    uint32_t baud; // baud rate the byte was transferred at
+    uint8_t data;  // the byte
+    bool sent;     // true if sent to the projector, false if received
+} captureEntry_t;
+
+// Clears the buffer and starts recording
+void captureStart();
+void captureStop();
+bool captureActive();
+
+// Sets the baud rate of the following bytes (transport.cpp)
+void captureBaudRate(uint32_t baud);
+
+// Records sent bytes, byte n at start + n * byteTime (in us)
+void captureWrite(const uint8_t *data, size_t length, uint32_t start, uint32_t byteTime);
+// Records a received byte with its micros() time
+void captureRead(uint8_t data, uint32_t time);
+
+// Bytes in the buffer and overwritten or dropped bytes since captureStart()
+size_t captureCount();
+uint32_t captureOverwritten();
+
+// Entry 'index' of the buffer, 0 is the oldest
+captureEntry_t captureEntry(size_t index);
+
+#endif
@@ -0,0 +1,5 @@
+#include "clock.h"
+
+#ifdef CLOCK_VIRTUAL
+volatile uint32_t clockVirtualMillis = 0;
+#endif
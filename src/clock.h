@@ -0,0 +1,46 @@
+#ifndef clock_h
+#define clock_h
+
+#include <Arduino.h>
+
+// Time source for all timing logic. Normally this is millis() and delay().
+// Built with -D CLOCK_VIRTUAL the clock only moves by clockAdvance() and
+// clockDelay(), so timing like the periodic publish, the button long press
+// or the reconnect backoff can be fast-forwarded in a simulation.
+// Inline, so it can be used in interrupt handlers.
+
+#ifdef CLOCK_VIRTUAL
+
+extern volatile uint32_t clockVirtualMillis;
+
+inline uint32_t clockMillis()
+{
+    return clockVirtualMillis;
+}
+
+// Returns at once, only the virtual time moves on
+inline void clockDelay(uint32_t ms)
+{
+    clockVirtualMillis += ms;
+}
+
+inline void clockAdvance(uint32_t ms)
+{
+    clockVirtualMillis += ms;
+}
+
+#else
+
+inline uint32_t clockMillis()
+{
+    return millis();
+}
+
+inline void clockDelay(uint32_t ms)
+{
+    delay(ms);
+}
+
+#endif
+
+#endif
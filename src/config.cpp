@@ -0,0 +1,156 @@
+#include "config.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SETTING_TEXT(name, field) {name, offsetof(configData_t, field), sizeof(configData_t::field), true}
+#define SETTING_NUMBER(name, field) {name, offsetof(configData_t, field), sizeof(configData_t::field), false}
+static const settingField_t SETTING_FIELDS[] = {
+    SETTING_TEXT("note", note),
+    SETTING_TEXT("admin_username", admin_username),
+    SETTING_TEXT("admin_password", admin_password),
+    SETTING_TEXT("ssid", wifi_ssid),
+    SETTING_TEXT("psk", wifi_psk),
+    SETTING_TEXT("hostname", hostname),
+    SETTING_TEXT("beamermodel", beamermodel),
+    SETTING_NUMBER("beamerbaudrate", beamerbaudrate),
+    SETTING_TEXT("mqtt_server", mqtt_server),
+    SETTING_NUMBER("mqtt_port", mqtt_port),
+    SETTING_TEXT("mqtt_user", mqtt_user),
+    SETTING_TEXT("mqtt_password", mqtt_password),
+    SETTING_TEXT("mqtt_prefix", mqtt_prefix),
+    SETTING_NUMBER("mqtt_periodic_update_interval", mqtt_periodic_update_interval),
+    SETTING_NUMBER("led_brightness", led_brightness),
+    SETTING_TEXT("api_username", api_username),
+    SETTING_TEXT("api_password", api_password),
+    SETTING_TEXT("syslog_server", syslog_server),
+    SETTING_NUMBER("syslog_port", syslog_port),
+};
+
+// Copies src truncated to size - 1 chars, the rest of dest is zeroed
+static void copyText(char *dest, size_t size, const char *src, size_t len)
+{
+  if (len > size - 1)
+  {
+    len = size - 1;
+  }
+  memcpy(dest, src, len);
+  memset(dest + len, 0, size - len);
+}
+
+#define CONFIG_TEXT(field, text) copyText(cfg.field, sizeof(cfg.field), text, strlen(text))
+
+void configDefaults(configData_t &cfg)
+{
+  // Valid-Falg to verify config
+  cfg.configversion = CONFIG_VERSION;
+
+  // Note
+  CONFIG_TEXT(note, "");
+
+  CONFIG_TEXT(wifi_ssid, "");
+  CONFIG_TEXT(wifi_psk, "");
+
+  CONFIG_TEXT(hostname, "");
+
+  CONFIG_TEXT(beamermodel, "");
+  cfg.beamerbaudrate = 0; // auto
+
+  CONFIG_TEXT(admin_username, "admin");
+  CONFIG_TEXT(admin_password, "admin");
+
+  CONFIG_TEXT(api_username, "api");
+  CONFIG_TEXT(api_password, "api");
+
+  CONFIG_TEXT(mqtt_server, "");
+  CONFIG_TEXT(mqtt_user, "");
+  cfg.mqtt_port = 1883;
+  CONFIG_TEXT(mqtt_password, "");
+  CONFIG_TEXT(mqtt_prefix, "beamercontrol");
+  cfg.mqtt_periodic_update_interval = 10;
+  cfg.led_brightness = 100;
+
+  CONFIG_TEXT(syslog_server, "");
+  cfg.syslog_port = 514;
+}
+
+bool configMigrate(configData_t &cfg)
+{
+  if (cfg.configversion == 6)
+  {
+    // Version 7 appended the syslog settings, keep the rest
+    CONFIG_TEXT(syslog_server, "");
+    cfg.syslog_port = 514;
+    cfg.configversion = 7;
+  }
+
+  return cfg.configversion == CONFIG_VERSION;
+}
+
+bool configApply(configData_t &cfg, const char *name, const char *value)
+{
+  for (const settingField_t &field : SETTING_FIELDS)
+  {
+    if (strcmp(name, field.name) != 0)
+    {
+      continue;
+    }
+
+    uint8_t *setting = (uint8_t *)&cfg + field.offset;
+    while (isspace((unsigned char)*value))
+    {
+      value++;
+    }
+
+    if (field.text)
+    {
+      // Without leading and trailing whitespace
+      size_t len = strlen(value);
+      while (len > 0 && isspace((unsigned char)value[len - 1]))
+      {
+        len--;
+      }
+      copyText((char *)setting, field.size, value, len);
+      return true;
+    }
+
+    // strtoul() saturates on overflow, on the ESP at the 32 bit maximum
+    char *end;
+    errno = 0;
+    unsigned long number = strtoul(value, &end, 10);
+    bool overflow = errno == ERANGE;
+    unsigned long max = field.size >= sizeof(uint32_t) ? UINT32_MAX : (1UL << (8 * field.size)) - 1;
+    while (isspace((unsigned char)*end))
+    {
+      end++;
+    }
+    if (!isdigit((unsigned char)*value) || *end != 0 || overflow || number > max)
+    {
+      return false;
+    }
+    switch (field.size)
+    {
+    case 1:
+    {
+      uint8_t n = number;
+      memcpy(setting, &n, sizeof(n));
+      break;
+    }
+    case 2:
+    {
+      uint16_t n = number;
+      memcpy(setting, &n, sizeof(n));
+      break;
+    }
+    case 4:
+    {
+      uint32_t n = number;
+      memcpy(setting, &n, sizeof(n));
+      break;
+    }
+    }
+    return true;
+  }
+  return false;
+}
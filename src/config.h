@@ -0,0 +1,32 @@
+#ifndef config_h
+#define config_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "settings.h"
+
+// Config defaults, migration and the settings form fields. Reading and
+// writing the EEPROM is left to the caller, so this builds on the host too.
+
+#define CONFIG_VERSION 7
+
+// Settings form fields
+typedef struct
+{
+    const char *name; // form field name
+    size_t offset;    // offset in configData_t
+    size_t size;      // size of the setting in bytes
+    bool text;        // text or numeric setting
+} settingField_t;
+
+void configDefaults(configData_t &cfg);
+
+// Migrates older config versions, returns false if cfg is not usable
+bool configMigrate(configData_t &cfg);
+
+// Applies a settings form value, returns false for unknown field names and
+// invalid numbers (the setting is kept then). Text is trimmed and
+// truncated, numbers must be decimal and fit the field.
+bool configApply(configData_t &cfg, const char *name, const char *value);
+
+#endif
@@ -0,0 +1,635 @@
+#include "device.h"
+#include "transport.h"
+#include "clock.h"
+#include "log.h"
+
+static const uint32_t LINK_BAUDRATES[] = {19200, 9600, 38400, 57600, 115200}; // probed with baud rate 0 (auto), most common first
+static const uint8_t LINK_BAUDRATE_COUNT = sizeof(LINK_BAUDRATES) / sizeof(*LINK_BAUDRATES);
+static const uint32_t POLL_RTT_BOUNDS[] = {5, 10, 20, 50, 75, 100}; // in ms
+static const uint32_t POWER_CONFIRM_BOUNDS[] = {250, 500, 1000, 2500, 5000, 10000, 30000, 60000, 120000}; // in ms
+static const uint32_t AV_WIRE_BOUNDS[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000}; // in us
+
+static const avControlInfo_t AV_CONTROLS[] = {
+    {"blank", "blankcommand", "blankcommand_ms", Attribute::BLANK, BenqQuery::BLANK},
+    {"mute", "mutecommand", "mutecommand_ms", Attribute::SOUND_MUTE, BenqQuery::MUTE},
+};
+static_assert(sizeof(AV_CONTROLS) / sizeof(*AV_CONTROLS) == (size_t)AVControl::COUNT, "one entry per AV control");
+static_assert((size_t)Attribute::COUNT <= 32, "changed has one bit per attribute");
+
+static BeamerModel model = BeamerModel::UNKNOWN;
+static uint32_t configuredBaudRate = 0;       // 0 = auto
+static State polledState = State::UNKNOWN;    // last state polled, held while the link recovers
+static State demoState = State::UNKNOWN;      // demo mode projector
+static uint32_t changed = 0;                  // attribute bits changed since deviceClearChanged()
+static uint8_t benqNextQuery = 0;             // next low priority BenQ attribute
+static powerCommand_t powerCommand = {CommandStatus::NONE, State::UNKNOWN, 0, 0, 0, 0, HISTOGRAM(POWER_CONFIRM_BOUNDS)};
+static avCommand_t avCommands[(size_t)AVControl::COUNT] = {
+    {false, false, 0, CommandStatus::NONE, 0, 0},
+    {false, false, 0, CommandStatus::NONE, 0, 0}};
+static serialLink_t serialLink = {false, 0, 0, 0, 0, 0, 0, 0};
+static deviceStats_t stats = {0, 0, 0, 0, 0, HISTOGRAM(POLL_RTT_BOUNDS), PollResult::OK, 0, 0, 0, 0, HISTOGRAM(AV_WIRE_BOUNDS)};
+
+// Baud rate of probe attempt 'index', only the configured one if it is not auto
+static uint32_t serialLinkRate(uint8_t index)
+{
+  if (configuredBaudRate != 0)
+  {
+    return configuredBaudRate;
+  }
+  return LINK_BAUDRATES[(serialLink.probeFirst + index) % LINK_BAUDRATE_COUNT];
+}
+
+static uint8_t serialLinkRateCount()
+{
+  return configuredBaudRate != 0 ? 1 : LINK_BAUDRATE_COUNT;
+}
+
+// Starts probing with the current baud rate
+static void serialLinkProbe()
+{
+  serialLink.probing = true;
+  serialLink.probeStart = clockMillis();
+  serialLink.probeIndex = 0;
+  serialLink.probeFirst = 0;
+  for (uint8_t i = 0; i < LINK_BAUDRATE_COUNT; i++)
+  {
+    if (LINK_BAUDRATES[i] == transportBaudRate())
+    {
+      serialLink.probeFirst = i;
+    }
+  }
+}
+
+// Checks the link with the result of a poll: a valid response sets the
+// state, invalid ones keep the last state until the link was re-probed at
+// all baud rates without answer, then the state is UNKNOWN.
+static void serialLinkUpdate(bool valid, State state)
+{
+  if (valid)
+  {
+    if (serialLink.probing)
+    {
+      serialLink.probing = false;
+      serialLink.probeTime = clockMillis() - serialLink.probeStart;
+      serialLink.recoveries++;
+      LOG_INFO("Serial link at %u baud, probed in %lu ms", transportBaudRate(), serialLink.probeTime);
+    }
+    serialLink.failStreak = 0;
+    polledState = state;
+    return;
+  }
+
+  if (!serialLink.probing)
+  {
+    serialLink.failStreak = min(serialLink.failStreak + 1, 255);
+    if (serialLink.failStreak < DEVICE_LINK_FAIL_THRESHOLD)
+    {
+      return;
+    }
+    LOG_WARN("Serial link lost after %u invalid responses, probing", serialLink.failStreak);
+    serialLinkProbe();
+  }
+  else if (++serialLink.probeIndex >= serialLinkRateCount())
+  {
+    // No answer at any baud rate, start the next pass
+    polledState = State::UNKNOWN;
+    serialLink.probeIndex = 0;
+  }
+
+  serialLink.probes++;
+  transportClear();
+  transportSetBaudRate(serialLinkRate(serialLink.probeIndex));
+}
+
+// Stores a polled attribute, a change is logged and listed in the next status message
+static void setAttribute(Attribute attr, int32_t value)
+{
+  stats.pollAttributes++;
+  if (cacheSet(attr, value))
+  {
+    const cacheEntry_t &entry = cacheEntry(attr);
+    changed |= 1UL << (uint8_t)attr;
+    if (entry.text)
+    {
+      LOG_INFO("Projector %s: %s", entry.name, entry.text(value));
+    }
+    else
+    {
+      LOG_INFO("Projector %s: %ld", entry.name, (long)value);
+    }
+  }
+}
+
+static void setBenqAttribute(BenqQuery query, const char *text)
+{
+  int32_t value = projectorBenqValue(query, text);
+  if (value < 0)
+  {
+    LOG_DEBUG("devicePoll: %s=%s unknown", projectorBenqKey(query), text);
+    return;
+  }
+
+  switch (query)
+  {
+  case BenqQuery::SOURCE:
+    setAttribute(Attribute::SOURCE, value);
+    break;
+  case BenqQuery::LAMP_HOURS:
+    setAttribute(Attribute::LAMP_HOURS, value);
+    break;
+  case BenqQuery::LAMP_MODE:
+    setAttribute(Attribute::LAMP_MODE, value);
+    break;
+  case BenqQuery::BLANK:
+    setAttribute(Attribute::BLANK, value);
+    break;
+  case BenqQuery::MUTE:
+    setAttribute(Attribute::SOUND_MUTE, value);
+    break;
+  case BenqQuery::FREEZE:
+    setAttribute(Attribute::FREEZE, value);
+    break;
+  default:
+    break;
+  }
+}
+
+// Sends the power query and the next low priority queries back-to-back and
+// reads the replies as they arrive. The power reply is answered first and
+// copied to 'parser', the other attributes go to the cache.
+static void pollBenq(responseParser_t &parser)
+{
+  benqBatch_t batch;
+  projectorBenqBatchBegin(batch);
+  projectorBenqBatchAdd(batch, BenqQuery::POWER);
+  frame_t request = projectorBenqQuery(BenqQuery::POWER);
+  transportWrite(request.data, request.length);
+  uint8_t queries = 0;
+  for (uint8_t c = 0; c < (uint8_t)AVControl::COUNT; c++)
+  {
+    // Pending blank or mute commands first, for a quick confirmation
+    if (avCommands[c].status == CommandStatus::PENDING)
+    {
+      projectorBenqBatchAdd(batch, AV_CONTROLS[c].query);
+      request = projectorBenqQuery(AV_CONTROLS[c].query);
+      transportWrite(request.data, request.length);
+      queries++;
+    }
+  }
+  for (; queries < DEVICE_BENQ_QUERIES_PER_POLL; queries++)
+  {
+    BenqQuery query = (BenqQuery)((uint8_t)BenqQuery::POWER + 1 + benqNextQuery);
+    benqNextQuery = (benqNextQuery + 1) % ((uint8_t)BenqQuery::COUNT - 1);
+    projectorBenqBatchAdd(batch, query);
+    request = projectorBenqQuery(query);
+    transportWrite(request.data, request.length);
+  }
+  unsigned long pollStart = clockMillis();
+  stats.polls++;
+
+  // Read until all queries are answered or timeout
+  while (batch.pendingCount && clockMillis() - pollStart < DEVICE_RESPONSE_TIMEOUT)
+  {
+    while (batch.pendingCount && transportAvailable())
+    {
+      BenqQuery query;
+      const char *value;
+      if (!projectorBenqBatchFeed(batch, transportRead(), query, value))
+      {
+        continue;
+      }
+      if (query == BenqQuery::POWER)
+      {
+        parser = batch.line;
+        histogramAdd(stats.pollRoundTrip, clockMillis() - pollStart);
+      }
+      else if (value)
+      {
+        setBenqAttribute(query, value);
+      }
+    }
+    clockDelay(1);
+  }
+}
+
+static void pollCanon(responseParser_t &parser)
+{
+  frame_t request = projectorPollRequest(model);
+  transportWrite(request.data, request.length);
+  unsigned long pollStart = clockMillis();
+  stats.polls++;
+
+  // Read until the response is complete or timeout
+  while (!parser.complete && clockMillis() - pollStart < DEVICE_RESPONSE_TIMEOUT)
+  {
+    while (!parser.complete && transportAvailable())
+    {
+      projectorParserFeed(parser, transportRead());
+    }
+    clockDelay(1);
+  }
+
+  if (parser.complete)
+  {
+    histogramAdd(stats.pollRoundTrip, clockMillis() - pollStart);
+  }
+}
+
+// Confirms a pending power command with the polled state or fails it after
+// DEVICE_POWER_CONFIRM_TIMEOUT, which reports the polled state again
+static void powerCommandUpdate()
+{
+  if (powerCommand.status != CommandStatus::PENDING)
+  {
+    return;
+  }
+
+  unsigned long elapsed = clockMillis() - powerCommand.start;
+  if (polledState == powerCommand.target)
+  {
+    powerCommand.status = CommandStatus::CONFIRMED;
+    powerCommand.confirmed++;
+    histogramAdd(powerCommand.latency, elapsed);
+    LOG_INFO("Power %s confirmed after %lu ms", projectorStateName(powerCommand.target), elapsed);
+  }
+  else if (elapsed >= DEVICE_POWER_CONFIRM_TIMEOUT)
+  {
+    powerCommand.status = CommandStatus::FAILED;
+    powerCommand.failed++;
+    LOG_WARN("Power %s not confirmed after %lu ms, state %s", projectorStateName(powerCommand.target), elapsed, projectorStateName(polledState));
+  }
+  else
+  {
+    return;
+  }
+
+  powerCommand.time = elapsed;
+  changed |= 1UL << (uint8_t)Attribute::POWER;
+}
+
+// Confirms pending blank and mute commands with the polled attributes,
+// values polled before the command do not count
+static void avCommandUpdate()
+{
+  for (uint8_t c = 0; c < (uint8_t)AVControl::COUNT; c++)
+  {
+    avCommand_t &cmd = avCommands[c];
+    if (cmd.status != CommandStatus::PENDING)
+    {
+      continue;
+    }
+
+    const cacheEntry_t &entry = cacheEntry(AV_CONTROLS[c].attribute);
+    unsigned long elapsed = clockMillis() - cmd.start;
+    if (entry.valid && (long)(entry.updated - cmd.start) >= 0 && (entry.value != 0) == cmd.target)
+    {
+      cmd.status = CommandStatus::CONFIRMED;
+      stats.avConfirmed++;
+      LOG_INFO("%s %s confirmed after %lu ms", AV_CONTROLS[c].name, cmd.target ? "on" : "off", elapsed);
+    }
+    else if (elapsed >= DEVICE_AV_CONFIRM_TIMEOUT)
+    {
+      cmd.status = CommandStatus::FAILED;
+      stats.avFailed++;
+      LOG_WARN("%s %s not confirmed after %lu ms", AV_CONTROLS[c].name, cmd.target ? "on" : "off", elapsed);
+    }
+    else
+    {
+      continue;
+    }
+
+    cmd.time = elapsed;
+    changed |= 1UL << (uint8_t)AV_CONTROLS[c].attribute;
+  }
+}
+
+// Reads the reply to a command sent at start until it is complete or
+// DEVICE_RESPONSE_TIMEOUT has passed
+static void readCommandReply(responseParser_t &parser, unsigned long start)
+{
+  projectorParserBegin(parser, model);
+  while (!projectorCommandReplied(parser) && clockMillis() - start < DEVICE_RESPONSE_TIMEOUT)
+  {
+    while (!projectorCommandReplied(parser) && transportAvailable())
+    {
+      projectorParserFeed(parser, transportRead());
+    }
+    clockDelay(1);
+  }
+}
+
+static void sendAVCommand(AVControl control)
+{
+  avCommand_t &cmd = avCommands[(size_t)control];
+  const avControlInfo_t &info = AV_CONTROLS[(size_t)control];
+  bool accepted = true;
+
+  LOG_INFO("Sending %s %s", info.name, cmd.target ? "on" : "off");
+  cmd.start = clockMillis();
+
+  frame_t command = projectorAVCommand(model, control, cmd.target);
+  if (model == BeamerModel::DEMO)
+  {
+    setAttribute(info.attribute, cmd.target);
+  }
+  else if (command.length > 0)
+  {
+    transportWrite(command.data, command.length);
+    histogramAdd(stats.avWireLatency, micros() - cmd.queuedTime);
+
+    // Read the reply, it must not end up in the next poll
+    responseParser_t parser;
+    readCommandReply(parser, cmd.start);
+    accepted = projectorCommandAccepted(parser);
+  }
+  stats.avCommands++;
+
+  if (accepted)
+  {
+    cmd.status = CommandStatus::PENDING;
+  }
+  else
+  {
+    cmd.status = CommandStatus::FAILED;
+    cmd.time = clockMillis() - cmd.start;
+    stats.avFailed++;
+    LOG_WARN("%s %s rejected by the projector", info.name, cmd.target ? "on" : "off");
+  }
+}
+
+void deviceBegin(BeamerModel beamerModel, uint32_t baudrate)
+{
+  model = beamerModel;
+  configuredBaudRate = baudrate;
+  polledState = State::UNKNOWN;
+  demoState = State::UNKNOWN;
+  changed = 0;
+  benqNextQuery = 0;
+  powerCommand.status = CommandStatus::NONE;
+  for (avCommand_t &cmd : avCommands)
+  {
+    cmd.queued = false;
+    cmd.status = CommandStatus::NONE;
+  }
+  serialLink.probing = false;
+  serialLink.failStreak = 0;
+  stats.failStreak = 0;
+  stats.lastResult = PollResult::OK;
+  transportBegin(baudrate != 0 ? baudrate : LINK_BAUDRATES[0]);
+  if (baudrate == 0)
+  {
+    serialLinkProbe();
+  }
+}
+
+BeamerModel deviceModel()
+{
+  return model;
+}
+
+bool devicePoll()
+{
+  State lastState = polledState;
+  bool confirmed = true; // polledState was reported by the projector or determined by the link supervision
+
+  transportClear();
+
+  if (model == BeamerModel::DEMO)
+  {
+    polledState = demoState;
+    LOG_DEBUG("devicePoll: %s (Demomode)", projectorStateName(polledState));
+  }
+  else if (model == BeamerModel::BENQ || model == BeamerModel::CANON)
+  {
+    responseParser_t parser;
+    projectorParserBegin(parser, model);
+
+    if (model == BeamerModel::BENQ)
+    {
+      pollBenq(parser);
+    }
+    else
+    {
+      pollCanon(parser);
+    }
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+    if (model == BeamerModel::BENQ)
+    {
+      LOG_DEBUG("devicePoll: %s", (const char *)parser.buffer);
+    }
+    else
+    {
+      char hex[PROJECTOR_RESPONSE_MAX * 3 + 1];
+      hex[0] = 0;
+      for (unsigned int n = 0; n < parser.length; n++)
+      {
+        snprintf_P(hex + n * 3, 4, PSTR("%02x "), parser.buffer[n]);
+      }
+      LOG_DEBUG("devicePoll: %s(%u bytes, checksum %02x)", hex, (unsigned int)parser.length, parser.checksum);
+    }
+#endif
+
+    State state;
+    stats.lastResult = projectorParserResult(parser, state);
+    switch (stats.lastResult)
+    {
+    case PollResult::TIMEOUT:
+      stats.pollTimeouts++;
+      break;
+    case PollResult::CHECKSUM:
+      stats.pollChecksumErrors++;
+      break;
+    case PollResult::PARSE:
+      stats.pollParseErrors++;
+      break;
+    default:
+      break;
+    }
+    if (stats.lastResult != PollResult::OK)
+    {
+      LOG_DEBUG("devicePoll: %s", projectorPollResultName(stats.lastResult));
+    }
+
+    stats.failStreak = (stats.lastResult == PollResult::OK) ? 0 : min(stats.failStreak + 1, 255);
+    serialLinkUpdate(projectorResponseValid(parser), state);
+    confirmed = projectorResponseValid(parser) || polledState == State::UNKNOWN;
+
+    // The Canon status response carries more than the power state, the
+    // values are kept if the poll failed
+    canonStatus_t status;
+    if (projectorCanonStatus(parser, status))
+    {
+      setAttribute(Attribute::LAMP, status.processing);
+      setAttribute(Attribute::ERROR, status.processing == 0x06);
+      setAttribute(Attribute::DISPLAY, status.display);
+      setAttribute(Attribute::SOURCE, status.input);
+      setAttribute(Attribute::TERMINAL, status.terminal);
+      setAttribute(Attribute::VIDEO, status.video);
+      setAttribute(Attribute::BLANK, status.blank);
+      setAttribute(Attribute::SOUND_MUTE, status.soundMute);
+      setAttribute(Attribute::ONSCREEN_MUTE, status.onscreenMute);
+      setAttribute(Attribute::FREEZE, status.freeze);
+    }
+  }
+  else
+  {
+    polledState = State::UNKNOWN;
+  }
+
+  // A state held through invalid responses keeps its age, so it goes stale
+  if (confirmed)
+  {
+    cacheSet(Attribute::POWER, (int32_t)polledState);
+  }
+  if (polledState != lastState)
+  {
+    changed |= 1UL << (uint8_t)Attribute::POWER;
+  }
+  powerCommandUpdate();
+  avCommandUpdate();
+  return changed != 0;
+}
+
+void deviceSetPower(State state)
+{
+  unsigned long start = clockMillis();
+
+  LOG_INFO("Sending power %s sequence...", state == State::ON ? "ON" : "OFF");
+
+  if (model == BeamerModel::DEMO)
+  {
+    demoState = (state == State::ON) ? State::ON : State::OFF;
+  }
+
+  frame_t command = projectorPowerCommand(model, state);
+  if (command.length > 0)
+  {
+    transportWrite(command.data, command.length);
+  }
+
+  powerCommand.status = CommandStatus::PENDING;
+  powerCommand.target = state;
+  powerCommand.start = start;
+
+  if (model == BeamerModel::CANON)
+  {
+    // Canon answers with an ACK or NAK frame which must not end up in the
+    // next poll, a NAK fails the command right away
+    responseParser_t parser;
+    readCommandReply(parser, start);
+    if (projectorCommandReplied(parser) && !projectorCommandAccepted(parser))
+    {
+      powerCommand.status = CommandStatus::FAILED;
+      powerCommand.time = clockMillis() - start;
+      powerCommand.failed++;
+      LOG_WARN("Power %s rejected by the projector", projectorStateName(state));
+    }
+  }
+}
+
+void deviceQueueAV(AVControl control, bool on)
+{
+  avCommand_t &cmd = avCommands[(size_t)control];
+  cmd.queued = true;
+  cmd.target = on;
+  cmd.queuedTime = micros();
+}
+
+bool deviceSendAV()
+{
+  bool sent = false;
+  for (uint8_t c = 0; c < (uint8_t)AVControl::COUNT; c++)
+  {
+    if (avCommands[c].queued)
+    {
+      avCommands[c].queued = false;
+      sendAVCommand((AVControl)c);
+      sent = true;
+    }
+  }
+  return sent;
+}
+
+bool deviceAVQueued()
+{
+  for (const avCommand_t &cmd : avCommands)
+  {
+    if (cmd.queued)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+State deviceState()
+{
+  // Optimistic: the requested state until the projector confirms it
+  if (powerCommand.status == CommandStatus::PENDING)
+  {
+    return powerCommand.target;
+  }
+  int32_t power;
+  return cacheGet(Attribute::POWER, power) ? (State)power : State::UNKNOWN;
+}
+
+uint32_t devicePollInterval()
+{
+  bool pending = powerCommand.status == CommandStatus::PENDING;
+  for (const avCommand_t &cmd : avCommands)
+  {
+    pending = pending || cmd.status == CommandStatus::PENDING;
+  }
+  return pending ? DEVICE_CONFIRM_POLL_INTERVAL : DEVICE_POLL_INTERVAL;
+}
+
+uint32_t deviceChanged()
+{
+  return changed;
+}
+
+void deviceClearChanged()
+{
+  changed = 0;
+}
+
+const char *deviceCommandStatusName(CommandStatus status)
+{
+  switch (status)
+  {
+  case CommandStatus::PENDING:
+    return "pending";
+  case CommandStatus::CONFIRMED:
+    return "confirmed";
+  case CommandStatus::FAILED:
+    return "failed";
+  default:
+    return "none";
+  }
+}
+
+const powerCommand_t &devicePowerCommand()
+{
+  return powerCommand;
+}
+
+const avCommand_t &deviceAVCommand(AVControl control)
+{
+  return avCommands[(size_t)control];
+}
+
+const avControlInfo_t &deviceAVControl(AVControl control)
+{
+  return AV_CONTROLS[(size_t)control];
+}
+
+const serialLink_t &deviceLink()
+{
+  return serialLink;
+}
+
+const deviceStats_t &deviceGetStats()
+{
+  return stats;
+}
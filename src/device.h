@@ -0,0 +1,131 @@
+#ifndef device_h
+#define device_h
+
+#include <Arduino.h>
+#include "projector.h"
+#include "cache.h"
+#include "histogram.h"
+
+// The projector behind the serial transport: polls its state, keeps the
+// last power state while the serial link recovers, sends power, blank and
+// mute commands and confirms them with the polled state. Polled values go
+// to the cache (cache.h), publishing them is up to the caller. Builds on
+// the host with -D TRANSPORT_FAKE and -D CLOCK_VIRTUAL.
+
+#define DEVICE_POLL_INTERVAL 1000           // in ms
+#define DEVICE_CONFIRM_POLL_INTERVAL 250    // in ms, poll interval until a command is confirmed
+#define DEVICE_RESPONSE_TIMEOUT 100         // in ms
+#define DEVICE_POWER_CONFIRM_TIMEOUT 120000 // in ms, covers warm-up and cool-down
+#define DEVICE_AV_CONFIRM_TIMEOUT 5000      // in ms, blank and mute switch at once
+#define DEVICE_BENQ_QUERIES_PER_POLL 2      // low priority BenQ attributes asked in turn behind the power state
+#define DEVICE_LINK_FAIL_THRESHOLD 3        // invalid responses in a row until the link is re-probed, the last state is kept until then
+
+// Power and AV command confirmation
+enum class CommandStatus : uint8_t
+{
+    NONE,      // no command since boot
+    PENDING,   // target state reported, waiting for the projector
+    CONFIRMED, // projector reported the target state
+    FAILED     // rejected or not confirmed in time, polled state reported again
+};
+
+typedef struct
+{
+    CommandStatus status; // of the last command
+    State target;         // requested state
+    unsigned long start;  // clockMillis() of the command
+    unsigned long time;   // until confirmed or failed in ms
+    uint32_t confirmed;   // confirmed commands since boot
+    uint32_t failed;      // failed commands since boot
+    histogram_t latency;  // time until confirmation in ms
+} powerCommand_t;
+
+// AV command, the latest one per control is queued
+typedef struct
+{
+    bool queued;          // waiting for the serial link
+    bool target;          // requested state
+    uint32_t queuedTime;  // micros() when queued
+    CommandStatus status; // of the last command
+    unsigned long start;  // clockMillis() when sent
+    unsigned long time;   // until confirmed or failed in ms
+} avCommand_t;
+
+typedef struct
+{
+    const char *name;        // in commands and status messages
+    const char *command;     // status message field of the command status
+    const char *commandTime; // status message field of the command time
+    Attribute attribute;     // polled state
+    BenqQuery query;         // BenQ query of the state
+} avControlInfo_t;
+
+// Serial link supervisor
+typedef struct
+{
+    bool probing;             // link lost, every poll probes the next baud rate
+    uint8_t probeFirst;       // index in the probed baud rates where probing started
+    uint8_t probeIndex;       // probe attempt in the current pass
+    uint8_t failStreak;       // invalid responses in a row
+    unsigned long probeStart; // clockMillis() when probing started
+    unsigned long probeTime;  // duration of the last successful probing in ms
+    uint32_t probes;          // probe polls since boot
+    uint32_t recoveries;      // links found by probing since boot
+} serialLink_t;
+
+typedef struct
+{
+    uint32_t polls;              // number of device polls (without demo mode)
+    uint32_t pollTimeouts;       // polls without any response
+    uint32_t pollChecksumErrors; // Canon responses with wrong checksum
+    uint32_t pollParseErrors;    // responses which could not be decoded
+    uint32_t pollAttributes;     // attribute values received, power state excluded
+    histogram_t pollRoundTrip;   // time until the response was complete in ms
+    PollResult lastResult;       // result of the last poll
+    uint8_t failStreak;          // failed polls in a row
+    uint32_t avCommands;         // blank and mute commands sent
+    uint32_t avConfirmed;        // blank and mute commands confirmed by a poll
+    uint32_t avFailed;           // blank and mute commands rejected or not confirmed
+    histogram_t avWireLatency;   // time from the command until it was sent in us
+} deviceStats_t;
+
+// Starts the transport for the model, baud rate 0 probes the standard
+// rates. Resets the projector and command state, the stats are kept.
+void deviceBegin(BeamerModel model, uint32_t baudrate);
+BeamerModel deviceModel();
+
+// Polls the projector and confirms pending commands. Returns true if an
+// attribute changed since deviceClearChanged().
+bool devicePoll();
+
+// Sends a power command, the requested state is reported at once as
+// pending until a poll confirms it or DEVICE_POWER_CONFIRM_TIMEOUT
+void deviceSetPower(State state);
+
+// Queues a blank or mute command for deviceSendAV(), a newer command for
+// the same control replaces a queued one
+void deviceQueueAV(AVControl control, bool on);
+
+// Sends the queued commands, returns true if there were any
+bool deviceSendAV();
+bool deviceAVQueued();
+
+// Power state, optimistic: the requested one while a command is pending
+State deviceState();
+
+// Poll interval in ms, short while a command waits for confirmation
+uint32_t devicePollInterval();
+
+// Attribute bits (1 << Attribute) changed since the last clear
+uint32_t deviceChanged();
+void deviceClearChanged();
+
+const char *deviceCommandStatusName(CommandStatus status);
+
+const powerCommand_t &devicePowerCommand();
+const avCommand_t &deviceAVCommand(AVControl control);
+const avControlInfo_t &deviceAVControl(AVControl control);
+const serialLink_t &deviceLink();
+const deviceStats_t &deviceGetStats();
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef histogram_h
+#define histogram_h
+
+#include <Arduino.h>
+
+#define HISTOGRAM_MAX_BUCKETS 10
+
+typedef struct
+{
+    const uint32_t *bounds;                     // Upper bounds of the buckets, ascending
+    uint8_t count;                              // Number of bounds (max. HISTOGRAM_MAX_BUCKETS), +Inf is implicit
+    uint32_t buckets[HISTOGRAM_MAX_BUCKETS + 1]; // Observations per bucket (not cumulative), last one is +Inf
+    uint64_t sum;                               // Sum of all observations
+    uint32_t total;                             // Number of observations
+    uint32_t max;                               // Largest observation
+} histogram_t;
+
+// Creates a histogram with the given bounds array
+#define HISTOGRAM(bounds) {bounds, sizeof(bounds) / sizeof(*bounds), {0}, 0, 0, 0}
+
+inline void histogramAdd(histogram_t &h, uint32_t value)
+{
+    uint8_t i = 0;
+    while (i < h.count && value > h.bounds[i])
+    {
+        i++;
+    }
+    h.buckets[i]++;
+    h.sum += value;
+    h.total++;
+    if (value > h.max)
+    {
+        h.max = value;
+    }
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "leds.h"
+#include "clock.h"
+
+static uint32_t writes = 0;
+
+void ledBegin(led_t &led, uint16_t brightness)
+{
+  pinMode(led.pin, OUTPUT);
+  led.brightness = brightness;
+  led.written = -1;
+  ledUpdate(led);
+}
+
+void ledSetBrightness(led_t &led, uint16_t brightness)
+{
+  led.brightness = brightness;
+}
+
+void ledSetPattern(led_t &led, LEDPattern pattern, uint8_t code)
+{
+  if (led.pattern != pattern || led.code != code)
+  {
+    led.pattern = pattern;
+    led.code = code;
+    led.patternStart = clockMillis();
+  }
+}
+
+void ledActivity(led_t &led, uint32_t duration)
+{
+  led.activity = true;
+  led.activityUntil = clockMillis() + duration;
+  ledUpdate(led);
+}
+
+static bool patternOn(const led_t &led, uint32_t now)
+{
+  uint32_t elapsed = now - led.patternStart;
+
+  switch (led.pattern)
+  {
+  case LEDPattern::ON:
+    return true;
+  case LEDPattern::BLINK:
+    return (elapsed / LED_BLINK_TIME) % 2 == 0;
+  case LEDPattern::BOOT:
+    return (elapsed / LED_BOOT_TIME) % 2 == 0;
+  case LEDPattern::ERROR_CODE:
+  {
+    uint32_t pulses = led.code * 2 * LED_CODE_PULSE_TIME;
+    uint32_t pos = elapsed % (pulses + LED_CODE_PAUSE_TIME);
+    return pos < pulses && (pos / LED_CODE_PULSE_TIME) % 2 == 0;
+  }
+  default:
+    return false;
+  }
+}
+
+void ledUpdate(led_t &led)
+{
+  uint32_t now = clockMillis();
+
+  if (led.activity && (int32_t)(now - led.activityUntil) >= 0)
+  {
+    led.activity = false;
+  }
+
+  bool on = !led.activity && patternOn(led, now);
+  int32_t level;
+  if (led.pwm)
+  {
+    level = on ? led.brightness : 0;
+  }
+  else
+  {
+    level = (on != led.inverted) ? HIGH : LOW;
+  }
+
+  if (level == led.written)
+  {
+    return;
+  }
+
+  if (led.pwm)
+  {
+    analogWrite(led.pin, level);
+  }
+  else
+  {
+    digitalWrite(led.pin, level);
+  }
+  led.written = level;
+  writes++;
+}
+
+uint32_t ledWrites()
+{
+  return writes;
+}
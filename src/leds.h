@@ -0,0 +1,56 @@
+#ifndef leds_h
+#define leds_h
+
+#include <Arduino.h>
+
+// LED engine. Each LED holds its desired pattern, ledUpdate() computes the
+// output level from the pattern and writes to the hardware only if the
+// level changed.
+
+#define LED_BLINK_TIME 250      // in ms, on/off time of the blink pattern
+#define LED_BOOT_TIME 100       // in ms, on/off time of the boot pattern
+#define LED_CODE_PULSE_TIME 200 // in ms, on/off time of an error code pulse
+#define LED_CODE_PAUSE_TIME 1500 // in ms, pause between error code repetitions
+
+enum class LEDPattern : uint8_t
+{
+    OFF,
+    ON,
+    BLINK,      // Slow blink, e.g. connecting
+    ERROR_CODE, // 'code' pulses followed by a pause
+    BOOT        // Fast blink during startup
+};
+
+typedef struct
+{
+    uint8_t pin;
+    bool pwm;                // analogWrite() with brightness, otherwise digitalWrite()
+    bool inverted;           // LED is active low (digitalWrite() only)
+    uint16_t brightness;     // level for 'on' (PWM only)
+    LEDPattern pattern;      // desired pattern
+    uint8_t code;            // number of pulses for ERROR_CODE
+    uint32_t patternStart;   // clockMillis() when the pattern was set
+    uint32_t activityUntil;  // clockMillis() until the LED is switched off for an activity flash
+    bool activity;           // activity flash running
+    int32_t written;         // last level written to the pin, -1 = unknown
+} led_t;
+
+// Creates an LED entry, it is switched off on the first ledUpdate()
+#define LED(pin, pwm, inverted) {pin, pwm, inverted, 0, LEDPattern::OFF, 0, 0, 0, false, -1}
+
+void ledBegin(led_t &led, uint16_t brightness);
+void ledSetBrightness(led_t &led, uint16_t brightness);
+
+// Sets the pattern, the pattern timing restarts only if it changes
+void ledSetPattern(led_t &led, LEDPattern pattern, uint8_t code = 0);
+
+// Switches the LED off for the given time to indicate activity
+void ledActivity(led_t &led, uint32_t duration);
+
+// Writes the current level of the pattern if it changed
+void ledUpdate(led_t &led);
+
+// Number of writes to the LED pins since boot
+uint32_t ledWrites();
+
+#endif
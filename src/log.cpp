@@ -0,0 +1,170 @@
+#include "log.h"
+#include "clock.h"
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+static const char LEVEL_CHARS[] = "-EWID";
+static const uint8_t SYSLOG_SEVERITY[] = {7, 3, 4, 6, 7}; // per level
+static const uint8_t SYSLOG_FACILITY = 16;                // local0
+
+static char ring[LOG_BUFFER_SIZE];
+static uint32_t writePos = 0;  // total bytes written, index is writePos % LOG_BUFFER_SIZE
+static uint32_t serialPos = 0; // total bytes written to Serial
+static uint32_t syslogPos = 0; // total bytes sent to syslog
+static uint32_t dropped = 0;
+
+static WiFiUDP syslogUDP;
+static const char *syslogServer = "";
+static uint16_t syslogPort = 514;
+static const char *syslogHostname = "";
+static IPAddress syslogIP;         // looked up by logSyslogResolve()
+static bool syslogResolved = false;
+
+// Moves a read position forward if the writer has overtaken it, to the start of the next line
+static uint32_t catchUp(uint32_t pos)
+{
+  if (writePos - pos <= LOG_BUFFER_SIZE)
+  {
+    return pos;
+  }
+  pos = writePos - LOG_BUFFER_SIZE;
+  while (pos != writePos && ring[pos++ % LOG_BUFFER_SIZE] != '\n')
+  {
+  }
+  return pos;
+}
+
+void logPrintf(uint8_t level, PGM_P format, ...)
+{
+  char line[LOG_LINE_SIZE];
+  uint32_t now = clockMillis();
+  int len = snprintf_P(line, sizeof(line), PSTR("%6lu.%03lu %c "), now / 1000, now % 1000, LEVEL_CHARS[level]);
+
+  va_list args;
+  va_start(args, format);
+  int msgLen = vsnprintf_P(line + len, sizeof(line) - len - 1, format, args);
+  va_end(args);
+
+  if (msgLen < 0)
+  {
+    return;
+  }
+  len = min(len + msgLen, (int)sizeof(line) - 2);
+  line[len++] = '\n';
+
+  uint32_t before = catchUp(serialPos);
+  for (int i = 0; i < len; i++)
+  {
+    ring[(writePos + i) % LOG_BUFFER_SIZE] = line[i];
+  }
+  writePos += len;
+
+  uint32_t after = catchUp(serialPos);
+  dropped += after - before;
+  serialPos = after;
+}
+
+static void drainSyslog()
+{
+  if (!syslogResolved || WiFi.status() != WL_CONNECTED)
+  {
+    syslogPos = writePos;
+    return;
+  }
+
+  syslogPos = catchUp(syslogPos);
+  for (uint8_t n = 0; n < LOG_SYSLOG_LINES && syslogPos != writePos; n++)
+  {
+    // Copy one line, format is "<seconds>.<ms> <level> <message>\n"
+    char line[LOG_LINE_SIZE];
+    size_t len = 0;
+    while (syslogPos != writePos)
+    {
+      char c = ring[syslogPos++ % LOG_BUFFER_SIZE];
+      if (c == '\n')
+      {
+        break;
+      }
+      if (len < sizeof(line) - 1)
+      {
+        line[len++] = c;
+      }
+    }
+    line[len] = 0;
+
+    // The seconds are padded with blanks to six digits
+    const char *levelChar = line + strspn(line, " ");
+    levelChar = strchr(levelChar, ' ');
+    if (levelChar == nullptr || levelChar[1] == 0 || levelChar[2] != ' ')
+    {
+      continue;
+    }
+    const char *pos = strchr(LEVEL_CHARS, levelChar[1]);
+    uint8_t level = pos ? pos - LEVEL_CHARS : LOG_LEVEL_INFO;
+
+    syslogUDP.beginPacket(syslogIP, syslogPort);
+    syslogUDP.printf_P(PSTR("<%u>%s BeamerControl: %s"), SYSLOG_FACILITY * 8 + SYSLOG_SEVERITY[level], syslogHostname, levelChar + 3);
+    syslogUDP.endPacket();
+  }
+}
+
+void logDrain()
+{
+  // Serial, only as much as fits into the TX FIFO
+  serialPos = catchUp(serialPos);
+  while (serialPos != writePos)
+  {
+    size_t room = LOG_SERIAL.availableForWrite();
+    if (room == 0)
+    {
+      break;
+    }
+    size_t index = serialPos % LOG_BUFFER_SIZE;
+    size_t len = min((size_t)(writePos - serialPos), min(room, (size_t)(LOG_BUFFER_SIZE - index)));
+    LOG_SERIAL.write((const uint8_t *)ring + index, len);
+    serialPos += len;
+  }
+
+  drainSyslog();
+}
+
+void logSetSyslog(const char *server, uint16_t port, const char *hostname)
+{
+  syslogServer = server;
+  syslogPort = port;
+  syslogHostname = hostname;
+  syslogPos = writePos;
+  logSyslogResolve();
+}
+
+void logSyslogResolve()
+{
+  syslogResolved = false;
+  if (syslogServer[0] == 0 || WiFi.status() != WL_CONNECTED)
+  {
+    return;
+  }
+  syslogResolved = WiFi.hostByName(syslogServer, syslogIP) == 1;
+  if (!syslogResolved)
+  {
+    LOG_WARN("Syslog server %s not found, forwarding stopped until the next WiFi connect", syslogServer);
+  }
+}
+
+void logRead(void (*output)(const char *text, size_t length))
+{
+  uint32_t pos = catchUp(0);
+  size_t index = pos % LOG_BUFFER_SIZE;
+  size_t len = writePos - pos;
+  size_t first = min(len, (size_t)(LOG_BUFFER_SIZE - index));
+  output(ring + index, first);
+  if (len > first)
+  {
+    output(ring, len - first);
+  }
+}
+
+uint32_t logDropped()
+{
+  return dropped;
+}
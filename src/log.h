@@ -0,0 +1,74 @@
+#ifndef log_h
+#define log_h
+
+#include <Arduino.h>
+
+// Logging with compile-time levels. Messages above LOG_LEVEL are removed
+// by the preprocessor together with their format strings. The remaining
+// ones are formatted into a ring buffer which logDrain() writes to Serial
+// as far as the UART FIFO has room, and optionally to a UDP syslog server.
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_BUFFER_SIZE 2048 // ring buffer for the recent log
+#define LOG_LINE_SIZE 160    // max. length of a single message
+#define LOG_SYSLOG_LINES 4   // max. syslog packets per logDrain()
+
+// UART1 (TX only) if the projector uses UART0 (transport.h)
+#ifdef TRANSPORT_HARDWARE
+#define LOG_SERIAL Serial1
+#else
+#define LOG_SERIAL Serial
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(format, ...) logPrintf(LOG_LEVEL_ERROR, PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_ERROR(format, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(format, ...) logPrintf(LOG_LEVEL_WARN, PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_WARN(format, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(format, ...) logPrintf(LOG_LEVEL_INFO, PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_INFO(format, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(format, ...) logPrintf(LOG_LEVEL_DEBUG, PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(format, ...) ((void)0)
+#endif
+
+void logPrintf(uint8_t level, PGM_P format, ...);
+
+// Writes pending messages to Serial (non-blocking) and syslog
+void logDrain();
+
+// Forwards messages to a syslog server (RFC 3164 over UDP), empty server disables it
+void logSetSyslog(const char *server, uint16_t port, const char *hostname);
+
+// Looks up the syslog server address, blocks for the DNS round trip. Called
+// on every WiFi connect, messages go to the cached address until the next one.
+void logSyslogResolve();
+
+// Calls 'output' with the buffered log, oldest first, in up to two parts
+void logRead(void (*output)(const char *text, size_t length));
+
+// Messages dropped before they were written to Serial
+uint32_t logDropped();
+
+#endif
@@ -5,11 +5,27 @@
 #include <ESP8266WebServer.h>
 #include <ESP8266mDNS.h>
 #include <ESP8266HTTPUpdateServer.h>
-#include <SoftwareSerial.h>
 #include <PubSubClient.h> // API Doc: https://pubsubclient.knolleary.net/api.html
 #include <ArduinoJson.h>  // API Doc: https://arduinojson.org/v6/doc/
 #include <EEPROM.h>
 #include "settings.h"
+#include "config.h"
+#include "projector.h"
+#include "scheduler.h"
+#include "histogram.h"
+#include "watchdog.h"
+#include "button.h"
+#include "leds.h"
+#include "log.h"
+#include "alloccount.h"
+#include "memstats.h"
+#include "bench.h"
+#include "clock.h"
+#include "capture.h"
+#include "transport.h"
+#include "cache.h"
+#include "device.h"
+#include "status.h"
 
 // ++++++++++++++++++++++++++++++++++++++++
 //
@@ -20,38 +36,68 @@
 // Constants - Misc
 const char FIRMWARE_VERSION[] = "1.7";
 const char COMPILE_DATE[] = __DATE__ " " __TIME__;
-const int CURRENT_CONFIG_VERSION = 6;
+const int EEPROM_SIZE = 1024;
+static_assert(sizeof(configData_t) <= EEPROM_SIZE, "settings do not fit into the EEPROM area");
 const int HTTP_PORT = 80;
 const int PWMRANGE = 1023;
 
 // Constants - HW pins
 const int HWPIN_PUSHBUTTON = D3;
+#ifdef TRANSPORT_HARDWARE
+// UART0 uses D7/D8 and the log the TX of UART1, which is the board LED
+const int HWPIN_LED_BOARD = D0;
+const int HWPIN_LED_WIFI = D5;
+const int HWPIN_LED_MQTT = D6;
+#else
 const int HWPIN_LED_BOARD = LED_BUILTIN;
 const int HWPIN_LED_WIFI = D8;
 const int HWPIN_LED_MQTT = D7;
+#endif
 
 // Constants - Intervals (all in ms)
 const int LED_MQTT_MIN_TIME = 500;
 const int LED_WEB_MIN_TIME = 500;
+const int LED_ERROR_STREAK = 3; // failed polls in a row until the MQTT LED shows an error code
 const int TIME_BUTTON_LONGPRESS = 10000;
+const int TIME_BUTTON_COUNTDOWN = 2000; // start of config reset countdown while button is held
 const int state_PUBLISH_INTERVAL = 5000;
 const int MQTT_RECONNECT_INTERVAL = 2000;
-const int DEVICE_POLL_INTERVAL = 1000;
+const int SCHEDULER_MAX_IDLE = 10;
+const uint32_t CAPTURE_LINE_GAP = 2000; // in us, a longer pause starts a new line in the capture download
+const uint8_t CAPTURE_LINE_BYTES = 16;  // max. bytes per line in the capture download
+
+// Constants - Allocations
+const unsigned long ALLOC_WARMUP_TIME = 60000;    // in ms, allocations during startup are expected
+const unsigned long ALLOC_CHECK_INTERVAL = 10000; // in ms
+const char *const ALLOC_FREE_TASKS[] = {"leds", "button", "wifi", "poll"}; // tasks which must not allocate once running
+const uint8_t ALLOC_FREE_TASK_COUNT = sizeof(ALLOC_FREE_TASKS) / sizeof(*ALLOC_FREE_TASKS);
+
+// Constants - WiFi supervisor (all in ms)
+const unsigned long WIFI_RECONNECT_BACKOFF_MIN = 1000;
+const unsigned long WIFI_RECONNECT_BACKOFF_MAX = 60000;
+const unsigned long WIFI_CONNECT_TIMEOUT = 15000;
+const unsigned long WIFI_RSSI_SAMPLE_INTERVAL = 2000;
 
 // Constants - MQTT
 const char MQTT_SUBSCRIBE_CMD_TOPIC1[] = "%scmd";                // Subscribe patter without hostname
 const char MQTT_SUBSCRIBE_CMD_TOPIC2[] = "%s%s/cmd";             // Subscribe patter with hostname
 const char MQTT_PUBLISH_STATUS_TOPIC[] = "%s%s/status";          // Public pattern for status (normal and LWT) with hostname
+const char MQTT_PUBLISH_METRICS_TOPIC[] = "%s%s/metrics";        // Public pattern for metrics with hostname
+const unsigned int MQTT_METRICS_INTERVAL = 60;                   // Interval for metrics messages in s, 0 to disable
 const char MQTT_LWT_MESSAGE[] = "{\"bridge\":\"disconnected\"}"; // LWT message
+const uint16_t MQTT_BUFFER_SIZE = 1024;                          // Max. size of MQTT messages (status payload included)
 
 // Constants - NTP
 const char NTP_SERVER[] = "europe.pool.ntp.org";
+const char *const NTP_SERVERS[] = {NTP_SERVER, "pool.ntp.org", "time.nist.gov"}; // asked in turn if a server does not respond
 const long NTP_TIME_OFFSET = 0;                  // in s
 const unsigned long NTP_UPDATE_INTERVAL = 60000; // in ms
 
+// Constants - Metrics
+const char *const HTTP_ROUTE_NAMES[] = {"/", "/settings", "/fwupdate", "/switch", "/reboot", "/wifiscan", "/api/on", "/api/off", "/api/status", "/api/blank", "/api/mute", "/metrics", "/trace", "/log", "/bench", "/capture", "notfound"};
+
 // Constants - Serial
-const int HWSERIAL_BAUD = 115200;
-const int SWSERIAL_DEFAULT_BAUDRATE = 19200;
+const int HWSERIAL_BAUD = 115200; // log
 
 // ++++++++++++++++++++++++++++++++++++++++
 //
@@ -59,21 +105,6 @@ const int SWSERIAL_DEFAULT_BAUDRATE = 19200;
 //
 // ++++++++++++++++++++++++++++++++++++++++
 
-enum class State
-{
-  // STARTING,
-  ON,
-  // SHUTDOWN,
-  OFF,
-  UNKNOWN
-};
-enum class BeamerModel
-{
-  DEMO,
-  BENQ,
-  CANON,
-  UNKNOWN
-};
 enum class StatusTrigger
 {
   PERIODIC,
@@ -81,10 +112,54 @@ enum class StatusTrigger
   CMD,
   BUTTON
 };
+enum class LEDCode : uint8_t
+{
+  NO_BROKER = 2,
+  SERIAL_TIMEOUT = 3,
+  SERIAL_ERROR = 4
+};
 enum class APICMD
 {
   ON,
-  OFF
+  OFF,
+  BLANK_ON,
+  BLANK_OFF,
+  MUTE_ON,
+  MUTE_OFF
+};
+enum class HTTPRoute
+{
+  ROOT,
+  SETTINGS,
+  FWUPDATE,
+  SWITCH,
+  REBOOT,
+  WIFISCAN,
+  API_ON,
+  API_OFF,
+  API_STATUS,
+  API_BLANK,
+  API_MUTE,
+  METRICS,
+  TRACE,
+  LOG,
+  BENCH,
+  CAPTURE,
+  NOTFOUND,
+  COUNT
+};
+enum class TracePhase : uint8_t
+{
+  // Phases 0 to TASK_COUNT - 1 are the scheduler tasks
+  WIFI_SCAN = 0x20,
+  MQTT_CONNECT,
+  SERIAL_CMD
+};
+enum class LinkState
+{
+  DOWN,       // No link, waiting for next reconnect attempt
+  CONNECTING, // Reconnect attempt in progress
+  UP          // Link established and got IP
 };
 
 // ++++++++++++++++++++++++++++++++++++++++
@@ -102,9 +177,6 @@ WiFiClient espClient;
 // MQTT Client
 PubSubClient client(espClient);
 
-// Software
-SoftwareSerial swSer(D6, D5);
-
 // OTA Updater
 ESP8266HTTPUpdateServer httpUpdater;
 
@@ -121,31 +193,79 @@ NTPClient timeClient(ntpUDP, NTP_SERVER, NTP_TIME_OFFSET, NTP_UPDATE_INTERVAL);
 // Buffers
 String html;
 char buff[255];
+char statusPayload[MQTT_BUFFER_SIZE];          // MQTT status message, static to keep it off heap and stack
+StaticJsonDocument<MQTT_BUFFER_SIZE> statusDoc; // MQTT status message document
 
 // Config
 uint16_t cfgStart = 0;        // Start address in EEPROM for structure 'cfg'
 configData_t cfg;             // Instance 'cfg' is a global variable with 'configData_t' structure now
 bool configIsDefault = false; // true if no valid config found in eeprom and defaults settings loaded
 
+// LEDs
+led_t ledBoard = LED(HWPIN_LED_BOARD, false, true);
+led_t ledWiFi = LED(HWPIN_LED_WIFI, true, false);
+led_t ledMQTT = LED(HWPIN_LED_MQTT, true, false);
+
 // Runtime default config values
-BeamerModel beamerModel = BeamerModel::UNKNOWN;
 int ledBrightness = PWMRANGE;
 
 // Variables will change
-bool ledOneToggle = false;
-bool ledTwoToggle = false;
-State currentBeamerState = State::UNKNOWN;
-State demoBeamerState = State::UNKNOWN;
 char mqtt_prefix[50];
-unsigned long lastDevicePollTime = 0;       // will store last beamer state time
+char hostname[33];                // cached WiFi.hostname()
+char mqttStatusTopic[100];        // cached status topic
+char mqttMetricsTopic[100];       // cached metrics topic
 unsigned long lastPublishTime = 0;          // will store last publish time
-unsigned long ledOneTime = 0;               // will store last time LED was updated
-unsigned long ledTwoTime = 0;               // will store last time LED was updated
 unsigned long mqttLastReconnectAttempt = 0; // will store last time reconnect to mqtt broker
-bool previousButtonState = 1;               // will store last Button state. 1 = unpressed, 0 = pressed
-unsigned long buttonTimer = 0;              // will store how long button was pressed
+uint32_t buttonCountdown = 0;               // will store last reported seconds until config reset
+uint32_t steadyAllocs[ALLOC_FREE_TASK_COUNT]; // will store allocations of allocation free tasks after warm-up
+bool steadyAllocsSet = false;                 // will store if steadyAllocs is set
+uint32_t steadyLinkProbes = 0;                // will store serial link probes at the last allocation check
+bool statusRequested = false;                 // will store if a status push waits for the next poll
+
+// WiFi supervisor
+typedef struct
+{
+  LinkState state;                   // current link state
+  unsigned long stateSince;          // clockMillis() of last state change
+  unsigned long linkDownSince;       // clockMillis() when link was lost
+  unsigned long nextAttempt;         // clockMillis() of next reconnect attempt
+  unsigned long backoff;             // current reconnect backoff in ms
+  unsigned long offlineTime;         // accumulated time without link in ms (completed outages only)
+  unsigned long lastReconnectTime;   // duration of last outage in ms
+  unsigned long maxReconnectTime;    // longest outage since boot in ms
+  unsigned long lastRSSISample;      // clockMillis() of last RSSI sample
+  uint32_t disconnects;              // number of link losses since boot
+  uint32_t reconnectAttempts;        // number of WiFi.begin() calls by the supervisor
+  int16_t rssiFast;                  // RSSI EMA (alpha 1/4), in 1/16 dBm
+  int16_t rssiSlow;                  // RSSI EMA (alpha 1/32), in 1/16 dBm
+  volatile uint8_t disconnectReason; // last reason code reported by the SDK
+} wifiSupervisor_t;
+wifiSupervisor_t wifiSV = {LinkState::DOWN, 0, 0, 0, WIFI_RECONNECT_BACKOFF_MIN, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+WiFiEventHandler wifiDisconnectHandler;
+
+// Metrics
+typedef struct
+{
+  uint32_t mqttPublishes;                            // successful publishes
+  uint32_t mqttPublishFailures;                      // failed publishes
+  uint32_t mqttReconnects;                           // successful broker connects
+  uint32_t mqttReconnectFailures;                    // failed broker connects
+  uint32_t httpRequests[(size_t)HTTPRoute::COUNT];   // requests per route
+  unsigned long lastMetricsPublishTime;              // clockMillis() of last metrics message
+} metrics_t;
+metrics_t metrics = {0, 0, 0, 0, {0}, 0};
+
+// Chunked HTTP responses
+char chunkBuff[512]; // Chunk buffer for /metrics and /trace
+size_t chunkLen = 0;
+
+// Scheduler task table (see TASKS section)
+extern task_t tasks[];
+extern const uint8_t TASK_COUNT;
 
 void HTMLHeader(const char section[], unsigned int refresh = 0, const char url[] = "/");
+void pollDeviceState();
+void taskAVCommands();
 
 // ++++++++++++++++++++++++++++++++++++++++
 //
@@ -153,11 +273,22 @@ void HTMLHeader(const char section[], unsigned int refresh = 0, const char url[]
 //
 // ++++++++++++++++++++++++++++++++++++++++
 
-void clearSerialBuffer()
+const char *tracePhaseName(uint8_t phase)
 {
-  while (swSer.available())
+  if (phase < TASK_COUNT)
   {
-    swSer.read();
+    return tasks[phase].name;
+  }
+  switch ((TracePhase)phase)
+  {
+  case TracePhase::WIFI_SCAN:
+    return "wifiscan";
+  case TracePhase::MQTT_CONNECT:
+    return "mqttconnect";
+  case TracePhase::SERIAL_CMD:
+    return "serialcmd";
+  default:
+    return "unknown";
   }
 }
 
@@ -165,8 +296,6 @@ void HTMLHeader(const char *section, unsigned int refresh, const char *url)
 {
 
   char title[50];
-  char hostname[50];
-  WiFi.hostname().toCharArray(hostname, 50);
   snprintf(title, 50, "BeamerControl@%s - %s", hostname, section);
 
   html = "<!DOCTYPE html>";
@@ -290,6 +419,7 @@ void HTMLHeader(const char *section, unsigned int refresh, const char *url)
   html += "<li><a href='/switch'>Switch</a></li>\n";
   html += "<li><a href='/settings'>Settings</a></li>\n";
   html += "<li><a href='/wifiscan'>WiFi Scan</a></li>\n";
+  html += "<li><a href='/log'>Log</a></li>\n";
   html += "<li><a href='/fwupdate'>FW Update</a></li>\n";
   html += "<li><a href='/reboot'>Reboot</a></li>\n";
   html += "</ul>\n";
@@ -320,16 +450,15 @@ long dBm2Quality(long dBm)
 
 State getState()
 {
-  return currentBeamerState;
+  return deviceState();
 }
 
 void showMQTTAction()
 {
-  analogWrite(HWPIN_LED_MQTT, 0);
-  ledTwoTime = millis();
+  ledActivity(ledMQTT, LED_MQTT_MIN_TIME);
 }
 
-String getStatusTriggerString(StatusTrigger statusTrigger)
+const char *getStatusTriggerString(StatusTrigger statusTrigger)
 {
   switch (statusTrigger)
   {
@@ -351,367 +480,360 @@ String getStatusTriggerString(StatusTrigger statusTrigger)
   }
 }
 
-String getBeamerModel(boolean shortversion = false)
+const char *getBeamerModel()
+{
+  return projectorModelName(deviceModel());
+}
+
+const char *getStateString()
+{
+  return projectorStateName(getState());
+}
+
+const char *getLinkStateString()
 {
-  String str;
-  switch (beamerModel)
+  switch (wifiSV.state)
   {
-  case BeamerModel::CANON:
-    str = "Canon";
-    break;
-  case BeamerModel::BENQ:
-    str = "Benq";
-    break;
-  case BeamerModel::DEMO:
-    str = "Demo";
-    break;
+  case LinkState::UP:
+    return "up";
+  case LinkState::CONNECTING:
+    return "connecting";
   default:
-    str = "Unkown";
-    break;
+    return "down";
   }
+}
 
-  if (shortversion)
-  {
-    return str;
-  }
-  else
+bool WiFiLinkUp()
+{
+  return wifiSV.state == LinkState::UP;
+}
+
+// Time without link in ms since boot, including a currently running outage
+unsigned long WiFiOfflineTime()
+{
+  if (WiFiLinkUp())
   {
-    return str + " (" + (configIsDefault ? SWSERIAL_DEFAULT_BAUDRATE : cfg.beamerbaudrate) + " Baud)";
+    return wifiSV.offlineTime;
   }
+  return wifiSV.offlineTime + (clockMillis() - wifiSV.linkDownSince);
 }
 
-String getStateString()
+// RSSI trend in dBm, > 0 signal is improving, < 0 signal is degrading
+int WiFiRSSITrend()
 {
-  switch (getState())
+  return (wifiSV.rssiFast - wifiSV.rssiSlow) / 16;
+}
+
+void WiFiSetLinkState(LinkState state)
+{
+  wifiSV.state = state;
+  wifiSV.stateSince = clockMillis();
+}
+
+void WiFiSampleRSSI()
+{
+  if (clockMillis() - wifiSV.lastRSSISample < WIFI_RSSI_SAMPLE_INTERVAL)
   {
-    /*case State::STARTING:
-    return "Starting";
-    break;*/
-  case State::ON:
-    return "On";
-    break;
-    /*case State::SHUTDOWN:
-    return "Shutdown";
-    break;*/
-  case State::OFF:
-    return "Off";
-    break;
-  default:
-    return "Unkown";
-    break;
+    return;
+  }
+  wifiSV.lastRSSISample = clockMillis();
+
+  int16_t rssi = WiFi.RSSI() * 16;
+  if (wifiSV.rssiSlow == 0)
+  {
+    // First sample after boot
+    wifiSV.rssiFast = rssi;
+    wifiSV.rssiSlow = rssi;
+  }
+  else
+  {
+    wifiSV.rssiFast += (rssi - wifiSV.rssiFast) / 4;
+    wifiSV.rssiSlow += (rssi - wifiSV.rssiSlow) / 32;
   }
 }
 
-void MQTTpublishStatus(StatusTrigger statusTrigger)
+void WiFiSupervisorBegin()
 {
-  showMQTTAction();
-  // Serial.println(F("-----------------------"));
-  Serial.print(F("Publish MQTT status message\n"));
-  Serial.print(F("State: "));
-  uint16_t mqtt_buffersize = client.getBufferSize();
+  // The supervisor takes over reconnection from the SDK
+  WiFi.setAutoReconnect(false);
+  wifiDisconnectHandler = WiFi.onStationModeDisconnected([](const WiFiEventStationModeDisconnected &event)
+                                                         { wifiSV.disconnectReason = event.reason; });
 
-  char payload[mqtt_buffersize];
-  DynamicJsonDocument jsondoc(mqtt_buffersize);
+  WiFiSetLinkState(WiFi.status() == WL_CONNECTED ? LinkState::UP : LinkState::CONNECTING);
+  wifiSV.linkDownSince = clockMillis();
+}
 
-  switch (getState())
+void WiFiSupervisor()
+{
+  bool connected = (WiFi.status() == WL_CONNECTED);
+
+  switch (wifiSV.state)
   {
-  /*case State::STARTING:
-    Serial.println(F("Publish State STARTING"));
-    break;*/
-  case State::ON:
-    Serial.println(F("ON"));
-    jsondoc["pwrstate"] = "on";
+  case LinkState::UP:
+    if (connected)
+    {
+      WiFiSampleRSSI();
+      break;
+    }
+    wifiSV.disconnects++;
+    wifiSV.linkDownSince = clockMillis();
+    wifiSV.backoff = WIFI_RECONNECT_BACKOFF_MIN;
+    wifiSV.nextAttempt = clockMillis() + wifiSV.backoff;
+    WiFiSetLinkState(LinkState::DOWN);
+    LOG_WARN("WiFi link lost (reason %u)", wifiSV.disconnectReason);
     break;
-  /*case State::SHUTDOWN:
-    Serial.println(F("Publish State SHUTDOWN"));
-    break;*/
-  case State::OFF:
-    Serial.println(F("OFF"));
-    jsondoc["pwrstate"] = "off";
+
+  case LinkState::CONNECTING:
+    if (connected)
+    {
+      wifiSV.lastReconnectTime = clockMillis() - wifiSV.linkDownSince;
+      wifiSV.offlineTime += wifiSV.lastReconnectTime;
+      if (wifiSV.lastReconnectTime > wifiSV.maxReconnectTime)
+      {
+        wifiSV.maxReconnectTime = wifiSV.lastReconnectTime;
+      }
+      wifiSV.backoff = WIFI_RECONNECT_BACKOFF_MIN;
+      WiFiSetLinkState(LinkState::UP);
+      LOG_INFO("WiFi link up again after %lu ms", wifiSV.lastReconnectTime);
+      logSyslogResolve();
+    }
+    else if (clockMillis() - wifiSV.stateSince >= WIFI_CONNECT_TIMEOUT)
+    {
+      // Give up this attempt and wait before the next one
+      WiFi.disconnect();
+      wifiSV.nextAttempt = clockMillis() + wifiSV.backoff;
+      LOG_WARN("WiFi reconnect attempt failed (reason %u), next in %lu ms", wifiSV.disconnectReason, wifiSV.backoff);
+      wifiSV.backoff = min(wifiSV.backoff * 2, WIFI_RECONNECT_BACKOFF_MAX);
+      WiFiSetLinkState(LinkState::DOWN);
+    }
     break;
-  case State::UNKNOWN:
-    Serial.println(F("UNKNOWN"));
-    jsondoc["pwrstate"] = "unknown";
+
+  case LinkState::DOWN:
+    if ((long)(clockMillis() - wifiSV.nextAttempt) >= 0)
+    {
+      LOG_INFO("WiFi reconnect attempt to '%s'", cfg.wifi_ssid);
+      wifiSV.reconnectAttempts++;
+      WiFi.begin(cfg.wifi_ssid, cfg.wifi_psk);
+      WiFiSetLinkState(LinkState::CONNECTING);
+    }
     break;
   }
+}
+
+// Serializes the status message to statusPayload, returns its length
+size_t MQTTbuildStatus(StatusTrigger statusTrigger)
+{
+  JsonDocument &jsondoc = statusDoc;
+  jsondoc.clear();
 
+  statusAddDevice(jsondoc);
   jsondoc["trigger"] = getStatusTriggerString(statusTrigger);
-  jsondoc["model"] = getBeamerModel(true);
+  jsondoc["model"] = getBeamerModel();
   jsondoc["note"] = cfg.note;
   jsondoc["timestamp"] = timeClient.getEpochTime();
+  jsondoc["timestamp_ms"] = timeClient.getEpochMillis();
   jsondoc["firmware"] = FIRMWARE_VERSION;
   jsondoc["wifi_rssi"] = WiFi.RSSI();
+  jsondoc["wifi_rssi_trend"] = WiFiRSSITrend();
+  jsondoc["wifi_disconnects"] = wifiSV.disconnects;
+  jsondoc["wifi_disconnect_reason"] = wifiSV.disconnectReason;
+  jsondoc["wifi_offline_time"] = WiFiOfflineTime() / 1000;
+  jsondoc["wifi_reconnect_time"] = wifiSV.lastReconnectTime;
 
-  size_t payloadSize = serializeJson(jsondoc, payload, sizeof(payload));
+  return serializeJson(jsondoc, statusPayload, sizeof(statusPayload));
+}
 
-  snprintf(buff, sizeof(buff), MQTT_PUBLISH_STATUS_TOPIC, mqtt_prefix, WiFi.hostname().c_str());
+void MQTTpublishStatus(StatusTrigger statusTrigger)
+{
+  showMQTTAction();
+  char *payload = statusPayload;
+  size_t payloadSize = MQTTbuildStatus(statusTrigger);
 
-  Serial.printf_P(PSTR("Payload-/Buffersize: %i/%i bytes (%i%%)\n"), payloadSize, mqtt_buffersize, (int)((100.00 / (double)mqtt_buffersize) * payloadSize));
-  Serial.printf_P(PSTR("Topic: %s\nMessage: "), buff);
-  serializeJsonPretty(jsondoc, Serial);
-  Serial.println();
+  LOG_INFO("Publish MQTT status message (%s, %s)", getStateString(), getStatusTriggerString(statusTrigger));
+  LOG_DEBUG("Payload-/Buffersize: %i/%i bytes (%i%%)", payloadSize, sizeof(statusPayload), (int)((100.00 / (double)sizeof(statusPayload)) * payloadSize));
+  LOG_DEBUG("Topic: %s", mqttStatusTopic);
+  LOG_DEBUG("Message: %.*s", (int)payloadSize, payload);
+  deviceClearChanged();
 
-  if (!client.publish(buff, (uint8_t *)payload, (unsigned int)payloadSize, true))
+  if (!client.publish(mqttStatusTopic, (uint8_t *)payload, (unsigned int)payloadSize, true))
+  {
+    LOG_ERROR("Failed to publish message!");
+    metrics.mqttPublishFailures++;
+  }
+  else
   {
-    Serial.println(F("Failed to publish message!"));
+    metrics.mqttPublishes++;
   }
 
-  lastPublishTime = millis();
+  lastPublishTime = clockMillis();
 }
 
-void pollDeviceState()
+void MQTTpublishMetrics()
 {
-  size_t state_lenght;
-  unsigned int i = 0;
-  State lastBeamerState = currentBeamerState;
-
-  Serial.print(F("pollDeviceState: "));
-
-  clearSerialBuffer();
-
-  // Send Power State qestion to Beamer
-  if (beamerModel == BeamerModel::DEMO)
+  // Shares the status buffer, both are sent right away
+  char *payload = statusPayload;
+  const schedulerStats_t &schedStats = schedulerGetStats();
+  const memoryStats_t &memStats = memoryGetStats();
+  const deviceStats_t &deviceStats = deviceGetStats();
+
+  size_t payloadSize = snprintf_P(payload, sizeof(statusPayload),
+                                  PSTR("{\"uptime\":%lu,\"heap\":%u,\"heap_max_block\":%u,\"heap_frag\":%u,"
+                                       "\"heap_min\":%u,\"heap_max_block_min\":%u,\"stack_min\":%u,"
+                                       "\"loop_max\":%u,\"loop_avg\":%u,"
+                                       "\"poll\":[%u,%u,%u,%u],\"poll_rtt_avg\":%u,\"poll_rtt_max\":%u,"
+                                       "\"mqtt\":[%u,%u,%u,%u],\"wifi\":[%d,%u,%lu],\"ntp_age\":%ld}"),
+                                  clockMillis() / 1000, ESP.getFreeHeap(), ESP.getMaxFreeBlockSize(), ESP.getHeapFragmentation(),
+                                  memStats.minFreeHeap, memStats.minMaxBlock, memStats.minFreeStack,
+                                  schedStats.maxPassTime, schedStats.passTime.total ? (uint32_t)(schedStats.passTime.sum / schedStats.passTime.total) : 0,
+                                  deviceStats.polls, deviceStats.pollTimeouts, deviceStats.pollChecksumErrors, deviceStats.pollParseErrors,
+                                  deviceStats.pollRoundTrip.total ? (uint32_t)(deviceStats.pollRoundTrip.sum / deviceStats.pollRoundTrip.total) : 0, deviceStats.pollRoundTrip.max,
+                                  metrics.mqttPublishes, metrics.mqttPublishFailures, metrics.mqttReconnects, metrics.mqttReconnectFailures,
+                                  WiFi.RSSI(), wifiSV.disconnects, WiFiOfflineTime() / 1000,
+                                  timeClient.isTimeSet() ? (long)(timeClient.getLastUpdateAge() / 1000) : -1L);
+
+  if (payloadSize < sizeof(statusPayload) && client.publish(mqttMetricsTopic, (uint8_t *)payload, (unsigned int)payloadSize, false))
   {
-    currentBeamerState = demoBeamerState;
-    Serial.print(getStateString());
-    Serial.print(F(" (Demomode)\n"));
+    metrics.mqttPublishes++;
   }
-  else if (beamerModel == BeamerModel::BENQ)
+  else
   {
-
-    state_lenght = 50;
-    char buffer[state_lenght];
-
-    boolean readOn;
-    readOn = false;
-
-    swSer.print(F("\r*pow=?#\r"));
-
-    delay(100);
-    while (swSer.available())
-    {
-      char c = char(swSer.read());
-
-      if (c == 10)
-      { // From, but without NL
-        readOn = true;
-      }
-      else if (c != 13)
-      { // Than all, but without CR
-        if (readOn && i < state_lenght)
-        {
-          buffer[i] = c;
-          i += 1;
-        }
-      }
-    }
-    buffer[i] = 0;
-
-    Serial.println(buffer);
-
-    if (strcmp_P(buffer, PSTR("*POW=OFF#")) == 0)
-    {
-      currentBeamerState = State::OFF;
-    }
-    else if (strcmp_P(buffer, PSTR("*POW=ON#")) == 0)
-    {
-      currentBeamerState = State::ON;
-    }
-    else
-    {
-      currentBeamerState = State::UNKNOWN;
-    }
+    metrics.mqttPublishFailures++;
   }
-  else if (beamerModel == BeamerModel::CANON)
-  {
-    // Request    00H BFH 00H 00H 01H 02H C2H = 7
-    // Response   20H BFH 01H xxH 10H DATA01 to DATA16 CKS = 22
-    state_lenght = 22;
-    byte buffer[state_lenght];
-    byte checksum = 0;
 
-    byte GetData[] = {0x00, 0xbf, 0x00, 0x00, 0x01, 0x02, 0xc2};
-    swSer.write(GetData, 7);
+  metrics.lastMetricsPublishTime = clockMillis();
+}
 
-    delay(100);
-    while (swSer.available())
+// Poll cadence, fast while a command waits for confirmation
+void updatePollInterval()
+{
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
+  {
+    if (tasks[i].callback == pollDeviceState)
     {
-
-      byte b = swSer.read();
-      // int i = int(swSer.read());
-      Serial.printf_P(PSTR("%02x "), b);
-
-      if (i < state_lenght)
-      {
-        if (i < state_lenght - 1)
-        {
-          checksum += b;
-        }
-        buffer[i] = b;
-        i += 1;
-      }
+      schedulerSetPeriod(tasks[i], devicePollInterval());
     }
-    // buffer[i] = 0; nötig????
-
-    Serial.printf_P(PSTR(" (Checksum: %02x, Last byte: %02x, Result: "), checksum, buffer[21]);
+  }
+}
 
-    if (buffer[0] != 0x20)
-    {
-      // Response, but not success
-      Serial.println(F("No success response!)"));
-      currentBeamerState = State::UNKNOWN;
-    }
-    else if (buffer[21] != checksum)
-    {
-      // Checksum wrong
-      Serial.println(F("Checksum wrong!)"));
-      currentBeamerState = State::UNKNOWN;
-    }
-    else
+// Readers of stale attributes (cache.h): the poll runs in the next scheduler pass
+void requestPoll()
+{
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
+  {
+    if (tasks[i].callback == pollDeviceState)
     {
-      // Checksum verified
-      Serial.println(F("Checksum verified!)"));
-
-      switch (buffer[6])
-      {
-      case 0x00: // Idle
-        currentBeamerState = State::OFF;
-        break;
-      case 0x03: // Undocumented: Starting?
-        currentBeamerState = State::ON;
-        break;
-      case 0x04: // Power On
-        currentBeamerState = State::ON;
-        break;
-      case 0x05: // Cooling
-        currentBeamerState = State::ON;
-        break;
-      case 0x06: // Idle (Error Standby)
-        currentBeamerState = State::OFF;
-        break;
-      default:
-        currentBeamerState = State::UNKNOWN;
-        break;
-      }
+      schedulerTrigger(tasks[i]);
     }
   }
-  else
-  {
-    currentBeamerState = State::UNKNOWN;
-  }
+}
 
-  if (currentBeamerState != lastBeamerState)
+void pollDeviceState()
+{
+  if (devicePoll() || statusRequested)
   {
-    MQTTpublishStatus(StatusTrigger::POLL);
+    MQTTpublishStatus(statusRequested ? StatusTrigger::CMD : StatusTrigger::POLL);
+    statusRequested = false;
   }
+  updatePollInterval();
 }
 
-void showWEBAction()
+void showWEBAction(HTTPRoute route)
 {
-  analogWrite(HWPIN_LED_WIFI, 0);
-  ledOneTime = millis();
+  metrics.httpRequests[(size_t)route]++;
+  ledActivity(ledWiFi, LED_WEB_MIN_TIME);
 }
 
-void setState(State state)
+// Sends a power command and reports the requested state at once as pending,
+// polls at DEVICE_CONFIRM_POLL_INTERVAL until the projector confirms it
+void setState(State state, StatusTrigger trigger)
 {
+  watchdogEnter((uint8_t)TracePhase::SERIAL_CMD);
+  deviceSetPower(state);
+  watchdogExit((uint8_t)TracePhase::SERIAL_CMD);
 
-  // Switch Beamer ON
-  if (state == State::ON)
+  if (deviceModel() == BeamerModel::DEMO)
   {
-    Serial.println(F("Sending power ON sequence..."));
-    switch (beamerModel)
-    {
-    case BeamerModel::DEMO:
-      demoBeamerState = State::ON;
-      digitalWrite(HWPIN_LED_BOARD, false); // Switch on onboard LED to display the demo state
-      break;
-    case BeamerModel::BENQ:
-      swSer.print(F("\r*pow=on#\r"));
-      break;
-    case BeamerModel::CANON:
-    {
-      byte GetData[] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
-      swSer.write(GetData, 6);
-      delay(500);
-      clearSerialBuffer();
-      break;
-    }
-    default:
-      break;
-    }
-
-    // Switch Beamer OFF
+    // Switch the onboard LED to display the demo state
+    ledSetPattern(ledBoard, state == State::ON ? LEDPattern::ON : LEDPattern::OFF);
+    ledUpdate(ledBoard);
   }
-  else
+
+  updatePollInterval();
+  MQTTpublishStatus(trigger);
+}
+
+// Queues a blank or mute command, sent by taskAVCommands() in the next
+// scheduler pass. A newer command for the same control replaces a queued one.
+void queueAVCommand(AVControl control, bool on)
+{
+  deviceQueueAV(control, on);
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
   {
-    Serial.println(F("Sending power OFF sequence..."));
-    switch (beamerModel)
-    {
-    case BeamerModel::DEMO:
-      demoBeamerState = State::OFF;
-      digitalWrite(HWPIN_LED_BOARD, true); // Switch off onboard LED to display the demo State
-      break;
-    case BeamerModel::BENQ:
-      swSer.print(F("\r*pow=off#\r"));
-      break;
-    case BeamerModel::CANON:
+    if (tasks[i].callback == taskAVCommands)
     {
-      byte GetData[] = {0x02, 0x01, 0x00, 0x00, 0x00, 0x03};
-      swSer.write(GetData, 6);
-      delay(500);
-      clearSerialBuffer();
-      break;
-    }
-    default:
-      break;
+      schedulerTrigger(tasks[i]);
     }
   }
 }
 
-void toggleState()
+// Runs on demand, triggered by queueAVCommand(), ahead of the poll task so
+// queued commands do not wait for a poll
+void taskAVCommands()
+{
+  if (!deviceAVQueued())
+  {
+    return;
+  }
+  watchdogEnter((uint8_t)TracePhase::SERIAL_CMD);
+  deviceSendAV();
+  watchdogExit((uint8_t)TracePhase::SERIAL_CMD);
+  updatePollInterval();
+  MQTTpublishStatus(StatusTrigger::CMD);
+}
+
+void toggleState(StatusTrigger trigger)
 {
 
   switch (getState())
   {
   case State::ON:
-    setState(State::OFF);
+    setState(State::OFF, trigger);
     break;
   case State::OFF:
-    setState(State::ON);
+    setState(State::ON, trigger);
     break;
   default:
-    setState(State::ON);
+    setState(State::ON, trigger);
     break;
   }
 }
 
 void saveConfig()
 {
-  EEPROM.begin(512);
+  EEPROM.begin(EEPROM_SIZE);
   EEPROM.put(cfgStart, cfg);
-  delay(200);
+  clockDelay(200);
   EEPROM.commit(); // Only needed for ESP8266 to get data written
   EEPROM.end();
 }
 
 void eraseConfig()
 {
-  Serial.print(F("Erase EEPROM config..."));
-  EEPROM.begin(512);
+  LOG_WARN("Erase EEPROM config");
+  EEPROM.begin(EEPROM_SIZE);
   for (uint16_t i = cfgStart; i < sizeof(cfg); i++)
   {
     EEPROM.write(i, 0);
-    // Serial.printf_P(PSTR("Block %i of %i\n"), i, sizeof(cfg));
   }
-  delay(200);
+  clockDelay(200);
   EEPROM.commit();
   EEPROM.end();
-  Serial.print(F("done\n"));
 }
 
 void handleAPI(APICMD api)
 {
-  showWEBAction();
+  const HTTPRoute routes[] = {HTTPRoute::API_ON, HTTPRoute::API_OFF, HTTPRoute::API_BLANK, HTTPRoute::API_BLANK, HTTPRoute::API_MUTE, HTTPRoute::API_MUTE};
+  showWEBAction(routes[(size_t)api]);
   if (!server.authenticate(cfg.api_username, cfg.api_password))
   {
     return server.requestAuthentication();
@@ -721,11 +843,21 @@ void handleAPI(APICMD api)
     switch (api)
     {
     case APICMD::ON:
-      setState(State::ON);
+      setState(State::ON, StatusTrigger::CMD);
       server.send(200, "text/plain", "on");
       break;
     case APICMD::OFF:
-      setState(State::OFF);
+      setState(State::OFF, StatusTrigger::CMD);
+      server.send(200, "text/plain", "off");
+      break;
+    case APICMD::BLANK_ON:
+    case APICMD::MUTE_ON:
+      queueAVCommand(api == APICMD::BLANK_ON ? AVControl::BLANK : AVControl::MUTE, true);
+      server.send(200, "text/plain", "on");
+      break;
+    case APICMD::BLANK_OFF:
+    case APICMD::MUTE_OFF:
+      queueAVCommand(api == APICMD::BLANK_OFF ? AVControl::BLANK : AVControl::MUTE, false);
       server.send(200, "text/plain", "off");
       break;
     default:
@@ -737,7 +869,7 @@ void handleAPI(APICMD api)
 
 void handleSwitch()
 {
-  showWEBAction();
+  showWEBAction(HTTPRoute::SWITCH);
 
   if (!server.authenticate(cfg.admin_username, cfg.admin_password))
   {
@@ -754,11 +886,19 @@ void handleSwitch()
         {
           if (server.arg(i) == "On")
           {
-            setState(State::ON);
+            setState(State::ON, StatusTrigger::CMD);
           }
           else if (server.arg(i) == "Off")
           {
-            setState(State::OFF);
+            setState(State::OFF, StatusTrigger::CMD);
+          }
+          else if (server.arg(i) == "Blank on" || server.arg(i) == "Blank off")
+          {
+            queueAVCommand(AVControl::BLANK, server.arg(i) == "Blank on");
+          }
+          else if (server.arg(i) == "Mute on" || server.arg(i) == "Mute off")
+          {
+            queueAVCommand(AVControl::MUTE, server.arg(i) == "Mute on");
           }
         }
       }
@@ -769,6 +909,12 @@ void handleSwitch()
     html += "<input type='submit' name='action' value='On'>";
     html += "<input type='submit' name='action' value='Off'>";
     html += "</form>";
+    html += "<form method='POST' action='/switch'>";
+    html += "<input type='submit' name='action' value='Blank on'>";
+    html += "<input type='submit' name='action' value='Blank off'>";
+    html += "<input type='submit' name='action' value='Mute on'>";
+    html += "<input type='submit' name='action' value='Mute off'>";
+    html += "</form>";
 
     HTMLFooter();
     server.send(200, "text/html", html);
@@ -777,7 +923,7 @@ void handleSwitch()
 
 void handleFWUpdate()
 {
-  showWEBAction();
+  showWEBAction(HTTPRoute::FWUPDATE);
   if (!server.authenticate(cfg.admin_username, cfg.admin_password))
   {
     return server.requestAuthentication();
@@ -811,7 +957,7 @@ void handleFWUpdate()
 
 void handleNotFound()
 {
-  showWEBAction();
+  showWEBAction(HTTPRoute::NOTFOUND);
   HTMLHeader("File Not Found");
   html += "URI: ";
   html += server.uri();
@@ -831,7 +977,7 @@ void handleNotFound()
 
 void handleWiFiScan()
 {
-  showWEBAction();
+  showWEBAction(HTTPRoute::WIFISCAN);
   if (!server.authenticate(cfg.admin_username, cfg.admin_password))
   {
     return server.requestAuthentication();
@@ -841,7 +987,9 @@ void handleWiFiScan()
 
     HTMLHeader("WiFi Scan");
 
+    watchdogEnter((uint8_t)TracePhase::WIFI_SCAN);
     int n = WiFi.scanNetworks();
+    watchdogExit((uint8_t)TracePhase::WIFI_SCAN);
     if (n == 0)
     {
       html += "No networks found.\n";
@@ -917,7 +1065,7 @@ void handleWiFiScan()
 
 void handleReboot()
 {
-  showWEBAction();
+  showWEBAction(HTTPRoute::REBOOT);
   if (!server.authenticate(cfg.admin_username, cfg.admin_password))
   {
     return server.requestAuthentication();
@@ -944,22 +1092,22 @@ void handleReboot()
 
     if (reboot)
     {
-      delay(200);
-      ESP.reset();
+      clockDelay(200);
+      watchdogReset();
     }
   }
 }
 
 void handleRoot()
 {
-  showWEBAction();
+  showWEBAction(HTTPRoute::ROOT);
 
   HTMLHeader("Main");
 
   html += "<table>\n";
 
   char timebuf[20];
-  int sec = millis() / 1000;
+  int sec = clockMillis() / 1000;
   int min = sec / 60;
   int hr = min / 60;
   int days = hr / 24;
@@ -973,6 +1121,30 @@ void handleRoot()
   html += timeClient.getFormattedDate();
   html += " (UTC)</td>\n</tr>\n";
 
+  html += "<tr>\n<td>NTP:</td>\n<td>";
+  if (timeClient.isTimeSet())
+  {
+    html += timeClient.getServerName();
+    html += ", synced ";
+    html += timeClient.getLastUpdateAge() / 1000;
+    html += " s ago, round trip ";
+    html += timeClient.getLastRoundTrip();
+    html += " ms, correction ";
+    html += timeClient.getLastCorrection();
+    html += " ms, drift ";
+    html += timeClient.getDriftPPM();
+    html += " ppm";
+  }
+  else
+  {
+    html += "Not synced";
+  }
+  html += " (";
+  html += timeClient.getFailedRequests();
+  html += " failed requests, ";
+  html += timeClient.getFailedLookups();
+  html += " failed lookups)</td>\n</tr>\n";
+
   html += "<tr>\n<td>Firmware:</td>\n<td>v";
   html += FIRMWARE_VERSION;
   html += "</td>\n</tr>\n";
@@ -994,7 +1166,12 @@ void handleRoot()
 
   html += "<tr>\n<td>Beamer model:</td>\n<td>";
   html += getBeamerModel();
-  html += "</td>\n</tr>\n";
+  html += " (";
+  html += transportBaudRate();
+  html += " Baud";
+  html += (!configIsDefault && cfg.beamerbaudrate == 0 ? ", auto" : "");
+  html += (deviceLink().probing ? ", probing" : "");
+  html += ")</td>\n</tr>\n";
 
   html += "<tr>\n<td>Power state:</td>\n<td>";
   html += getStateString();
@@ -1012,7 +1189,7 @@ void handleRoot()
   html += "</td>\n</tr>\n";
 
   html += "<tr>\n<td>Hostname:</td>\n<td>";
-  html += WiFi.hostname().c_str();
+  html += hostname;
   html += "</td>\n</tr>\n";
 
   html += "<tr>\n<td>IP address:</td>\n<td>";
@@ -1039,123 +1216,523 @@ void handleRoot()
   html += dBm2Quality(WiFi.RSSI());
   html += "% (";
   html += WiFi.RSSI();
+  html += " dBm, trend ";
+  html += WiFiRSSITrend();
   html += " dBm)</td>\n</tr>\n";
 
+  html += "<tr>\n<td>WiFi link:</td>\n<td>";
+  html += getLinkStateString();
+  html += " (";
+  html += wifiSV.disconnects;
+  html += " disconnects, last reason ";
+  html += wifiSV.disconnectReason;
+  html += ", ";
+  html += WiFiOfflineTime() / 1000;
+  html += " s offline, last reconnect ";
+  html += wifiSV.lastReconnectTime;
+  html += " ms, max ";
+  html += wifiSV.maxReconnectTime;
+  html += " ms)</td>\n</tr>\n";
+
   html += "<tr>\n<td>Client IP:</td>\n<td>";
   html += server.client().remoteIP().toString().c_str();
   html += "</td>\n</tr>\n";
 
+  const memoryStats_t &memStats = memoryGetStats();
+  snprintf_P(buff, sizeof(buff), PSTR("<tr>\n<td>Heap:</td>\n<td>%u bytes free (min %u), largest block %u bytes (min %u)</td>\n</tr>\n"),
+             ESP.getFreeHeap(), memStats.minFreeHeap, ESP.getMaxFreeBlockSize(), memStats.minMaxBlock);
+  html += buff;
+  snprintf_P(buff, sizeof(buff), PSTR("<tr>\n<td>Stack:</td>\n<td>%u of %u bytes used (peak)</td>\n</tr>\n"),
+             memStats.stackSize - memStats.minFreeStack, memStats.stackSize);
+  html += buff;
+
   html += "</table>\n";
 
+  const schedulerStats_t &schedStats = schedulerGetStats();
+  html += "<br />\n<table>\n";
+  html += "<tr>\n<th>Task</th>\n<th>Period</th>\n<th>Runs</th>\n<th>Min</th>\n<th>Avg</th>\n<th>Max</th>\n<th>Budget</th>\n<th>Overruns</th>\n<th>Jitter</th>\n<th>Allocs</th>\n<th>Stack</th>\n<th>Heap</th>\n</tr>\n";
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
+  {
+    char period[16] = "on demand";
+    if (tasks[i].period != SCHEDULER_ON_DEMAND)
+    {
+      snprintf_P(period, sizeof(period), PSTR("%u ms"), tasks[i].period);
+    }
+    snprintf_P(buff, sizeof(buff), PSTR("<tr>\n<td>%s</td>\n<td>%s</td>\n<td>%u</td>\n<td>%u us</td>\n<td>%u us</td>\n<td>%u us</td>\n<td>%u us</td>\n<td>%u</td>\n<td>%u ms</td>\n"),
+               tasks[i].name, period, tasks[i].runs, taskMinTime(tasks[i]), taskAvgTime(tasks[i]), taskMaxTime(tasks[i]),
+               tasks[i].budget, tasks[i].overruns, tasks[i].maxLateness);
+    html += buff;
+    snprintf_P(buff, sizeof(buff), PSTR("<td>%u (max %u)</td>\n<td>%u bytes</td>\n<td>%u bytes</td>\n</tr>\n"),
+               tasks[i].allocs, tasks[i].maxAllocs, tasks[i].maxStack, tasks[i].maxHeap);
+    html += buff;
+  }
+  html += "</table>\n";
+  snprintf_P(buff, sizeof(buff), PSTR("%u scheduler passes, last %u us, max %u us, idle %u%%\n"),
+             schedStats.passes, schedStats.lastPassTime, schedStats.maxPassTime, (unsigned int)(schedStats.idleTime / (clockMillis() / 100 + 1)));
+  html += buff;
+
   HTMLFooter();
   server.send(200, "text/html", html);
 }
 
-void handleSettings()
+// Starts a chunked response, content is added with chunkPrintf()
+void chunkBegin(const char *contentType)
 {
-  showWEBAction();
-  Serial.println(F("Site: handleSettings"));
-  // HTTP Auth
-  if (!server.authenticate(cfg.admin_username, cfg.admin_password))
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, contentType, "");
+  chunkLen = 0;
+}
+
+void chunkEnd()
+{
+  server.sendContent(chunkBuff, chunkLen);
+  server.sendContent("");
+  chunkLen = 0;
+}
+
+// Appends to the chunk buffer and sends the chunk when full
+void chunkPrintf(PGM_P format, ...)
+{
+  for (uint8_t attempt = 0; attempt < 2; attempt++)
   {
-    return server.requestAuthentication();
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf_P(chunkBuff + chunkLen, sizeof(chunkBuff) - chunkLen, format, args);
+    va_end(args);
+
+    if (len >= 0 && chunkLen + len < sizeof(chunkBuff))
+    {
+      chunkLen += len;
+      return;
+    }
+    // Does not fit, flush and try again with an empty buffer
+    server.sendContent(chunkBuff, chunkLen);
+    chunkLen = 0;
   }
-  else
+}
+
+void metricsHistogram(const char *name, const char *help, const histogram_t &h)
+{
+  chunkPrintf(PSTR("# HELP %s %s\n# TYPE %s histogram\n"), name, help, name);
+  uint32_t cumulative = 0;
+  for (uint8_t i = 0; i < h.count; i++)
   {
-    Serial.println(F("Auth okay!"));
-    boolean saveandreboot = false;
-    String value;
-    if (server.method() == HTTP_POST)
-    { // Save Settings
+    cumulative += h.buckets[i];
+    chunkPrintf(PSTR("%s_bucket{le=\"%u\"} %u\n"), name, h.bounds[i], cumulative);
+  }
+  cumulative += h.buckets[h.count];
+  chunkPrintf(PSTR("%s_bucket{le=\"+Inf\"} %u\n%s_sum %llu\n%s_count %u\n"), name, cumulative, name, h.sum, name, h.total);
+}
 
-      for (uint8_t i = 0; i < server.args(); i++)
-      {
-        // Trim String
-        value = server.arg(i);
-        value.trim();
+void metricsValue(const char *name, const char *type, const char *help, long value)
+{
+  chunkPrintf(PSTR("# HELP %s %s\n# TYPE %s %s\n%s %ld\n"), name, help, name, type, name, value);
+}
 
-        // RF Note
-        if (server.argName(i) == "note")
-        {
-          value.toCharArray(cfg.note, sizeof(cfg.note) / sizeof(*cfg.note));
+void handleMetrics()
+{
+  showWEBAction(HTTPRoute::METRICS);
 
-        } // HTTP Auth Adminaccess Username
-        else if (server.argName(i) == "admin_username")
-        {
-          value.toCharArray(cfg.admin_username, sizeof(cfg.admin_username) / sizeof(*cfg.admin_username));
+  // Rendered in chunks from a static buffer, no String involved
+  chunkBegin("text/plain; version=0.0.4");
 
-        } // HTTP Auth Adminaccess Password
-        else if (server.argName(i) == "admin_password")
-        {
-          value.toCharArray(cfg.admin_password, sizeof(cfg.admin_password) / sizeof(*cfg.admin_password));
+  metricsValue("beamercontrol_uptime_seconds", "counter", "Time since boot", clockMillis() / 1000);
+  metricsValue("beamercontrol_power_state", "gauge", "Projector power state (0 = on, 1 = off, 2 = unknown)", (long)getState());
 
-        } // WiFi SSID
-        else if (server.argName(i) == "ssid")
-        {
-          value.toCharArray(cfg.wifi_ssid, sizeof(cfg.wifi_ssid) / sizeof(*cfg.wifi_ssid));
+  const schedulerStats_t &schedStats = schedulerGetStats();
+  metricsHistogram("beamercontrol_loop_time_microseconds", "Main loop pass time without idle", schedStats.passTime);
+  metricsValue("beamercontrol_loop_idle_milliseconds_total", "counter", "Time spent idle in the main loop", schedStats.idleTime);
+  chunkPrintf(PSTR("# HELP beamercontrol_task_runs_total Task runs\n# TYPE beamercontrol_task_runs_total counter\n"));
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
+  {
+    chunkPrintf(PSTR("beamercontrol_task_runs_total{task=\"%s\"} %u\n"), tasks[i].name, tasks[i].runs);
+  }
+  chunkPrintf(PSTR("# HELP beamercontrol_task_overruns_total Task runs exceeding the budget\n# TYPE beamercontrol_task_overruns_total counter\n"));
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
+  {
+    chunkPrintf(PSTR("beamercontrol_task_overruns_total{task=\"%s\"} %u\n"), tasks[i].name, tasks[i].overruns);
+  }
+  chunkPrintf(PSTR("# HELP beamercontrol_task_max_time_microseconds Longest task run\n# TYPE beamercontrol_task_max_time_microseconds gauge\n"));
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
+  {
+    chunkPrintf(PSTR("beamercontrol_task_max_time_microseconds{task=\"%s\"} %u\n"), tasks[i].name, taskMaxTime(tasks[i]));
+  }
+  chunkPrintf(PSTR("# HELP beamercontrol_task_max_lateness_milliseconds Longest delay between due time and start of a task\n# TYPE beamercontrol_task_max_lateness_milliseconds gauge\n"));
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
+  {
+    chunkPrintf(PSTR("beamercontrol_task_max_lateness_milliseconds{task=\"%s\"} %u\n"), tasks[i].name, tasks[i].maxLateness);
+  }
+  chunkPrintf(PSTR("# HELP beamercontrol_task_allocations_total Heap allocations by task\n# TYPE beamercontrol_task_allocations_total counter\n"));
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
+  {
+    chunkPrintf(PSTR("beamercontrol_task_allocations_total{task=\"%s\"} %u\n"), tasks[i].name, tasks[i].allocs);
+  }
+  chunkPrintf(PSTR("# HELP beamercontrol_task_max_stack_bytes Peak loop stack used by task\n# TYPE beamercontrol_task_max_stack_bytes gauge\n"));
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
+  {
+    chunkPrintf(PSTR("beamercontrol_task_max_stack_bytes{task=\"%s\"} %u\n"), tasks[i].name, tasks[i].maxStack);
+  }
+  chunkPrintf(PSTR("# HELP beamercontrol_task_max_heap_bytes Peak heap taken by task\n# TYPE beamercontrol_task_max_heap_bytes gauge\n"));
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
+  {
+    chunkPrintf(PSTR("beamercontrol_task_max_heap_bytes{task=\"%s\"} %u\n"), tasks[i].name, tasks[i].maxHeap);
+  }
+  metricsValue("beamercontrol_heap_allocations_total", "counter", "Heap allocations since boot", allocCount());
+
+  metricsValue("beamercontrol_heap_free_bytes", "gauge", "Free heap", ESP.getFreeHeap());
+  metricsValue("beamercontrol_heap_max_block_bytes", "gauge", "Largest free heap block", ESP.getMaxFreeBlockSize());
+  metricsValue("beamercontrol_heap_fragmentation_percent", "gauge", "Heap fragmentation", ESP.getHeapFragmentation());
+  const memoryStats_t &memStats = memoryGetStats();
+  metricsValue("beamercontrol_heap_free_min_bytes", "gauge", "Lowest free heap since boot", memStats.minFreeHeap);
+  metricsValue("beamercontrol_heap_max_block_min_bytes", "gauge", "Lowest largest free heap block since boot", memStats.minMaxBlock);
+  metricsValue("beamercontrol_stack_size_bytes", "gauge", "Loop stack size", memStats.stackSize);
+  metricsValue("beamercontrol_stack_free_min_bytes", "gauge", "Lowest free loop stack since boot", memStats.minFreeStack);
+
+  const deviceStats_t &deviceStats = deviceGetStats();
+  const powerCommand_t &powerCommand = devicePowerCommand();
+  metricsValue("beamercontrol_poll_total", "counter", "Projector status polls", deviceStats.polls);
+  metricsValue("beamercontrol_poll_timeouts_total", "counter", "Projector polls without response", deviceStats.pollTimeouts);
+  metricsValue("beamercontrol_poll_checksum_errors_total", "counter", "Projector responses with wrong checksum", deviceStats.pollChecksumErrors);
+  metricsValue("beamercontrol_poll_parse_errors_total", "counter", "Projector responses which could not be decoded", deviceStats.pollParseErrors);
+  metricsValue("beamercontrol_poll_attributes_total", "counter", "Projector attribute values received besides the power state", deviceStats.pollAttributes);
+  metricsHistogram("beamercontrol_poll_round_trip_milliseconds", "Time until the projector response was complete", deviceStats.pollRoundTrip);
+  metricsValue("beamercontrol_power_command_pending", "gauge", "Power command waiting for confirmation", powerCommand.status == CommandStatus::PENDING);
+  metricsValue("beamercontrol_power_commands_confirmed_total", "counter", "Power commands confirmed by the projector", powerCommand.confirmed);
+  metricsValue("beamercontrol_power_commands_failed_total", "counter", "Power commands not confirmed in time", powerCommand.failed);
+  metricsHistogram("beamercontrol_power_confirm_milliseconds", "Time until the projector confirmed a power command", powerCommand.latency);
+  metricsValue("beamercontrol_av_commands_total", "counter", "Blank and mute commands sent", deviceStats.avCommands);
+  metricsValue("beamercontrol_av_commands_confirmed_total", "counter", "Blank and mute commands confirmed by the projector", deviceStats.avConfirmed);
+  metricsValue("beamercontrol_av_commands_failed_total", "counter", "Blank and mute commands rejected or not confirmed in time", deviceStats.avFailed);
+  metricsHistogram("beamercontrol_av_command_wire_microseconds", "Time from a blank or mute command until it was sent to the projector", deviceStats.avWireLatency);
+
+  const transportStats_t &serialStats = transportGetStats();
+  chunkPrintf(PSTR("# HELP beamercontrol_serial_info Projector serial backend\n# TYPE beamercontrol_serial_info gauge\n"));
+  chunkPrintf(PSTR("beamercontrol_serial_info{backend=\"%s\",baud=\"%u\"} 1\n"), transportName(), transportBaudRate());
+  metricsValue("beamercontrol_serial_rx_bytes_total", "counter", "Bytes received from the projector", serialStats.rxBytes);
+  metricsValue("beamercontrol_serial_tx_bytes_total", "counter", "Bytes sent to the projector", serialStats.txBytes);
+  metricsValue("beamercontrol_serial_overflows_total", "counter", "Serial RX buffer overflows", serialStats.overflows);
+  metricsValue("beamercontrol_serial_rx_errors_total", "counter", "Serial framing or parity errors (hardware UART)", serialStats.rxErrors);
+  metricsValue("beamercontrol_serial_tx_time_milliseconds_total", "counter", "Time spent sending to the projector", (long)(serialStats.txTime / 1000));
+  const serialLink_t &serialLink = deviceLink();
+  metricsValue("beamercontrol_serial_link_probing", "gauge", "Serial link lost, probing baud rates", serialLink.probing);
+  metricsValue("beamercontrol_serial_link_probes_total", "counter", "Polls probing the serial link", serialLink.probes);
+  metricsValue("beamercontrol_serial_link_recoveries_total", "counter", "Serial links found by probing", serialLink.recoveries);
+  metricsValue("beamercontrol_serial_link_probe_milliseconds", "gauge", "Duration of the last successful probing", serialLink.probeTime);
+
+  const cacheStats_t &cacheStats = cacheGetStats();
+  metricsValue("beamercontrol_cache_hits_total", "counter", "Projector attribute reads served from the cache", cacheStats.hits);
+  metricsValue("beamercontrol_cache_refreshes_total", "counter", "Projector attribute reads which requested a poll", cacheStats.refreshes);
+  metricsValue("beamercontrol_cache_misses_total", "counter", "Projector attribute reads without a value of the accepted age", cacheStats.misses);
+  chunkPrintf(PSTR("# HELP beamercontrol_cache_age_milliseconds Age of the cached projector attribute\n# TYPE beamercontrol_cache_age_milliseconds gauge\n"));
+  for (uint8_t i = 0; i < (uint8_t)Attribute::COUNT; i++)
+  {
+    chunkPrintf(PSTR("beamercontrol_cache_age_milliseconds{attribute=\"%s\"} %ld\n"), cacheEntry((Attribute)i).name, (long)cacheAge((Attribute)i));
+  }
 
-        } // WiFi PSK
-        else if (server.argName(i) == "psk")
-        {
-          value.toCharArray(cfg.wifi_psk, sizeof(cfg.wifi_psk) / sizeof(*cfg.wifi_psk));
+  metricsValue("beamercontrol_mqtt_connected", "gauge", "MQTT broker connection", client.connected());
+  metricsValue("beamercontrol_mqtt_publishes_total", "counter", "Successful MQTT publishes", metrics.mqttPublishes);
+  metricsValue("beamercontrol_mqtt_publish_failures_total", "counter", "Failed MQTT publishes", metrics.mqttPublishFailures);
+  metricsValue("beamercontrol_mqtt_reconnects_total", "counter", "Successful MQTT broker connects", metrics.mqttReconnects);
+  metricsValue("beamercontrol_mqtt_reconnect_failures_total", "counter", "Failed MQTT broker connects", metrics.mqttReconnectFailures);
 
-        } // Hostname
-        else if (server.argName(i) == "hostname")
-        {
-          value.toCharArray(cfg.hostname, sizeof(cfg.hostname) / sizeof(*cfg.hostname));
+  chunkPrintf(PSTR("# HELP beamercontrol_http_requests_total HTTP requests per route\n# TYPE beamercontrol_http_requests_total counter\n"));
+  for (size_t i = 0; i < (size_t)HTTPRoute::COUNT; i++)
+  {
+    chunkPrintf(PSTR("beamercontrol_http_requests_total{route=\"%s\"} %u\n"), HTTP_ROUTE_NAMES[i], metrics.httpRequests[i]);
+  }
 
-        } // Beamer Model
-        else if (server.argName(i) == "beamermodel")
-        {
-          value.toCharArray(cfg.beamermodel, sizeof(cfg.beamermodel) / sizeof(*cfg.beamermodel));
-        } // Beamer Baud Rate
-        else if (server.argName(i) == "beamerbaudrate")
-        {
-          cfg.beamerbaudrate = value.toInt();
+  metricsValue("beamercontrol_wifi_rssi_dbm", "gauge", "WiFi signal strength", WiFi.RSSI());
+  metricsValue("beamercontrol_wifi_disconnects_total", "counter", "WiFi link losses", wifiSV.disconnects);
+  metricsValue("beamercontrol_wifi_offline_seconds_total", "counter", "Time without WiFi link", WiFiOfflineTime() / 1000);
 
-        } // MQTT Server
-        else if (server.argName(i) == "mqtt_server")
-        {
-          value.toCharArray(cfg.mqtt_server, sizeof(cfg.mqtt_server) / sizeof(*cfg.mqtt_server));
+  metricsValue("beamercontrol_ntp_synced", "gauge", "NTP time was synced at least once", timeClient.isTimeSet());
+  metricsValue("beamercontrol_ntp_sync_age_seconds", "gauge", "Time since last NTP sync", timeClient.isTimeSet() ? (long)(timeClient.getLastUpdateAge() / 1000) : -1);
+  metricsValue("beamercontrol_ntp_drift_ppm", "gauge", "Estimated drift of the local clock", timeClient.getDriftPPM());
 
-        } // MQTT Port
-        else if (server.argName(i) == "mqtt_port")
-        {
-          cfg.mqtt_port = value.toInt();
+  metricsValue("beamercontrol_log_dropped_bytes_total", "counter", "Log output dropped before it was written to Serial", logDropped());
+  metricsValue("beamercontrol_led_writes_total", "counter", "Writes to the LED pins", ledWrites());
+  metricsValue("beamercontrol_stalls_total", "counter", "Loop phases exceeding the stall threshold (persists soft resets)", watchdogCurrent().stallCount);
 
-        } // MQTT User
-        else if (server.argName(i) == "mqtt_user")
-        {
-          value.toCharArray(cfg.mqtt_user, sizeof(cfg.mqtt_user) / sizeof(*cfg.mqtt_user));
+  chunkEnd();
+}
 
-        } // MQTT Password
-        else if (server.argName(i) == "mqtt_password")
-        {
-          value.toCharArray(cfg.mqtt_password, sizeof(cfg.mqtt_password) / sizeof(*cfg.mqtt_password));
+void traceDump(const watchdogData_t &trace)
+{
+  chunkPrintf(PSTR("time_ms event phase duration_ms\n"));
+  for (uint8_t n = 0; n < WATCHDOG_TRACE_SIZE; n++)
+  {
+    const traceEntry_t &entry = trace.trace[(trace.traceHead + n) % WATCHDOG_TRACE_SIZE];
+    if (entry.event == TraceEvent::BOOT || entry.event == TraceEvent::RESET)
+    {
+      chunkPrintf(PSTR("%u %s - -\n"), entry.time, entry.event == TraceEvent::BOOT ? "boot" : "reset");
+    }
+    else if (entry.time != 0)
+    {
+      chunkPrintf(PSTR("%u exit %s %u\n"), entry.time, tracePhaseName(entry.phase), entry.duration);
+    }
+  }
+  // Phases still running (at reset for the previous boot)
+  for (uint8_t n = 0; n < trace.openDepth && n < WATCHDOG_MAX_DEPTH; n++)
+  {
+    chunkPrintf(PSTR("%u enter %s -\n"), trace.open[n].time, tracePhaseName(trace.open[n].phase));
+  }
+}
 
-        } // MQTT Prefix
-        else if (server.argName(i) == "mqtt_prefix")
-        {
-          value.toCharArray(cfg.mqtt_prefix, sizeof(cfg.mqtt_prefix) / sizeof(*cfg.mqtt_prefix));
+void handleTrace()
+{
+  showWEBAction(HTTPRoute::TRACE);
+  if (!server.authenticate(cfg.admin_username, cfg.admin_password))
+  {
+    return server.requestAuthentication();
+  }
+  else
+  {
+    const watchdogData_t &current = watchdogCurrent();
 
-        } // MQTT periodic update interval
-        else if (server.argName(i) == "mqtt_periodic_update_interval")
-        {
-          cfg.mqtt_periodic_update_interval = value.toInt();
-        } // LED Brightness
-        else if (server.argName(i) == "led_brightness")
-        {
-          cfg.led_brightness = value.toInt();
-        } // HTTP Auth API Username
-        else if (server.argName(i) == "api_username")
-        {
-          value.toCharArray(cfg.api_username, sizeof(cfg.api_username) / sizeof(*cfg.api_username));
-        } // HTTP Auth API Password
-        else if (server.argName(i) == "api_password")
+    chunkBegin("text/plain");
+    chunkPrintf(PSTR("# BeamerControl v%s, boot %u, uptime %lu ms, reset reason: %s\n"), FIRMWARE_VERSION, current.bootCount, clockMillis(), ESP.getResetReason().c_str());
+
+    chunkPrintf(PSTR("\n# Stalls (%u total, threshold %u ms)\nboot time_ms phase duration_ms\n"), current.stallCount, WATCHDOG_STALL_THRESHOLD);
+    for (uint8_t n = 0; n < WATCHDOG_STALL_SIZE; n++)
+    {
+      const stallEntry_t &stall = current.stalls[(current.stallHead + n) % WATCHDOG_STALL_SIZE];
+      if (stall.time == 0 && stall.duration == 0)
+      {
+        continue;
+      }
+      if (stall.duration == WATCHDOG_DURATION_UNKNOWN)
+      {
+        chunkPrintf(PSTR("%u %u %s reset\n"), stall.boot, stall.time, tracePhaseName(stall.phase));
+      }
+      else
+      {
+        chunkPrintf(PSTR("%u %u %s %u\n"), stall.boot, stall.time, tracePhaseName(stall.phase), stall.duration);
+      }
+    }
+
+    chunkPrintf(PSTR("\n# Trace current boot (phases from %u ms)\n"), WATCHDOG_TRACE_THRESHOLD);
+    traceDump(current);
+
+    if (watchdogHasPrevious())
+    {
+      chunkPrintf(PSTR("\n# Trace previous boot\n"));
+      traceDump(watchdogPrevious());
+    }
+
+    chunkEnd();
+  }
+}
+
+void logOutputHTML(const char *text, size_t length)
+{
+  // Escape HTML special characters
+  for (size_t i = 0; i < length; i++)
+  {
+    switch (text[i])
+    {
+    case '<':
+      html += "&lt;";
+      break;
+    case '>':
+      html += "&gt;";
+      break;
+    case '&':
+      html += "&amp;";
+      break;
+    default:
+      html += text[i];
+      break;
+    }
+  }
+}
+
+void handleLog()
+{
+  showWEBAction(HTTPRoute::LOG);
+  if (!server.authenticate(cfg.admin_username, cfg.admin_password))
+  {
+    return server.requestAuthentication();
+  }
+  else
+  {
+    HTMLHeader("Log", 10, "/log");
+    html.reserve(html.length() + LOG_BUFFER_SIZE + 256);
+    html += "<pre>";
+    logRead(logOutputHTML);
+    html += "</pre>\n";
+    html += logDropped();
+    html += " bytes dropped before they could be written to the serial console.\n";
+    HTMLFooter();
+    server.send(200, "text/html", html);
+  }
+}
+
+// Benchmark cases of the network side, the inputs are fixed so results
+// compare across versions. The projector cases are in bench.cpp.
+const char BENCH_MQTT_COMMAND[] = "{\"pwrstate\":\"on\",\"status\":\"get\"}";
+
+void benchStatusJson()
+{
+  MQTTbuildStatus(StatusTrigger::PERIODIC);
+}
+
+void benchCommandParse()
+{
+  mqttCommand_t cmd;
+  statusParseCommand((const byte *)BENCH_MQTT_COMMAND, sizeof(BENCH_MQTT_COMMAND) - 1, cmd);
+}
+
+void benchHTML()
+{
+  HTMLHeader("Bench");
+  HTMLFooter();
+  html = "";
+}
+
+benchmark_t benchmarks[] = {
+    BENCHMARK("status_json", benchStatusJson, 100),
+    BENCHMARK("command_parse", benchCommandParse, 100),
+    BENCHMARK("html_frame", benchHTML, 20),
+};
+
+void benchPrint(benchmark_t &bench, bool first)
+{
+  char result[160];
+  benchRun(bench);
+  benchFormat(bench, result, sizeof(result));
+  chunkPrintf(PSTR("%s%s"), first ? "" : ",", result);
+  yield();
+}
+
+void handleBench()
+{
+  showWEBAction(HTTPRoute::BENCH);
+  if (!server.authenticate(cfg.admin_username, cfg.admin_password))
+  {
+    return server.requestAuthentication();
+  }
+  else
+  {
+    chunkBegin("application/json");
+    chunkPrintf(PSTR("{\"firmware\":\"%s\",\"compiled\":\"%s\",\"cpu_mhz\":%u,\"results\":["), FIRMWARE_VERSION, COMPILE_DATE, ESP.getCpuFreqMHz());
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(*benchmarks); i++)
+    {
+      benchPrint(benchmarks[i], i == 0);
+    }
+    for (size_t i = 0; i < BENCH_PROJECTOR_CASES; i++)
+    {
+      benchPrint(benchProjectorCases[i], false);
+    }
+    chunkPrintf(PSTR("]}\n"));
+    chunkEnd();
+  }
+}
+
+// Cached projector attributes not older than the query argument maxage (in
+// ms, default the TTL), older ones are null and polled for the next request
+void handleAPIStatus()
+{
+  showWEBAction(HTTPRoute::API_STATUS);
+  if (!server.authenticate(cfg.api_username, cfg.api_password))
+  {
+    return server.requestAuthentication();
+  }
+  else
+  {
+    uint32_t maxAge = strtoul(server.arg(F("maxage")).c_str(), nullptr, 10);
+    chunkBegin("application/json");
+    for (uint8_t i = 0; i < (uint8_t)Attribute::COUNT; i++)
+    {
+      const cacheEntry_t &entry = cacheEntry((Attribute)i);
+      int32_t value;
+      chunkPrintf(PSTR("%s\"%s\":{"), i ? "," : "{", entry.name);
+      if (!cacheGet((Attribute)i, value, maxAge))
+      {
+        chunkPrintf(PSTR("\"value\":null}"));
+      }
+      else if (entry.text)
+      {
+        chunkPrintf(PSTR("\"value\":\"%s\",\"age_ms\":%u}"), entry.text(value), cacheAge((Attribute)i));
+      }
+      else
+      {
+        chunkPrintf(PSTR("\"value\":%d,\"age_ms\":%u}"), value, cacheAge((Attribute)i));
+      }
+    }
+    chunkPrintf(PSTR("}\n"));
+    chunkEnd();
+  }
+}
+
+// Serial capture as transcript (format see _docs/Documentation/projectorsim.py)
+void handleCapture()
+{
+  showWEBAction(HTTPRoute::CAPTURE);
+  if (!server.authenticate(cfg.admin_username, cfg.admin_password))
+  {
+    return server.requestAuthentication();
+  }
+  else
+  {
+    size_t count = captureCount();
+    chunkBegin("text/plain");
+    chunkPrintf(PSTR("# BeamerControl serial transcript\n# model %s\n"), cfg.beamermodel);
+    chunkPrintf(PSTR("# captured on %s, firmware %s, %u bytes, %u overwritten, %s\n"), hostname, FIRMWARE_VERSION,
+                (unsigned int)count, (unsigned int)captureOverwritten(), captureActive() ? "running" : "stopped");
+    chunkPrintf(PSTR("# resolution: sent bytes one byte time (10 bits at the baud rate of the line) apart from the write time, received bytes when drained from the serial buffer (1 ms while a reply is awaited, the next poll otherwise)\n"));
+
+    uint32_t start = count ? captureEntry(0).time : 0;
+    uint32_t last = start;
+    uint8_t lineBytes = 0;
+    bool lineSent = false;
+    uint32_t lineBaud = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      captureEntry_t entry = captureEntry(i);
+      if (lineBytes == 0 || entry.sent != lineSent || entry.baud != lineBaud || entry.time - last > CAPTURE_LINE_GAP || lineBytes >= CAPTURE_LINE_BYTES)
+      {
+        uint32_t offset = entry.time - start;
+        chunkPrintf(PSTR("%s%lu.%03lu %c %lu"), i ? "\n" : "", (unsigned long)(offset / 1000), (unsigned long)(offset % 1000),
+                    entry.sent ? '>' : '<', (unsigned long)entry.baud);
+        lineBytes = 0;
+        lineSent = entry.sent;
+        lineBaud = entry.baud;
+      }
+      chunkPrintf(PSTR(" %02x"), entry.data);
+      lineBytes++;
+      last = entry.time;
+    }
+    if (count)
+    {
+      chunkPrintf(PSTR("\n"));
+    }
+    chunkEnd();
+  }
+}
+
+void handleSettings()
+{
+  showWEBAction(HTTPRoute::SETTINGS);
+  // HTTP Auth
+  if (!server.authenticate(cfg.admin_username, cfg.admin_password))
+  {
+    return server.requestAuthentication();
+  }
+  else
+  {
+    boolean saveandreboot = false;
+    if (server.method() == HTTP_POST)
+    { // Save Settings
+
+      for (uint8_t i = 0; i < server.args(); i++)
+      {
+        // References to the parsed arguments, copies would allocate a String each
+        const String &name = server.argName(i);
+        const String &value = server.arg(i);
+        if (!configApply(cfg, name.c_str(), value.c_str()))
         {
-          value.toCharArray(cfg.api_password, sizeof(cfg.api_password) / sizeof(*cfg.api_password));
+          LOG_WARN("Setting %s ignored", name.c_str());
         }
-
         saveandreboot = true;
       }
     }
@@ -1180,7 +1757,7 @@ void handleSettings()
       html += "<tr>\n";
       html += "<td>Hostname:</td>\n";
       html += "<td><input name='hostname' type='text' maxlength='30' autocapitalize='none' placeholder='";
-      html += WiFi.hostname().c_str();
+      html += hostname;
       html += "' value='";
       html += cfg.hostname;
       html += "'></td></tr>\n";
@@ -1274,6 +1851,9 @@ void handleSettings()
 
       html += "<tr>\n<td>Beamer baud rate:</td>\n";
       html += "<td><select name='beamerbaudrate'>";
+      html += "<option value='0'";
+      html += (cfg.beamerbaudrate == 0 ? " selected" : "");
+      html += ">auto</option>";
       html += "<option value='9600'";
       html += (cfg.beamerbaudrate == 9600 ? " selected" : "");
       html += ">9600</option>";
@@ -1322,6 +1902,16 @@ void handleSettings()
       html += cfg.mqtt_periodic_update_interval;
       html += "'> (in sec. 0 to disable)</td>\n</tr>\n";
 
+      html += "<tr>\n<td>\nSyslog server:</td>\n";
+      html += "<td><input name='syslog_server' type='text' maxlength='29' autocapitalize='none' value='";
+      html += cfg.syslog_server;
+      html += "'> (empty to disable)</td>\n</tr>\n";
+
+      html += "<tr>\n<td>\nSyslog port:</td>\n";
+      html += "<td><input name='syslog_port' type='text' maxlength='5' autocapitalize='none' value='";
+      html += cfg.syslog_port;
+      html += "'> (Default 514)</td>\n</tr>\n";
+
       html += "</table>\n";
 
       html += "<br />\n";
@@ -1334,74 +1924,65 @@ void handleSettings()
     if (saveandreboot)
     {
       saveConfig();
-      ESP.reset();
+      watchdogReset();
     }
   }
 }
 
-void MQTTprocessCommand(JsonObject &json)
+// Carries out a command parsed by statusParseCommand(): serial capture,
+// blank and mute, power and status requests
+void MQTTprocessCommand(const mqttCommand_t &cmd)
 {
-  Serial.println(F("Processing incomming MQTT command"));
+  LOG_INFO("Processing incomming MQTT command");
 
-  // Power on/off
-  if (json.containsKey("poweron"))
+  if (cmd.captureStart)
   {
-    if (json["poweron"].as<boolean>())
-    {
-      setState(State::ON);
-    }
-    else if (!json["poweron"].as<boolean>())
+    LOG_INFO("Serial capture started");
+    captureStart();
+  }
+  else if (cmd.captureStop)
+  {
+    LOG_INFO("Serial capture stopped (%u bytes)", (unsigned int)captureCount());
+    captureStop();
+  }
+
+  for (uint8_t c = 0; c < (uint8_t)AVControl::COUNT; c++)
+  {
+    if (cmd.av[c] >= 0)
     {
-      setState(State::OFF);
+      queueAVCommand((AVControl)c, cmd.av[c]);
     }
   }
-  else if (json.containsKey("pwrstate"))
+
+  if (cmd.power != State::UNKNOWN)
   {
-    if (strcmp_P(json["pwrstate"], PSTR("on")) == 0)
+    // Publishes the status
+    setState(cmd.power, StatusTrigger::CMD);
+  }
+  else if (cmd.status)
+  {
+    // Older values are polled first, the poll task publishes then
+    if (cacheRefresh(cmd.maxAge))
     {
-      setState(State::ON);
+      MQTTpublishStatus(StatusTrigger::CMD);
     }
-    else if (strcmp_P(json["pwrstate"], PSTR("off")) == 0)
+    else
     {
-      setState(State::OFF);
+      statusRequested = true;
     }
   }
-
-  // Trigger status update
-  if (json.containsKey("status"))
-  {
-    MQTTpublishStatus(StatusTrigger::CMD);
-  }
 }
 
 void MQTTcallback(char *topic, byte *payload, unsigned int length)
 {
   showMQTTAction();
-  Serial.println(F("Neq MQTT message (MQTTcallback)"));
-  Serial.print(F("> Lenght: "));
-  Serial.println(length);
-  Serial.print(F("> Topic: "));
-  Serial.println(topic);
+  LOG_INFO("New MQTT message on %s (%u bytes)", topic, length);
 
-  if (length)
+  mqttCommand_t cmd;
+  if (length && statusParseCommand(payload, length, cmd))
   {
-    StaticJsonDocument<256> jsondoc;
-    DeserializationError err = deserializeJson(jsondoc, payload);
-    if (err)
-    {
-      Serial.print(F("deserializeJson() failed: "));
-      Serial.println(err.c_str());
-    }
-    else
-    {
-
-      Serial.print(F("> JSON: "));
-      serializeJsonPretty(jsondoc, Serial);
-      Serial.println();
-
-      JsonObject object = jsondoc.as<JsonObject>();
-      MQTTprocessCommand(object);
-    }
+    LOG_DEBUG("> JSON: %.*s", (int)length, (const char *)payload);
+    MQTTprocessCommand(cmd);
   }
 
   /*
@@ -1430,10 +2011,9 @@ void MQTTcallback(char *topic, byte *payload, unsigned int length)
 boolean MQTTreconnect()
 {
 
-  Serial.printf_P(PSTR("Connecting to MQTT Broker \"%s:%i\"..."), cfg.mqtt_server, cfg.mqtt_port);
   if (strcmp(cfg.mqtt_server, "") == 0)
   {
-    Serial.println(F("failed. No server configured."));
+    LOG_DEBUG("Connecting to MQTT Broker failed. No server configured.");
     return false;
   }
   else
@@ -1442,26 +2022,29 @@ boolean MQTTreconnect()
     client.setServer(cfg.mqtt_server, cfg.mqtt_port);
     client.setCallback(MQTTcallback);
 
-    // last will and testament topic
-    snprintf(buff, sizeof(buff), MQTT_PUBLISH_STATUS_TOPIC, mqtt_prefix, WiFi.hostname().c_str());
+    // last will and testament topic is the status topic
+    watchdogEnter((uint8_t)TracePhase::MQTT_CONNECT);
+    bool connected = client.connect(hostname, cfg.mqtt_user, cfg.mqtt_password, mqttStatusTopic, 0, 1, MQTT_LWT_MESSAGE);
+    watchdogExit((uint8_t)TracePhase::MQTT_CONNECT);
 
-    if (client.connect(WiFi.hostname().c_str(), cfg.mqtt_user, cfg.mqtt_password, buff, 0, 1, MQTT_LWT_MESSAGE))
+    if (connected)
     {
-      Serial.println(F("connected!"));
+      LOG_INFO("Connected to MQTT Broker \"%s:%i\"", cfg.mqtt_server, cfg.mqtt_port);
+      metrics.mqttReconnects++;
 
       snprintf(buff, sizeof(buff), MQTT_SUBSCRIBE_CMD_TOPIC1, mqtt_prefix);
       client.subscribe(buff);
-      Serial.printf_P(PSTR("Subscribed to topic %s\n"), buff);
+      LOG_INFO("Subscribed to topic %s", buff);
 
-      snprintf(buff, sizeof(buff), MQTT_SUBSCRIBE_CMD_TOPIC2, mqtt_prefix, WiFi.hostname().c_str());
+      snprintf(buff, sizeof(buff), MQTT_SUBSCRIBE_CMD_TOPIC2, mqtt_prefix, hostname);
       client.subscribe(buff);
-      Serial.printf_P(PSTR("Subscribed to topic %s\n"), buff);
+      LOG_INFO("Subscribed to topic %s", buff);
       return true;
     }
     else
     {
-      Serial.print(F("failed with state "));
-      Serial.println(client.state());
+      LOG_WARN("Connecting to MQTT Broker \"%s:%i\" failed with state %i", cfg.mqtt_server, cfg.mqtt_port, client.state());
+      metrics.mqttReconnectFailures++;
       return false;
     }
   }
@@ -1469,46 +2052,18 @@ boolean MQTTreconnect()
 
 void loadDefaults()
 {
-
   // Config NOT from EEPROM
   configIsDefault = true;
-
-  // Valid-Falg to verify config
-  cfg.configversion = CURRENT_CONFIG_VERSION;
-
-  // Note
-  memcpy(cfg.note, "", sizeof(cfg.note) / sizeof(*cfg.note));
-
-  memcpy(cfg.wifi_ssid, "", sizeof(cfg.wifi_ssid) / sizeof(*cfg.wifi_ssid));
-  memcpy(cfg.wifi_psk, "", sizeof(cfg.wifi_psk) / sizeof(*cfg.wifi_psk));
-
-  memcpy(cfg.hostname, "", sizeof(cfg.hostname) / sizeof(*cfg.hostname));
-  memcpy(cfg.note, "", sizeof(cfg.note) / sizeof(*cfg.note));
-
-  memcpy(cfg.beamermodel, "", sizeof(cfg.beamermodel) / sizeof(*cfg.beamermodel));
-
-  memcpy(cfg.admin_username, "admin", sizeof(cfg.admin_username) / sizeof(*cfg.admin_username));
-  memcpy(cfg.admin_password, "admin", sizeof(cfg.admin_password) / sizeof(*cfg.admin_password));
-
-  memcpy(cfg.api_username, "api", sizeof(cfg.api_username) / sizeof(*cfg.api_username));
-  memcpy(cfg.api_password, "api", sizeof(cfg.api_password) / sizeof(*cfg.api_password));
-
-  memcpy(cfg.mqtt_server, "", sizeof(cfg.mqtt_server) / sizeof(*cfg.mqtt_server));
-  memcpy(cfg.mqtt_user, "", sizeof(cfg.mqtt_user) / sizeof(*cfg.mqtt_user));
-  cfg.mqtt_port = 1883;
-  memcpy(cfg.mqtt_password, "", sizeof(cfg.mqtt_password) / sizeof(*cfg.mqtt_password));
-  memcpy(cfg.mqtt_prefix, "beamercontrol", sizeof(cfg.mqtt_prefix) / sizeof(*cfg.mqtt_prefix));
-  cfg.mqtt_periodic_update_interval = 10;
-  cfg.led_brightness = 100;
+  configDefaults(cfg);
 }
 
 void loadConfig()
 {
-  EEPROM.begin(512);
+  EEPROM.begin(EEPROM_SIZE);
   EEPROM.get(cfgStart, cfg);
   EEPROM.end();
 
-  if (cfg.configversion != CURRENT_CONFIG_VERSION)
+  if (!configMigrate(cfg))
   {
     loadDefaults();
   }
@@ -1520,42 +2075,79 @@ void loadConfig()
 
 void handleButton()
 {
-  bool inp = digitalRead(HWPIN_PUSHBUTTON);
-  // Serial.printf_P(PSTR("Button state: %d\n"), inp);
-  if (inp == 0) // Button pressed
+  uint8_t count;
+  ButtonEvent event;
+  while ((event = buttonPoll(count)) != ButtonEvent::NONE)
   {
-    if (inp != previousButtonState)
+    switch (event)
     {
-      Serial.printf_P(PSTR("Button short press @ %lu\n"), millis());
-      toggleState();
+    case ButtonEvent::SHORT:
+      LOG_INFO("Button short press");
+      toggleState(StatusTrigger::BUTTON);
+      break;
+    case ButtonEvent::MULTI:
+      LOG_INFO("Button %ux press", count);
       MQTTpublishStatus(StatusTrigger::BUTTON);
-      buttonTimer = millis();
-    }
-    if ((millis() - buttonTimer >= TIME_BUTTON_LONGPRESS))
-    {
-      Serial.printf_P(PSTR("Button long press @ %lu\n"), millis());
+      break;
+    case ButtonEvent::LONG:
+      LOG_WARN("Button long press");
       eraseConfig();
-      ESP.reset();
+      watchdogReset();
+      break;
+    default:
+      break;
     }
+  }
 
-    // Delay a little bit to avoid bouncing
-    delay(50);
+  // Config reset countdown, network services keep running meanwhile
+  uint32_t held = buttonHeldTime();
+  if (held >= TIME_BUTTON_COUNTDOWN && held < TIME_BUTTON_LONGPRESS)
+  {
+    uint32_t remaining = (TIME_BUTTON_LONGPRESS - held + 999) / 1000;
+    if (remaining != buttonCountdown)
+    {
+      LOG_WARN("Config reset in %u s, release button to abort", remaining);
+      buttonCountdown = remaining;
+    }
   }
-  previousButtonState = inp;
+  else
+  {
+    buttonCountdown = 0;
+  }
+}
+
+// NTPClient timing runs on the firmware clock, so it follows a virtual one
+static unsigned long ntpMillis()
+{
+  return clockMillis();
+}
+
+static void ntpDelay(unsigned long ms)
+{
+  clockDelay(ms);
+}
+
+// Blocks for the DNS round trip, NTPClient caches the address
+static bool ntpResolve(const char *host, IPAddress &ip)
+{
+  return WiFi.hostByName(host, ip) == 1;
 }
 
 void setup(void)
 {
+  // Loop watchdog
+  watchdogBegin();
+
   // LED Basic Setup
-  pinMode(HWPIN_LED_BOARD, OUTPUT);
-  pinMode(HWPIN_LED_WIFI, OUTPUT);
-  pinMode(HWPIN_LED_MQTT, OUTPUT);
-  digitalWrite(HWPIN_LED_BOARD, 1); // OFF
-  digitalWrite(HWPIN_LED_WIFI, 0);  // OFF
-  digitalWrite(HWPIN_LED_MQTT, 0);  // OFF
+  analogWriteRange(PWMRANGE);
+  ledSetPattern(ledWiFi, LEDPattern::BOOT);
+  ledSetPattern(ledMQTT, LEDPattern::BOOT);
+  ledBegin(ledBoard, PWMRANGE);
+  ledBegin(ledWiFi, ledBrightness);
+  ledBegin(ledMQTT, ledBrightness);
 
   // GPIO Basic Setup
-  pinMode(HWPIN_PUSHBUTTON, INPUT_PULLUP);
+  buttonBegin(HWPIN_PUSHBUTTON, TIME_BUTTON_LONGPRESS);
 
   // Load Config
   loadConfig();
@@ -1570,26 +2162,29 @@ void setup(void)
     strcat(mqtt_prefix, "/");
   }
 
-  Serial.begin(HWSERIAL_BAUD);
-  delay(1000);
-  Serial.printf_P(PSTR("\n+++ Welcome to BeamerControl v%s +++\n"), FIRMWARE_VERSION);
+  LOG_SERIAL.begin(HWSERIAL_BAUD);
+  clockDelay(1000);
+  LOG_INFO("+++ Welcome to BeamerControl v%s +++", FIRMWARE_VERSION);
   WiFi.mode(WIFI_OFF);
 
   // AP or Infrastructire mode
   if (configIsDefault)
   {
     // Start AP
-    Serial.println(F("Default Config loaded."));
-    Serial.println(F("Starting WiFi SoftAP"));
+    LOG_INFO("Default Config loaded.");
+    LOG_INFO("Starting WiFi SoftAP");
     WiFi.softAP("BeamerControl", "");
-    analogWrite(HWPIN_LED_WIFI, ledBrightness);
+    ledSetPattern(ledWiFi, LEDPattern::ON);
+    ledSetPattern(ledMQTT, LEDPattern::OFF);
   }
   else
   {
 
     // LED brightness
     ledBrightness = (PWMRANGE / 100.00) * cfg.led_brightness;
-    Serial.printf("LED brightness: %i/%i (%i%%)\n", ledBrightness, PWMRANGE, cfg.led_brightness);
+    LOG_INFO("LED brightness: %i/%i (%i%%)", ledBrightness, PWMRANGE, cfg.led_brightness);
+    ledSetBrightness(ledWiFi, ledBrightness);
+    ledSetBrightness(ledMQTT, ledBrightness);
 
     WiFi.mode(WIFI_STA);
     if (strcmp(cfg.hostname, "") != 0)
@@ -1602,64 +2197,59 @@ void setup(void)
       WiFi.hostname(cfg.hostname);
     }
 
-    Serial.printf_P(PSTR("Connecing to '%s'. Please wait"), cfg.wifi_ssid);
+    LOG_INFO("Connecting to '%s'. Please wait", cfg.wifi_ssid);
 
     // Wait for connection
     while (WiFi.status() != WL_CONNECTED)
     {
-      delay(250);
-      Serial.print(F("."));
-      if (ledOneToggle)
-      {
-        analogWrite(HWPIN_LED_WIFI, ledBrightness);
-      }
-      else
-      {
-        analogWrite(HWPIN_LED_WIFI, 0);
-      }
-      ledOneToggle = !ledOneToggle;
+      clockDelay(250);
+      logDrain();
+      ledSetPattern(ledWiFi, LEDPattern::BLINK);
+      ledUpdate(ledWiFi);
+      ledUpdate(ledMQTT);
 
       handleButton();
     }
 
-    Serial.printf_P(PSTR("\nConnected to '%s'\n"), cfg.wifi_ssid);
-    WiFi.printDiag(Serial);
-    Serial.printf_P(PSTR("IP address: %s\n"), WiFi.localIP().toString().c_str());
+    LOG_INFO("Connected to '%s'", cfg.wifi_ssid);
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+    WiFi.printDiag(LOG_SERIAL);
+#endif
+    LOG_INFO("IP address: %s", WiFi.localIP().toString().c_str());
 
-    analogWrite(HWPIN_LED_WIFI, ledBrightness);
-
-    // Beamermodel
-    if (strcmp_P(cfg.beamermodel, PSTR("demo")) == 0)
-    {
-      beamerModel = BeamerModel::DEMO;
-    }
-    else if (strcmp_P(cfg.beamermodel, PSTR("benq")) == 0)
-    {
-      beamerModel = BeamerModel::BENQ;
-    }
-    else if (strcmp_P(cfg.beamermodel, PSTR("canon")) == 0)
-    {
-      beamerModel = BeamerModel::CANON;
-    }
+    ledSetPattern(ledWiFi, LEDPattern::ON);
 
-    // Beamer baud rate
-    if (!configIsDefault)
-    {
-      swSer.begin(cfg.beamerbaudrate);
-    }
-    else
-    {
-      swSer.begin(SWSERIAL_DEFAULT_BAUDRATE);
-    }
+    // Beamermodel and baud rate, 0 probes the standard rates
+    deviceBegin(projectorModel(cfg.beamermodel), cfg.beamerbaudrate);
 
     // MDNS responder
     if (MDNS.begin(cfg.hostname))
     {
-      Serial.println(F("MDNS responder started"));
+      LOG_INFO("MDNS responder started");
     }
 
     // NTPClient
+    timeClient.setPoolServerNames(NTP_SERVERS, sizeof(NTP_SERVERS) / sizeof(*NTP_SERVERS));
+    timeClient.setClock(ntpMillis, ntpDelay);
+    timeClient.setResolver(ntpResolve);
     timeClient.begin();
+
+    // WiFi supervisor
+    WiFiSupervisorBegin();
+  }
+
+  // MQTT buffer
+  client.setBufferSize(MQTT_BUFFER_SIZE);
+
+  // Cache identifiers, WiFi.hostname() allocates a String on every call
+  strncpy(hostname, WiFi.hostname().c_str(), sizeof(hostname) - 1);
+  snprintf(mqttStatusTopic, sizeof(mqttStatusTopic), MQTT_PUBLISH_STATUS_TOPIC, mqtt_prefix, hostname);
+  snprintf(mqttMetricsTopic, sizeof(mqttMetricsTopic), MQTT_PUBLISH_METRICS_TOPIC, mqtt_prefix, hostname);
+
+  // Syslog
+  if (!configIsDefault)
+  {
+    logSetSyslog(cfg.syslog_server, cfg.syslog_port, hostname);
   }
 
   // Arduino OTA Update
@@ -1672,84 +2262,191 @@ void setup(void)
   server.on(F("/switch"), handleSwitch);
   server.on(F("/reboot"), handleReboot);
   server.on(F("/wifiscan"), handleWiFiScan);
+  server.on(F("/metrics"), handleMetrics);
+  server.on(F("/trace"), handleTrace);
+  server.on(F("/log"), handleLog);
+  server.on(F("/bench"), handleBench);
+  server.on(F("/capture"), handleCapture);
   server.on(F("/api/on"), []()
             { handleAPI(APICMD::ON); });
   server.on(F("/api/off"), []()
             { handleAPI(APICMD::OFF); });
+  server.on(F("/api/blank/on"), []()
+            { handleAPI(APICMD::BLANK_ON); });
+  server.on(F("/api/blank/off"), []()
+            { handleAPI(APICMD::BLANK_OFF); });
+  server.on(F("/api/mute/on"), []()
+            { handleAPI(APICMD::MUTE_ON); });
+  server.on(F("/api/mute/off"), []()
+            { handleAPI(APICMD::MUTE_OFF); });
+  server.on(F("/api/status"), handleAPIStatus);
   server.onNotFound(handleNotFound);
   server.begin();
 
-  Serial.println(F("HTTP server started"));
+  LOG_INFO("HTTP server started");
+
+  // Stale projector attributes are refreshed by the next poll
+  cacheBegin(requestPoll);
+
+  // Trace all scheduler tasks
+  schedulerSetHooks(watchdogEnter, watchdogExit);
 }
 
-void loop(void)
+// ++++++++++++++++++++++++++++++++++++++++
+//
+// TASKS
+//
+// ++++++++++++++++++++++++++++++++++++++++
+
+void taskLEDs()
 {
+  if (!configIsDefault)
+  {
+    // WiFi LED: on with link, blinking while reconnecting
+    ledSetPattern(ledWiFi, WiFiLinkUp() ? LEDPattern::ON : LEDPattern::BLINK);
 
-  // Switch back on WiFi LED after Webserver access
-  if ((millis() - ledOneTime) > LED_WEB_MIN_TIME)
+    // MQTT LED: projector link errors first, then broker connection
+    const deviceStats_t &deviceStats = deviceGetStats();
+    if (deviceStats.failStreak >= LED_ERROR_STREAK)
+    {
+      ledSetPattern(ledMQTT, LEDPattern::ERROR_CODE, (uint8_t)(deviceStats.lastResult == PollResult::TIMEOUT ? LEDCode::SERIAL_TIMEOUT : LEDCode::SERIAL_ERROR));
+    }
+    else if (client.connected())
+    {
+      ledSetPattern(ledMQTT, LEDPattern::ON);
+    }
+    else if (strcmp(cfg.mqtt_server, "") != 0 && WiFiLinkUp())
+    {
+      ledSetPattern(ledMQTT, LEDPattern::ERROR_CODE, (uint8_t)LEDCode::NO_BROKER);
+    }
+    else
+    {
+      ledSetPattern(ledMQTT, LEDPattern::OFF);
+    }
+  }
+
+  // Only changed levels are written to the pins
+  ledUpdate(ledBoard);
+  ledUpdate(ledWiFi);
+  ledUpdate(ledMQTT);
+}
+
+void taskLog()
+{
+  logDrain();
+}
+
+// Periodic loop tasks must not touch the heap once running, an allocation
+// there fragments the heap over days of uptime. Reports every regression.
+void taskAllocCheck()
+{
+  if (clockMillis() < ALLOC_WARMUP_TIME)
   {
-    analogWrite(HWPIN_LED_WIFI, ledBrightness);
+    return;
   }
 
-  // Handle Button
-  handleButton();
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
+  {
+    for (uint8_t j = 0; j < ALLOC_FREE_TASK_COUNT; j++)
+    {
+      if (strcmp(tasks[i].name, ALLOC_FREE_TASKS[j]) != 0)
+      {
+        continue;
+      }
+      // A baud rate change while probing reallocates the SoftwareSerial buffer
+      bool probed = deviceLink().probes != steadyLinkProbes && tasks[i].callback == pollDeviceState;
+      if (steadyAllocsSet && tasks[i].allocs != steadyAllocs[j] && !probed)
+      {
+        LOG_ERROR("Task %s allocated %u times in steady state (max %u per run)", tasks[i].name, tasks[i].allocs - steadyAllocs[j], tasks[i].maxAllocs);
+      }
+      steadyAllocs[j] = tasks[i].allocs;
+    }
+  }
+  steadyAllocsSet = true;
+  steadyLinkProbes = deviceLink().probes;
+}
 
-  // Handle Webserver
+void taskWebserver()
+{
   server.handleClient();
+}
 
-  // NTPClient Update
-  timeClient.update();
+void taskWiFi()
+{
+  if (!configIsDefault)
+  {
+    WiFiSupervisor();
+  }
+}
 
-  // Update Beamer State
-  if ((millis() - lastDevicePollTime) > DEVICE_POLL_INTERVAL)
+void taskNTP()
+{
+  if (WiFiLinkUp())
   {
-    lastDevicePollTime = millis();
-    pollDeviceState();
+    timeClient.update();
   }
+}
 
+void taskMQTT()
+{
   // Config valid and WiFi connection
-  if (!configIsDefault && WiFi.status() == WL_CONNECTED)
+  if (configIsDefault || !WiFiLinkUp())
   {
+    return;
+  }
 
-    if (!client.connected())
+  if (!client.connected())
+  {
+    // MQTT connect
+    if (mqttLastReconnectAttempt == 0 || (clockMillis() - mqttLastReconnectAttempt) >= MQTT_RECONNECT_INTERVAL)
     {
-      // MQTT connect
-      if (mqttLastReconnectAttempt == 0 || (millis() - mqttLastReconnectAttempt) >= MQTT_RECONNECT_INTERVAL)
-      {
-        mqttLastReconnectAttempt = millis();
-
-        // switch off MQTT LED
-        analogWrite(HWPIN_LED_MQTT, 0);
+      mqttLastReconnectAttempt = clockMillis();
 
-        // try to reconnect
-        if (MQTTreconnect())
-        {
-          // switch on MQTT LED
-          analogWrite(HWPIN_LED_MQTT, ledBrightness);
-
-          mqttLastReconnectAttempt = 0;
-        }
+      // try to reconnect
+      if (MQTTreconnect())
+      {
+        mqttLastReconnectAttempt = 0;
       }
     }
-    else
+  }
+  else
+  {
+    // Handle MQTT msgs
+    client.loop();
+
+    // send periodic update if enabled
+    if (cfg.mqtt_periodic_update_interval > 0)
     {
-      // Switch on MQTT LED after MQTT action if we have server connection
-      if ((millis() - ledTwoTime) > LED_MQTT_MIN_TIME)
+      if (clockMillis() - lastPublishTime >= cfg.mqtt_periodic_update_interval * 1000)
       {
-        analogWrite(HWPIN_LED_MQTT, ledBrightness);
+        MQTTpublishStatus(StatusTrigger::PERIODIC);
       }
+    }
 
-      // Handle MQTT msgs
-      client.loop();
-
-      // send periodic update if enabled
-      if (cfg.mqtt_periodic_update_interval > 0)
-      {
-        if (millis() - lastPublishTime >= cfg.mqtt_periodic_update_interval * 1000)
-        {
-          MQTTpublishStatus(StatusTrigger::PERIODIC);
-        }
-      }
+    // send metrics if enabled
+    if (MQTT_METRICS_INTERVAL > 0 && clockMillis() - metrics.lastMetricsPublishTime >= MQTT_METRICS_INTERVAL * 1000)
+    {
+      MQTTpublishMetrics();
     }
   }
 }
+
+// Periods in ms, budgets in us
+task_t tasks[] = {
+    SCHEDULER_TASK("avcmd", taskAVCommands, SCHEDULER_ON_DEMAND, 150000), // first, ahead of the poll
+    SCHEDULER_TASK("leds", taskLEDs, 50, 200),
+    SCHEDULER_TASK("log", taskLog, 10, 2000),
+    SCHEDULER_TASK("button", handleButton, 10, 1000),
+    SCHEDULER_TASK("http", taskWebserver, 5, 50000),
+    SCHEDULER_TASK("wifi", taskWiFi, 100, 2000),
+    SCHEDULER_TASK("ntp", taskNTP, 10, 2000),
+    SCHEDULER_TASK("poll", pollDeviceState, DEVICE_POLL_INTERVAL, 150000),
+    SCHEDULER_TASK("mqtt", taskMQTT, 10, 50000),
+    SCHEDULER_TASK("alloc", taskAllocCheck, ALLOC_CHECK_INTERVAL, 1000),
+};
+const uint8_t TASK_COUNT = sizeof(tasks) / sizeof(*tasks);
+
+void loop(void)
+{
+  schedulerRun(tasks, TASK_COUNT, SCHEDULER_MAX_IDLE);
+}
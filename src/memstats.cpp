@@ -0,0 +1,51 @@
+#include "memstats.h"
+#include "alloccount.h"
+#include <cont.h>
+
+static memoryStats_t stats = {CONT_STACKSIZE, UINT32_MAX, UINT32_MAX, UINT32_MAX};
+
+static uint32_t sampleStack()
+{
+  uint32_t free = ESP.getFreeContStack();
+  if (free < stats.minFreeStack)
+  {
+    stats.minFreeStack = free;
+  }
+  return free;
+}
+
+void memorySample()
+{
+  uint32_t heap = ESP.getFreeHeap();
+  if (heap < stats.minFreeHeap)
+  {
+    stats.minFreeHeap = heap;
+  }
+  uint32_t block = ESP.getMaxFreeBlockSize();
+  if (block < stats.minMaxBlock)
+  {
+    stats.minMaxBlock = block;
+  }
+}
+
+void memoryStackReset()
+{
+  // Keep the peak before the paint is restored
+  sampleStack();
+  ESP.resetFreeContStack();
+}
+
+uint32_t memoryStackUsed()
+{
+  return stats.stackSize - sampleStack();
+}
+
+const memoryStats_t &memoryGetStats()
+{
+  if (allocMinFreeHeap() < stats.minFreeHeap)
+  {
+    stats.minFreeHeap = allocMinFreeHeap();
+  }
+  sampleStack();
+  return stats;
+}
@@ -0,0 +1,28 @@
+#ifndef memstats_h
+#define memstats_h
+
+#include <Arduino.h>
+
+// Memory high-water marks since boot. The core paints the loop stack with a
+// guard pattern, the untouched part is found by scanning for it. The free
+// heap minimum comes from the allocation hook (alloccount.h), the largest
+// free block is sampled once per scheduler pass.
+
+typedef struct
+{
+    uint32_t stackSize;    // loop stack size in bytes
+    uint32_t minFreeStack; // lowest free loop stack in bytes
+    uint32_t minFreeHeap;  // lowest free heap in bytes
+    uint32_t minMaxBlock;  // lowest largest free heap block in bytes
+} memoryStats_t;
+
+// Samples heap and largest block, called once per scheduler pass
+void memorySample();
+
+// Repaints the unused stack, memoryStackUsed() returns the peak since then
+void memoryStackReset();
+uint32_t memoryStackUsed();
+
+const memoryStats_t &memoryGetStats();
+
+#endif
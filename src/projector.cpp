@@ -0,0 +1,561 @@
+#include "projector.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// BenQ: ASCII commands, the response line is echoed and terminated by '#'
+static const char BENQ_POLL[] = "\r*pow=?#\r";
+static const char BENQ_POWER_ON[] = "\r*pow=on#\r";
+static const char BENQ_POWER_OFF[] = "\r*pow=off#\r";
+static const char BENQ_BLANK_ON[] = "\r*blank=on#\r";
+static const char BENQ_BLANK_OFF[] = "\r*blank=off#\r";
+static const char BENQ_MUTE_ON[] = "\r*mute=on#\r";
+static const char BENQ_MUTE_OFF[] = "\r*mute=off#\r";
+
+typedef struct
+{
+  const char *key;
+  const char *request;
+} benqQueryInfo_t;
+
+// In the order of BenqQuery
+static const benqQueryInfo_t BENQ_QUERIES[] = {
+    {"pow", BENQ_POLL},
+    {"sour", "\r*sour=?#\r"},
+    {"ltim", "\r*ltim=?#\r"},
+    {"lampm", "\r*lampm=?#\r"},
+    {"blank", "\r*blank=?#\r"},
+    {"mute", "\r*mute=?#\r"},
+    {"freeze", "\r*freeze=?#\r"},
+};
+static_assert(sizeof(BENQ_QUERIES) / sizeof(*BENQ_QUERIES) == (size_t)BenqQuery::COUNT, "one BenQ query per attribute");
+
+static const char *const BENQ_SOURCES[] = {
+    "rgb", "rgb2", "rgb3", "ypbr", "ypbr2", "dvia", "dvid", "dp", "hdmi", "hdmi2",
+    "vid", "svid", "network", "usbdisplay", "usbreader", "hdbaset", "sdi"};
+static const char *const BENQ_LAMP_MODES[] = {"lnor", "eco", "seco", "seco2", "seco3", "dimming", "custom"};
+
+// Canon: binary frames
+// Request    00H BFH 00H 00H 01H 02H C2H = 7
+// Response   20H BFH 01H xxH 10H DATA01 to DATA16 CKS = 22
+static const uint8_t CANON_POLL[] = {0x00, 0xbf, 0x00, 0x00, 0x01, 0x02, 0xc2};
+static const uint8_t CANON_POWER_ON[] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+static const uint8_t CANON_POWER_OFF[] = {0x02, 0x01, 0x00, 0x00, 0x00, 0x03};
+static const uint8_t CANON_BLANK_ON[] = {0x02, 0x10, 0x00, 0x00, 0x00, 0x12};
+static const uint8_t CANON_BLANK_OFF[] = {0x02, 0x11, 0x00, 0x00, 0x00, 0x13};
+static const uint8_t CANON_MUTE_ON[] = {0x02, 0x12, 0x00, 0x00, 0x00, 0x14};
+static const uint8_t CANON_MUTE_OFF[] = {0x02, 0x13, 0x00, 0x00, 0x00, 0x15};
+static const size_t CANON_RESPONSE_LENGTH = 22;
+static const size_t CANON_ACK_LENGTH = 6; // 22H xxH 01H xxH 00H CKS, NAK A2H ... with 2 data bytes
+
+static frame_t frame(const uint8_t *data, size_t length)
+{
+  frame_t f = {data, length};
+  return f;
+}
+
+static frame_t frame(const char *text)
+{
+  return frame((const uint8_t *)text, strlen(text));
+}
+
+// Case insensitive compare of a name with 'length' characters of text
+static bool nameEquals(const char *name, const char *text, size_t length)
+{
+  size_t n = 0;
+  for (; n < length && name[n]; n++)
+  {
+    if (tolower((unsigned char)text[n]) != name[n])
+    {
+      return false;
+    }
+  }
+  return n == length && name[n] == 0;
+}
+
+static int32_t nameIndex(const char *const *names, size_t count, const char *text)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    if (nameEquals(names[i], text, strlen(text)))
+    {
+      return (int32_t)i;
+    }
+  }
+  return -1;
+}
+
+BeamerModel projectorModel(const char *name)
+{
+  if (strcmp(name, "demo") == 0)
+  {
+    return BeamerModel::DEMO;
+  }
+  else if (strcmp(name, "benq") == 0)
+  {
+    return BeamerModel::BENQ;
+  }
+  else if (strcmp(name, "canon") == 0)
+  {
+    return BeamerModel::CANON;
+  }
+  return BeamerModel::UNKNOWN;
+}
+
+const char *projectorModelName(BeamerModel model)
+{
+  switch (model)
+  {
+  case BeamerModel::CANON:
+    return "Canon";
+  case BeamerModel::BENQ:
+    return "Benq";
+  case BeamerModel::DEMO:
+    return "Demo";
+  default:
+    return "Unkown";
+  }
+}
+
+const char *projectorStateName(State state)
+{
+  switch (state)
+  {
+  case State::ON:
+    return "On";
+  case State::OFF:
+    return "Off";
+  default:
+    return "Unkown";
+  }
+}
+
+const char *projectorPollResultName(PollResult result)
+{
+  switch (result)
+  {
+  case PollResult::OK:
+    return "ok";
+  case PollResult::TIMEOUT:
+    return "timeout";
+  case PollResult::CHECKSUM:
+    return "checksum wrong";
+  default:
+    return "parse error";
+  }
+}
+
+frame_t projectorPollRequest(BeamerModel model)
+{
+  switch (model)
+  {
+  case BeamerModel::BENQ:
+    return frame(BENQ_POLL);
+  case BeamerModel::CANON:
+    return frame(CANON_POLL, sizeof(CANON_POLL));
+  default:
+    return frame(nullptr, 0);
+  }
+}
+
+frame_t projectorPowerCommand(BeamerModel model, State state)
+{
+  switch (model)
+  {
+  case BeamerModel::BENQ:
+    return frame(state == State::ON ? BENQ_POWER_ON : BENQ_POWER_OFF);
+  case BeamerModel::CANON:
+    return state == State::ON ? frame(CANON_POWER_ON, sizeof(CANON_POWER_ON)) : frame(CANON_POWER_OFF, sizeof(CANON_POWER_OFF));
+  default:
+    return frame(nullptr, 0);
+  }
+}
+
+frame_t projectorAVCommand(BeamerModel model, AVControl control, bool on)
+{
+  switch (model)
+  {
+  case BeamerModel::BENQ:
+    if (control == AVControl::BLANK)
+    {
+      return frame(on ? BENQ_BLANK_ON : BENQ_BLANK_OFF);
+    }
+    return frame(on ? BENQ_MUTE_ON : BENQ_MUTE_OFF);
+  case BeamerModel::CANON:
+    if (control == AVControl::BLANK)
+    {
+      return on ? frame(CANON_BLANK_ON, sizeof(CANON_BLANK_ON)) : frame(CANON_BLANK_OFF, sizeof(CANON_BLANK_OFF));
+    }
+    return on ? frame(CANON_MUTE_ON, sizeof(CANON_MUTE_ON)) : frame(CANON_MUTE_OFF, sizeof(CANON_MUTE_OFF));
+  default:
+    return frame(nullptr, 0);
+  }
+}
+
+void projectorParserBegin(responseParser_t &parser, BeamerModel model)
+{
+  parser.model = model;
+  parser.buffer[0] = 0;
+  parser.length = 0;
+  parser.checksum = 0;
+  parser.started = false;
+  parser.complete = false;
+}
+
+bool projectorParserFeed(responseParser_t &parser, uint8_t b)
+{
+  if (parser.complete)
+  {
+    return true;
+  }
+
+  if (parser.model == BeamerModel::BENQ)
+  {
+    if (b == '\n')
+    { // From, but without NL
+      parser.started = true;
+    }
+    else if (b != '\r' && parser.started && parser.length < PROJECTOR_RESPONSE_MAX)
+    { // Than all, but without CR
+      parser.buffer[parser.length++] = b;
+      parser.buffer[parser.length] = 0;
+      parser.complete = (b == '#');
+    }
+  }
+  else if (parser.model == BeamerModel::CANON)
+  {
+    if (parser.length < CANON_RESPONSE_LENGTH - 1)
+    {
+      parser.checksum += b;
+    }
+    parser.buffer[parser.length++] = b;
+    parser.complete = (parser.length == CANON_RESPONSE_LENGTH);
+  }
+
+  return parser.complete;
+}
+
+PollResult projectorParserResult(const responseParser_t &parser, State &state)
+{
+  state = State::UNKNOWN;
+
+  if (parser.length == 0)
+  {
+    return PollResult::TIMEOUT;
+  }
+
+  if (parser.model == BeamerModel::BENQ)
+  {
+    if (strcmp((const char *)parser.buffer, "*POW=OFF#") == 0)
+    {
+      state = State::OFF;
+    }
+    else if (strcmp((const char *)parser.buffer, "*POW=ON#") == 0)
+    {
+      state = State::ON;
+    }
+    else
+    {
+      return PollResult::PARSE;
+    }
+    return PollResult::OK;
+  }
+
+  if (parser.model != BeamerModel::CANON || !parser.complete || parser.buffer[0] != 0x20)
+  {
+    // Incomplete or not a success response
+    return PollResult::PARSE;
+  }
+  if (parser.buffer[CANON_RESPONSE_LENGTH - 1] != parser.checksum)
+  {
+    return PollResult::CHECKSUM;
+  }
+
+  switch (parser.buffer[6])
+  {
+  case 0x00: // Idle
+    state = State::OFF;
+    break;
+  case 0x03: // Undocumented: Starting?
+    state = State::ON;
+    break;
+  case 0x04: // Power On
+    state = State::ON;
+    break;
+  case 0x05: // Cooling
+    state = State::ON;
+    break;
+  case 0x06: // Idle (Error Standby)
+    state = State::OFF;
+    break;
+  default:
+    return PollResult::PARSE;
+  }
+  return PollResult::OK;
+}
+
+bool projectorResponseValid(const responseParser_t &parser)
+{
+  if (!parser.complete)
+  {
+    return false;
+  }
+  if (parser.model == BeamerModel::BENQ)
+  {
+    return strncmp((const char *)parser.buffer, "*POW=", 5) == 0;
+  }
+  return parser.model == BeamerModel::CANON && parser.buffer[0] == 0x20 && parser.buffer[CANON_RESPONSE_LENGTH - 1] == parser.checksum;
+}
+
+bool projectorCanonStatus(const responseParser_t &parser, canonStatus_t &status)
+{
+  if (parser.model != BeamerModel::CANON || !projectorResponseValid(parser))
+  {
+    return false;
+  }
+
+  // DATA01 at buffer[5], DATA11 to DATA16 are reserved
+  const uint8_t *data = parser.buffer + 5;
+  status.processing = data[1];
+  status.display = data[2];
+  status.terminal = data[3];
+  status.input = data[4];
+  status.video = data[5];
+  status.blank = data[6] == 0x01;
+  status.soundMute = data[7] == 0x01;
+  status.onscreenMute = data[8] == 0x01;
+  status.freeze = data[9] == 0x01;
+  return true;
+}
+
+const char *projectorCanonLampName(uint8_t processing)
+{
+  switch (processing)
+  {
+  case 0x00: // Idle
+    return "off";
+  case 0x03: // Undocumented: Starting?
+  case 0x04: // Power On
+    return "on";
+  case 0x05: // Cooling
+    return "cooling";
+  case 0x06: // Idle (Error Standby)
+    return "error";
+  default:
+    return "unknown";
+  }
+}
+
+const char *projectorCanonDisplayName(uint8_t display)
+{
+  switch (display)
+  {
+  case 0x00:
+    return "picture";
+  case 0x01:
+    return "no signal";
+  case 0x02:
+    return "viewer";
+  case 0x03:
+    return "test pattern";
+  case 0x04:
+    return "lan";
+  case 0x05:
+    return "user test pattern";
+  case 0x10:
+    return "selecting signal";
+  default:
+    return "unknown";
+  }
+}
+
+const char *projectorCanonInputName(uint8_t input)
+{
+  switch (input)
+  {
+  case 0x01:
+    return "computer";
+  case 0x02:
+    return "video";
+  case 0x03:
+    return "s-video";
+  case 0x04:
+    return "component";
+  case 0x06:
+    return "digital";
+  case 0x07:
+    return "viewer";
+  case 0x08:
+    return "slot1";
+  case 0x09:
+    return "slot2";
+  case 0x0a:
+    return "slot3";
+  case 0x0b:
+    return "slot4";
+  case 0x0c:
+    return "digital2";
+  case 0x0d:
+    return "scart";
+  case 0x10:
+    return "auto";
+  case 0xff:
+    return "none";
+  default:
+    return "unknown";
+  }
+}
+
+const char *projectorCanonVideoName(uint8_t video)
+{
+  static const char *const NAMES[] = {
+      "ntsc3.58", "ntsc4.43", "pal", "pal60", "secam", "b/w60", "b/w50", "pal-nm",
+      "ntsc3.58 lbx", "ntsc3.58 sqz", "component 60hz", "component 50hz", "unknown", "ntsc", "pal-m", "pal-n"};
+
+  if (video == 0xff)
+  {
+    return "none";
+  }
+  // The high nibble is indefinite
+  return NAMES[video & 0x0f];
+}
+
+frame_t projectorBenqQuery(BenqQuery query)
+{
+  return frame(BENQ_QUERIES[(size_t)query].request);
+}
+
+const char *projectorBenqKey(BenqQuery query)
+{
+  return BENQ_QUERIES[(size_t)query].key;
+}
+
+void projectorBenqBatchBegin(benqBatch_t &batch)
+{
+  projectorParserBegin(batch.line, BeamerModel::BENQ);
+  batch.pendingCount = 0;
+  batch.value[0] = 0;
+}
+
+bool projectorBenqBatchAdd(benqBatch_t &batch, BenqQuery query)
+{
+  if (batch.pendingCount >= PROJECTOR_BENQ_BATCH_MAX)
+  {
+    return false;
+  }
+  batch.pending[batch.pendingCount++] = query;
+  return true;
+}
+
+bool projectorBenqBatchFeed(benqBatch_t &batch, uint8_t b, BenqQuery &query, const char *&value)
+{
+  if (batch.line.complete || batch.line.length == PROJECTOR_RESPONSE_MAX || (b == '\n' && batch.line.length > 0))
+  {
+    // Next line, an overlong one or one without '#' is dropped, so it does
+    // not run into the next reply
+    projectorParserBegin(batch.line, BeamerModel::BENQ);
+  }
+  if (!projectorParserFeed(batch.line, b) || batch.pendingCount == 0)
+  {
+    return false;
+  }
+
+  // "*KEY=VALUE#", the echo of a command starts with '>'
+  const char *text = (const char *)batch.line.buffer;
+  if (text[0] == '>')
+  {
+    return false;
+  }
+  const char *equals = text[0] == '*' ? strchr(text, '=') : nullptr;
+  uint8_t index = 0;
+  if (equals)
+  {
+    while (index < batch.pendingCount && !nameEquals(projectorBenqKey(batch.pending[index]), text + 1, equals - text - 1))
+    {
+      index++;
+    }
+    if (index == batch.pendingCount)
+    {
+      return false;
+    }
+    size_t length = batch.line.length - (equals + 1 - text) - 1;
+    memcpy(batch.value, equals + 1, length);
+    batch.value[length] = 0;
+    value = batch.value;
+  }
+  else
+  {
+    value = nullptr;
+  }
+
+  query = batch.pending[index];
+  batch.pendingCount--;
+  memmove(batch.pending + index, batch.pending + index + 1, (batch.pendingCount - index) * sizeof(*batch.pending));
+  return true;
+}
+
+int32_t projectorBenqValue(BenqQuery query, const char *value)
+{
+  switch (query)
+  {
+  case BenqQuery::SOURCE:
+  {
+    int32_t index = nameIndex(BENQ_SOURCES, sizeof(BENQ_SOURCES) / sizeof(*BENQ_SOURCES), value);
+    return index < 0 ? -1 : PROJECTOR_BENQ_SOURCE + index;
+  }
+  case BenqQuery::LAMP_HOURS:
+  {
+    char *end;
+    long hours = strtol(value, &end, 10);
+    return (end == value || *end || hours < 0) ? -1 : (int32_t)hours;
+  }
+  case BenqQuery::LAMP_MODE:
+    return nameIndex(BENQ_LAMP_MODES, sizeof(BENQ_LAMP_MODES) / sizeof(*BENQ_LAMP_MODES), value);
+  default:
+    if (nameEquals("on", value, strlen(value)))
+    {
+      return 1;
+    }
+    if (nameEquals("off", value, strlen(value)))
+    {
+      return 0;
+    }
+    return -1;
+  }
+}
+
+const char *projectorBenqSourceName(int32_t source)
+{
+  size_t index = (size_t)(source - PROJECTOR_BENQ_SOURCE);
+  return index < sizeof(BENQ_SOURCES) / sizeof(*BENQ_SOURCES) ? BENQ_SOURCES[index] : "unknown";
+}
+
+const char *projectorBenqLampModeName(int32_t mode)
+{
+  return (size_t)mode < sizeof(BENQ_LAMP_MODES) / sizeof(*BENQ_LAMP_MODES) ? BENQ_LAMP_MODES[mode] : "unknown";
+}
+
+bool projectorCommandReplied(const responseParser_t &parser)
+{
+  if (parser.model == BeamerModel::CANON)
+  {
+    return parser.length >= CANON_ACK_LENGTH;
+  }
+  return parser.complete;
+}
+
+bool projectorCommandAccepted(const responseParser_t &parser)
+{
+  if (parser.model == BeamerModel::CANON)
+  {
+    // The checksum of an ACK is the last byte, the parser sums up to 21 bytes
+    uint8_t checksum = 0;
+    for (size_t n = 0; n < CANON_ACK_LENGTH - 1 && n < parser.length; n++)
+    {
+      checksum += parser.buffer[n];
+    }
+    return parser.length >= CANON_ACK_LENGTH && parser.buffer[0] == 0x22 && parser.buffer[CANON_ACK_LENGTH - 1] == checksum;
+  }
+  const char *text = (const char *)parser.buffer;
+  return parser.complete && text[0] == '*' && strchr(text, '=') != nullptr;
+}
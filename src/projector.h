@@ -0,0 +1,154 @@
+#ifndef projector_h
+#define projector_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Projector protocols: request frames and response parsing. Kept free of
+// Arduino dependencies so the logic also builds on the host; sending and
+// receiving the bytes is up to the caller.
+
+#define PROJECTOR_RESPONSE_MAX 50 // longest response stored in bytes
+#define PROJECTOR_BENQ_BATCH_MAX 4 // BenQ queries sent back-to-back in one poll
+#define PROJECTOR_BENQ_SOURCE 0x100 // BenQ sources as input value, above the Canon input types
+
+enum class State
+{
+    // STARTING,
+    ON,
+    // SHUTDOWN,
+    OFF,
+    UNKNOWN
+};
+enum class BeamerModel
+{
+    DEMO,
+    BENQ,
+    CANON,
+    UNKNOWN
+};
+enum class BenqQuery : uint8_t
+{
+    POWER,
+    SOURCE,
+    LAMP_HOURS,
+    LAMP_MODE,
+    BLANK,
+    MUTE,
+    FREEZE,
+    COUNT
+};
+enum class AVControl : uint8_t
+{
+    BLANK, // picture mute
+    MUTE,  // sound mute
+    COUNT
+};
+enum class PollResult
+{
+    OK,
+    TIMEOUT,
+    CHECKSUM,
+    PARSE
+};
+
+typedef struct
+{
+    const uint8_t *data; // frame bytes, nullptr if there is nothing to send
+    size_t length;       // in bytes
+} frame_t;
+
+typedef struct
+{
+    BeamerModel model;
+    uint8_t buffer[PROJECTOR_RESPONSE_MAX + 1]; // response, BenQ responses are 0 terminated
+    size_t length;                              // bytes in buffer
+    uint8_t checksum;                           // Canon: sum of all bytes before the checksum byte
+    bool started;                               // BenQ: line feed before the response seen
+    bool complete;                              // response complete
+} responseParser_t;
+
+// Canon status response (PROJECTOR INFORMATION REQUEST), DATA01 to DATA16
+typedef struct
+{
+    uint8_t processing; // DATA02: 00H idle, 04H power on, 05H cooling, 06H error standby
+    uint8_t display;    // DATA03: 00H picture, 01H no signal, 10H selecting signal, ...
+    uint8_t terminal;   // DATA04: number of the input terminal (1 to 5)
+    uint8_t input;      // DATA05: input type, 01H computer, 02H video, ... FFH none
+    uint8_t video;      // DATA06: video signal type (low nibble), FFH no video input
+    bool blank;         // DATA07: picture mute
+    bool soundMute;     // DATA08
+    bool onscreenMute;  // DATA09
+    bool freeze;        // DATA10
+} canonStatus_t;
+
+// Pipelined BenQ queries. The replies "*KEY=VALUE#" are matched to the
+// queries by key, replies without key ("*Block item#") and garbled lines
+// to the oldest query not answered yet.
+typedef struct
+{
+    responseParser_t line;                       // reply line, kept until the next byte
+    BenqQuery pending[PROJECTOR_BENQ_BATCH_MAX]; // queries not answered yet, in sent order
+    uint8_t pendingCount;
+    char value[PROJECTOR_RESPONSE_MAX + 1];      // value of the last reply without '#'
+} benqBatch_t;
+
+// Model from the config name ("demo", "benq", "canon")
+BeamerModel projectorModel(const char *name);
+const char *projectorModelName(BeamerModel model);
+const char *projectorStateName(State state);
+const char *projectorPollResultName(PollResult result);
+
+// Frames to send, empty for models without serial protocol
+frame_t projectorPollRequest(BeamerModel model);
+frame_t projectorPowerCommand(BeamerModel model, State state);
+frame_t projectorAVCommand(BeamerModel model, AVControl control, bool on);
+
+// Feed the response byte by byte, returns true once the response is complete
+void projectorParserBegin(responseParser_t &parser, BeamerModel model);
+bool projectorParserFeed(responseParser_t &parser, uint8_t b);
+
+// Decodes the power state of a (possibly incomplete) response, state is
+// UNKNOWN unless the result is OK
+PollResult projectorParserResult(const responseParser_t &parser, State &state);
+
+// True if the response is a complete and valid answer of the model (Canon
+// frame with correct checksum, BenQ "*POW=...#"), even if the state is
+// not known. Used to check the serial link.
+bool projectorResponseValid(const responseParser_t &parser);
+
+// Reply to a command, fed to a parser like a response: replied is true
+// once the reply is there (Canon: ACK or NAK header, BenQ: line), accepted
+// if the projector executes the command (Canon ACK, BenQ "*KEY=VALUE#")
+bool projectorCommandReplied(const responseParser_t &parser);
+bool projectorCommandAccepted(const responseParser_t &parser);
+
+// Decodes the whole Canon status response, false unless it is a valid one
+bool projectorCanonStatus(const responseParser_t &parser, canonStatus_t &status);
+
+// Names of the Canon status codes, "unknown" for undocumented ones
+const char *projectorCanonLampName(uint8_t processing);
+const char *projectorCanonDisplayName(uint8_t display);
+const char *projectorCanonInputName(uint8_t input);
+const char *projectorCanonVideoName(uint8_t video);
+
+// BenQ "*<key>=?#" query frame and key of an attribute
+frame_t projectorBenqQuery(BenqQuery query);
+const char *projectorBenqKey(BenqQuery query);
+
+// Queue the sent queries, then feed the replies byte by byte. Feed returns
+// true once a reply line is complete and answers a query: 'value' is
+// nullptr for an error reply. Echoed commands and replies to unknown keys
+// are skipped.
+void projectorBenqBatchBegin(benqBatch_t &batch);
+bool projectorBenqBatchAdd(benqBatch_t &batch, BenqQuery query);
+bool projectorBenqBatchFeed(benqBatch_t &batch, uint8_t b, BenqQuery &query, const char *&value);
+
+// Reply value as number: 1/0 for ON/OFF, hours for LAMP_HOURS, the index
+// of the name for LAMP_MODE and PROJECTOR_BENQ_SOURCE + the index for
+// SOURCE. -1 if the value is not known.
+int32_t projectorBenqValue(BenqQuery query, const char *value);
+const char *projectorBenqSourceName(int32_t source);
+const char *projectorBenqLampModeName(int32_t mode);
+
+#endif
@@ -0,0 +1,187 @@
+#include "scheduler.h"
+#include "alloccount.h"
+#include "memstats.h"
+#include "clock.h"
+
+static const uint32_t PASS_TIME_BOUNDS[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000, 500000}; // in us
+static schedulerStats_t stats = {0, 0, 0, 0, HISTOGRAM(PASS_TIME_BOUNDS)};
+static taskHook_t hookBefore = nullptr;
+static taskHook_t hookAfter = nullptr;
+
+static uint32_t cyclesToMicros(uint64_t cycles)
+{
+  return cycles / ESP.getCpuFreqMHz();
+}
+
+static void runTask(task_t &task, uint8_t index, uint32_t now)
+{
+  if (task.runs > 0 && now - task.nextRun > task.maxLateness)
+  {
+    task.maxLateness = now - task.nextRun;
+  }
+
+  if (hookBefore)
+  {
+    hookBefore(index);
+  }
+  uint32_t heap = ESP.getFreeHeap();
+  memoryStackReset();
+  allocResetLowWater();
+  uint32_t allocs = allocCount();
+  uint32_t start = ESP.getCycleCount();
+  task.callback();
+  uint32_t cycles = ESP.getCycleCount() - start;
+  allocs = allocCount() - allocs;
+  uint32_t stack = memoryStackUsed();
+  uint32_t lowWater = allocLowWater();
+  if (hookAfter)
+  {
+    hookAfter(index);
+  }
+
+  task.runs++;
+  task.totalCycles += cycles;
+  task.allocs += allocs;
+  if (allocs > task.maxAllocs)
+  {
+    task.maxAllocs = allocs;
+  }
+  if (stack > task.maxStack)
+  {
+    task.maxStack = stack;
+  }
+  if (lowWater < heap && heap - lowWater > task.maxHeap)
+  {
+    task.maxHeap = heap - lowWater;
+  }
+  if (cycles < task.minCycles)
+  {
+    task.minCycles = cycles;
+  }
+  if (cycles > task.maxCycles)
+  {
+    task.maxCycles = cycles;
+  }
+  if (task.budget > 0 && cyclesToMicros(cycles) > task.budget)
+  {
+    task.overruns++;
+  }
+
+  task.triggered = false;
+  if (task.period == SCHEDULER_ON_DEMAND)
+  {
+    return;
+  }
+
+  // Keep the period stable, but skip runs which were missed completely
+  task.nextRun += task.period;
+  now = clockMillis();
+  if ((int32_t)(now - task.nextRun) >= (int32_t)task.period)
+  {
+    task.nextRun = now + task.period;
+  }
+}
+
+void schedulerRun(task_t *tasks, uint8_t count, uint32_t maxIdle)
+{
+  uint32_t start = ESP.getCycleCount();
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    uint32_t now = clockMillis();
+    if (tasks[i].period == SCHEDULER_ON_DEMAND)
+    {
+      if (tasks[i].triggered)
+      {
+        runTask(tasks[i], i, now);
+      }
+      continue;
+    }
+    if (tasks[i].runs == 0)
+    {
+      tasks[i].nextRun = now;
+    }
+    if ((int32_t)(now - tasks[i].nextRun) >= 0)
+    {
+      runTask(tasks[i], i, now);
+    }
+  }
+
+  memorySample();
+
+  stats.passes++;
+  stats.lastPassTime = cyclesToMicros(ESP.getCycleCount() - start);
+  histogramAdd(stats.passTime, stats.lastPassTime);
+  if (stats.lastPassTime > stats.maxPassTime)
+  {
+    stats.maxPassTime = stats.lastPassTime;
+  }
+
+  // Idle until the next task is due
+  uint32_t now = clockMillis();
+  uint32_t idle = maxIdle;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (tasks[i].period == SCHEDULER_ON_DEMAND && !tasks[i].triggered)
+    {
+      continue;
+    }
+    int32_t wait = tasks[i].nextRun - now;
+    if (wait <= 0)
+    {
+      idle = 0;
+      break;
+    }
+    if ((uint32_t)wait < idle)
+    {
+      idle = wait;
+    }
+  }
+  if (idle > 0)
+  {
+    stats.idleTime += idle;
+    clockDelay(idle); // yields to the SDK and allows modem sleep
+  }
+}
+
+void schedulerSetPeriod(task_t &task, uint32_t period)
+{
+  uint32_t now = clockMillis();
+  task.period = period;
+  if ((int32_t)(task.nextRun - now) > (int32_t)period)
+  {
+    task.nextRun = now + period;
+  }
+}
+
+void schedulerTrigger(task_t &task)
+{
+  task.nextRun = clockMillis();
+  task.triggered = true;
+}
+
+void schedulerSetHooks(taskHook_t before, taskHook_t after)
+{
+  hookBefore = before;
+  hookAfter = after;
+}
+
+const schedulerStats_t &schedulerGetStats()
+{
+  return stats;
+}
+
+uint32_t taskAvgTime(const task_t &task)
+{
+  return task.runs ? cyclesToMicros(task.totalCycles / task.runs) : 0;
+}
+
+uint32_t taskMinTime(const task_t &task)
+{
+  return task.runs ? cyclesToMicros(task.minCycles) : 0;
+}
+
+uint32_t taskMaxTime(const task_t &task)
+{
+  return cyclesToMicros(task.maxCycles);
+}
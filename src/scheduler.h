@@ -0,0 +1,69 @@
+#ifndef scheduler_h
+#define scheduler_h
+
+#include <Arduino.h>
+#include "histogram.h"
+
+// Cooperative scheduler for the main loop. Tasks are plain functions which
+// must return quickly; each one has a period and a time budget and the
+// scheduler keeps run time statistics per task.
+
+typedef void (*taskCallback_t)();
+typedef void (*taskHook_t)(uint8_t index);
+
+typedef struct
+{
+    const char *name;        // Shown on status page and in metrics
+    taskCallback_t callback; // Function to run
+    uint32_t period;         // in ms, 0 = run on every scheduler pass, SCHEDULER_ON_DEMAND = only when triggered
+    uint32_t budget;         // in us, a run taking longer is counted as overrun
+    uint32_t nextRun;        // clockMillis() of next run
+    uint32_t runs;           // number of runs since boot
+    uint32_t overruns;       // number of runs exceeding the budget
+    uint32_t minCycles;      // shortest run in CPU cycles
+    uint32_t maxCycles;      // longest run in CPU cycles
+    uint64_t totalCycles;    // sum of all runs in CPU cycles
+    uint32_t maxLateness;    // max. delay between due time and start in ms (jitter)
+    uint32_t allocs;         // heap allocations since boot
+    uint32_t maxAllocs;      // max. heap allocations in a single run
+    uint32_t maxStack;       // max. loop stack used during a run in bytes
+    uint32_t maxHeap;        // max. heap taken during a run in bytes
+    bool triggered;          // schedulerTrigger() was called since the last run
+} task_t;
+
+typedef struct
+{
+    uint32_t passes;       // number of scheduler passes
+    uint32_t idleTime;     // accumulated idle time in ms
+    uint32_t maxPassTime;  // longest pass (without idle) in us
+    uint32_t lastPassTime; // last pass (without idle) in us
+    histogram_t passTime;  // pass times (without idle) in us
+} schedulerStats_t;
+
+// Period of tasks which only run in the pass after schedulerTrigger()
+#define SCHEDULER_ON_DEMAND UINT32_MAX
+
+// Creates a task entry, runtime fields are zeroed
+#define SCHEDULER_TASK(name, callback, period, budget) {name, callback, period, budget, 0, 0, 0, UINT32_MAX, 0, 0, 0, 0, 0, 0, 0, false}
+
+// Runs all due tasks once and idles until the next task is due (max. maxIdle ms)
+void schedulerRun(task_t *tasks, uint8_t count, uint32_t maxIdle);
+
+// Changes the period of a task, the next run is due after the new period at the latest
+void schedulerSetPeriod(task_t &task, uint32_t period);
+
+// Makes a task due at once, it runs in the next pass and keeps its period
+// from there. The only way to run a SCHEDULER_ON_DEMAND task.
+void schedulerTrigger(task_t &task);
+
+// Optional functions called before and after each task run with the task index
+void schedulerSetHooks(taskHook_t before, taskHook_t after);
+
+const schedulerStats_t &schedulerGetStats();
+
+// Helpers to convert the cycle statistics of a task to us
+uint32_t taskAvgTime(const task_t &task);
+uint32_t taskMinTime(const task_t &task);
+uint32_t taskMaxTime(const task_t &task);
+
+#endif
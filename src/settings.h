@@ -29,7 +29,9 @@ typedef struct
     uint8_t led_brightness;                 // 1byte (in percent)
     char api_username[30];                  // 30 bytes
     char api_password[30];                  // 30 bytes
-                                            // Total: 480 bytes
+    char syslog_server[30];                 // 30 bytes (since config version 7)
+    uint16_t syslog_port;                   // 2 bytes (since config version 7)
+                                            // Total: 514 bytes, 516 with padding (sizeof)
 } configData_t;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "status.h"
+#include "device.h"
+#include "clock.h"
+#include "log.h"
+
+void statusAddDevice(JsonDocument &doc, uint32_t maxAge)
+{
+  switch (deviceState())
+  {
+  case State::ON:
+    doc["pwrstate"] = "on";
+    break;
+  case State::OFF:
+    doc["pwrstate"] = "off";
+    break;
+  case State::UNKNOWN:
+    doc["pwrstate"] = "unknown";
+    break;
+  }
+
+  // Outcome of the last power command
+  const powerCommand_t &powerCommand = devicePowerCommand();
+  if (powerCommand.status != CommandStatus::NONE)
+  {
+    doc["pwrtarget"] = powerCommand.target == State::ON ? "on" : "off";
+    doc["pwrcommand"] = deviceCommandStatusName(powerCommand.status);
+    doc["pwrcommand_ms"] = powerCommand.status == CommandStatus::PENDING ? clockMillis() - powerCommand.start : powerCommand.time;
+  }
+
+  // Outcome of the last blank and mute command
+  for (uint8_t c = 0; c < (uint8_t)AVControl::COUNT; c++)
+  {
+    const avCommand_t &cmd = deviceAVCommand((AVControl)c);
+    if (cmd.status != CommandStatus::NONE)
+    {
+      doc[deviceAVControl((AVControl)c).command] = deviceCommandStatusName(cmd.status);
+      doc[deviceAVControl((AVControl)c).commandTime] = cmd.status == CommandStatus::PENDING ? clockMillis() - cmd.start : cmd.time;
+    }
+  }
+
+  // Attributes beyond the power state, as far as the model reports them
+  for (uint8_t i = (uint8_t)Attribute::POWER + 1; i < (uint8_t)Attribute::COUNT; i++)
+  {
+    const cacheEntry_t &entry = cacheEntry((Attribute)i);
+    int32_t value;
+    bool valid = cacheGet((Attribute)i, value, maxAge);
+    for (uint8_t c = 0; c < (uint8_t)AVControl::COUNT; c++)
+    {
+      // Optimistic like the power state
+      const avCommand_t &cmd = deviceAVCommand((AVControl)c);
+      if (deviceAVControl((AVControl)c).attribute == (Attribute)i && cmd.status == CommandStatus::PENDING)
+      {
+        valid = true;
+        value = cmd.target;
+      }
+    }
+    if (!valid)
+    {
+      continue;
+    }
+    if (entry.text)
+    {
+      doc[entry.name] = entry.text(value);
+    }
+    else
+    {
+      doc[entry.name] = value;
+    }
+  }
+  if (deviceChanged())
+  {
+    JsonArray changed = doc.createNestedArray("changed");
+    for (uint8_t i = 0; i < (uint8_t)Attribute::COUNT; i++)
+    {
+      if (deviceChanged() & (1UL << i))
+      {
+        changed.add(cacheEntry((Attribute)i).name);
+      }
+    }
+  }
+}
+
+bool statusParseCommand(const uint8_t *payload, size_t length, mqttCommand_t &cmd)
+{
+  StaticJsonDocument<256> jsondoc;
+  DeserializationError err = deserializeJson(jsondoc, payload, length);
+  if (err)
+  {
+    LOG_WARN("deserializeJson() failed: %s", err.c_str());
+    return false;
+  }
+
+  JsonObject json = jsondoc.as<JsonObject>();
+  cmd.power = State::UNKNOWN;
+  cmd.status = json.containsKey("status");
+  cmd.maxAge = json["maxage"].as<uint32_t>();
+
+  // Serial capture start/stop
+  const char *capture = json["capture"];
+  cmd.captureStart = capture != nullptr && strcmp_P(capture, PSTR("start")) == 0;
+  cmd.captureStop = capture != nullptr && strcmp_P(capture, PSTR("stop")) == 0;
+
+  // Blank and mute on/off
+  for (uint8_t c = 0; c < (uint8_t)AVControl::COUNT; c++)
+  {
+    const char *av = json[deviceAVControl((AVControl)c).name];
+    cmd.av[c] = -1;
+    if (av != nullptr && strcmp_P(av, PSTR("on")) == 0)
+    {
+      cmd.av[c] = 1;
+    }
+    else if (av != nullptr && strcmp_P(av, PSTR("off")) == 0)
+    {
+      cmd.av[c] = 0;
+    }
+  }
+
+  // Power on/off
+  if (json.containsKey("poweron"))
+  {
+    // Only true/false or 1/0, a string must not switch the projector off
+    JsonVariant poweron = json["poweron"];
+    if (poweron.is<bool>() || poweron.is<int>())
+    {
+      cmd.power = poweron.as<bool>() ? State::ON : State::OFF;
+    }
+  }
+  else
+  {
+    const char *pwrstate = json["pwrstate"];
+    if (pwrstate != nullptr && strcmp_P(pwrstate, PSTR("on")) == 0)
+    {
+      cmd.power = State::ON;
+    }
+    else if (pwrstate != nullptr && strcmp_P(pwrstate, PSTR("off")) == 0)
+    {
+      cmd.power = State::OFF;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,29 @@
+#ifndef status_h
+#define status_h
+
+#include <ArduinoJson.h>
+#include "projector.h"
+
+// Command on the MQTT command topic
+typedef struct
+{
+    State power;                          // requested power state, UNKNOWN for none
+    bool status;                          // status update requested
+    uint32_t maxAge;                      // max. age of the status values in ms, 0 = cache TTL
+    bool captureStart;                    // serial capture start requested
+    bool captureStop;                     // serial capture stop requested
+    int8_t av[(size_t)AVControl::COUNT];  // requested blank and mute state 1/0, -1 for none
+} mqttCommand_t;
+
+// Projector part of the status message: power state, outcome of the last
+// power, blank and mute command, the polled attributes not older than
+// maxAge ms (0 = their TTL) and the list of changed ones. Values are stored
+// as constant strings or numbers, so the document does not copy anything
+// and building it does not allocate.
+void statusAddDevice(JsonDocument &doc, uint32_t maxAge = 0);
+
+// Parses a JSON command, false if it is not valid JSON. Unknown keys and
+// values of the wrong type are ignored.
+bool statusParseCommand(const uint8_t *payload, size_t length, mqttCommand_t &cmd);
+
+#endif
@@ -0,0 +1,373 @@
+#include "transport.h"
+#include "capture.h"
+
+static transportStats_t stats = {0, 0, 0, 0, 0};
+static uint32_t baudRate = 0;
+
+// Received bytes drained from the backend while a capture runs, so the
+// capture stamps them on arrival and not when the parser gets to them
+static uint8_t rxStage[TRANSPORT_RX_BUFFER_SIZE];
+static uint32_t rxStageHead = 0; // total bytes drained, index is % TRANSPORT_RX_BUFFER_SIZE
+static uint32_t rxStageTail = 0; // total bytes read
+
+#if defined(TRANSPORT_FAKE)
+
+static const size_t FAKE_BUFFER_SIZE = 256;
+
+static uint8_t fakeRx[FAKE_BUFFER_SIZE];
+static uint32_t fakeRxHead = 0; // total bytes fed, index is % FAKE_BUFFER_SIZE
+static uint32_t fakeRxTail = 0; // total bytes read
+static uint8_t fakeTx[FAKE_BUFFER_SIZE];
+static uint32_t fakeTxHead = 0;
+static uint32_t fakeTxTail = 0;
+static void (*fakeWriteHandler)(const uint8_t *data, size_t length) = nullptr;
+
+void transportFakeReceive(const uint8_t *data, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    if (fakeRxHead - fakeRxTail >= FAKE_BUFFER_SIZE)
+    {
+      stats.overflows++;
+      return;
+    }
+    fakeRx[fakeRxHead++ % FAKE_BUFFER_SIZE] = data[i];
+  }
+}
+
+void transportFakeOnWrite(void (*handler)(const uint8_t *data, size_t length))
+{
+  fakeWriteHandler = handler;
+}
+
+size_t transportFakeSent(uint8_t *data, size_t size)
+{
+  size_t n = 0;
+  while (n < size && fakeTxTail != fakeTxHead)
+  {
+    data[n++] = fakeTx[fakeTxTail++ % FAKE_BUFFER_SIZE];
+  }
+  return n;
+}
+
+static void backendBegin(uint32_t baud)
+{
+  fakeRxHead = fakeRxTail = fakeTxHead = fakeTxTail = 0;
+}
+
+static void backendSetBaudRate(uint32_t baud)
+{
+}
+
+static size_t backendWrite(const uint8_t *data, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    fakeTx[fakeTxHead++ % FAKE_BUFFER_SIZE] = data[i];
+    if (fakeTxHead - fakeTxTail > FAKE_BUFFER_SIZE)
+    {
+      fakeTxTail++; // oldest byte lost
+    }
+  }
+  if (fakeWriteHandler)
+  {
+    fakeWriteHandler(data, length);
+  }
+  return length;
+}
+
+static int backendAvailable()
+{
+  return fakeRxHead - fakeRxTail;
+}
+
+static int backendRead()
+{
+  return fakeRxTail != fakeRxHead ? fakeRx[fakeRxTail++ % FAKE_BUFFER_SIZE] : -1;
+}
+
+static void backendCheck()
+{
+}
+
+const char *transportName()
+{
+  return "fake";
+}
+
+#elif defined(TRANSPORT_HARDWARE)
+
+static void backendBegin(uint32_t baud)
+{
+  // The log is on UART1 (log.h), UART0 is moved away from the USB converter
+  Serial.setRxBufferSize(TRANSPORT_RX_BUFFER_SIZE);
+  Serial.begin(baud);
+  Serial.swap();
+}
+
+static void backendSetBaudRate(uint32_t baud)
+{
+  Serial.updateBaudRate(baud);
+}
+
+static size_t backendWrite(const uint8_t *data, size_t length)
+{
+  return Serial.write(data, length);
+}
+
+static int backendAvailable()
+{
+  return Serial.available();
+}
+
+static int backendRead()
+{
+  return Serial.read();
+}
+
+static void backendCheck()
+{
+  // Both flags are cleared by reading them
+  if (Serial.hasOverrun())
+  {
+    stats.overflows++;
+  }
+  if (Serial.hasRxError())
+  {
+    stats.rxErrors++;
+  }
+}
+
+const char *transportName()
+{
+  return "hardware";
+}
+
+#elif defined(TRANSPORT_TTY)
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+static const char *ttyDevice = nullptr;
+static int ttyFd = -1;
+
+void transportTtySetDevice(const char *device)
+{
+  ttyDevice = device;
+}
+
+static speed_t ttySpeed(uint32_t baud)
+{
+  switch (baud)
+  {
+  case 9600:
+    return B9600;
+  case 38400:
+    return B38400;
+  case 57600:
+    return B57600;
+  case 115200:
+    return B115200;
+  default:
+    return B19200;
+  }
+}
+
+static void backendSetBaudRate(uint32_t baud)
+{
+  // On a pseudo terminal the speed is only a setting, projectorsim.py
+  // garbles the traffic if it differs from the simulated one
+  struct termios attrs;
+  if (ttyFd < 0 || tcgetattr(ttyFd, &attrs) != 0)
+  {
+    return;
+  }
+  cfmakeraw(&attrs);
+  cfsetispeed(&attrs, ttySpeed(baud));
+  cfsetospeed(&attrs, ttySpeed(baud));
+  tcsetattr(ttyFd, TCSANOW, &attrs);
+}
+
+static void backendBegin(uint32_t baud)
+{
+  if (ttyFd < 0 && ttyDevice)
+  {
+    ttyFd = open(ttyDevice, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  }
+  backendSetBaudRate(baud);
+}
+
+static size_t backendWrite(const uint8_t *data, size_t length)
+{
+  ssize_t written = ttyFd >= 0 ? write(ttyFd, data, length) : -1;
+  return written > 0 ? written : 0;
+}
+
+static int backendAvailable()
+{
+  int count = 0;
+  if (ttyFd < 0 || ioctl(ttyFd, FIONREAD, &count) != 0)
+  {
+    return 0;
+  }
+  return count;
+}
+
+static int backendRead()
+{
+  uint8_t b;
+  return ttyFd >= 0 && read(ttyFd, &b, 1) == 1 ? b : -1;
+}
+
+static void backendCheck()
+{
+}
+
+const char *transportName()
+{
+  return "tty";
+}
+
+#else
+
+#include <SoftwareSerial.h>
+
+static SoftwareSerial swSer(D6, D5);
+
+static void backendBegin(uint32_t baud)
+{
+  swSer.begin(baud);
+}
+
+static void backendSetBaudRate(uint32_t baud)
+{
+  swSer.begin(baud);
+}
+
+static size_t backendWrite(const uint8_t *data, size_t length)
+{
+  return swSer.write(data, length);
+}
+
+static int backendAvailable()
+{
+  return swSer.available();
+}
+
+static int backendRead()
+{
+  return swSer.read();
+}
+
+static void backendCheck()
+{
+  // Cleared by reading it
+  if (swSer.overflow())
+  {
+    stats.overflows++;
+  }
+}
+
+const char *transportName()
+{
+  return "software";
+}
+
+#endif
+
+void transportBegin(uint32_t baud)
+{
+  baudRate = baud;
+  rxStageHead = rxStageTail = 0;
+  captureBaudRate(baud);
+  backendBegin(baud);
+}
+
+void transportSetBaudRate(uint32_t baud)
+{
+  if (baud != baudRate)
+  {
+    baudRate = baud;
+    captureBaudRate(baud);
+    backendSetBaudRate(baud);
+  }
+}
+
+uint32_t transportBaudRate()
+{
+  return baudRate;
+}
+
+uint32_t transportByteTime()
+{
+  // 8N1: start, 8 data and stop bit
+  return baudRate ? 10000000UL / baudRate : 0;
+}
+
+size_t transportWrite(const uint8_t *data, size_t length)
+{
+  uint32_t start = micros();
+  size_t written = backendWrite(data, length);
+  stats.txTime += micros() - start;
+  stats.txBytes += written;
+  captureWrite(data, written, start, transportByteTime());
+  return written;
+}
+
+static void drain()
+{
+  if (!captureActive())
+  {
+    return;
+  }
+  uint32_t now = micros();
+  int available = backendAvailable();
+  while (available-- > 0 && rxStageHead - rxStageTail < TRANSPORT_RX_BUFFER_SIZE)
+  {
+    int b = backendRead();
+    if (b < 0)
+    {
+      break;
+    }
+    rxStage[rxStageHead++ % TRANSPORT_RX_BUFFER_SIZE] = b;
+    captureRead(b, now);
+  }
+}
+
+int transportAvailable()
+{
+  backendCheck();
+  drain();
+  return (rxStageHead - rxStageTail) + backendAvailable();
+}
+
+int transportRead()
+{
+  if (rxStageTail != rxStageHead)
+  {
+    stats.rxBytes++;
+    return rxStage[rxStageTail++ % TRANSPORT_RX_BUFFER_SIZE];
+  }
+  int b = backendRead();
+  if (b >= 0)
+  {
+    stats.rxBytes++;
+    captureRead(b, micros());
+  }
+  return b;
+}
+
+void transportClear()
+{
+  while (transportAvailable())
+  {
+    transportRead();
+  }
+}
+
+const transportStats_t &transportGetStats()
+{
+  return stats;
+}
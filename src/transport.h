@@ -0,0 +1,63 @@
+#ifndef transport_h
+#define transport_h
+
+#include <Arduino.h>
+
+// Serial link to the projector. The backend is chosen at compile time:
+//
+// - default: SoftwareSerial on D6 (RX) and D5 (TX)
+// - -D TRANSPORT_HARDWARE: UART0 swapped to GPIO13 (D7, RX) and GPIO15
+//   (D8, TX) with interrupt-driven RX into TRANSPORT_RX_BUFFER_SIZE bytes.
+//   The log moves to UART1 (GPIO2, D4, TX only) and the WiFi/MQTT LEDs to
+//   D5/D6, so converter and LEDs swap pins.
+// - -D TRANSPORT_FAKE: in-memory buffers for simulations, the received
+//   bytes are fed with transportFakeReceive()
+// - -D TRANSPORT_TTY: a serial port or pseudo terminal of a Linux/macOS
+//   host (host builds only, e.g. test/host against projectorsim.py)
+//
+// All traffic is recorded by the serial capture (capture.h).
+
+#define TRANSPORT_RX_BUFFER_SIZE 256 // hardware UART RX buffer in bytes
+
+typedef struct
+{
+    uint32_t rxBytes;   // bytes received
+    uint32_t txBytes;   // bytes sent
+    uint32_t overflows; // RX buffer overflows
+    uint32_t rxErrors;  // framing or parity errors (hardware UART only)
+    uint64_t txTime;    // time spent in transportWrite() in us
+} transportStats_t;
+
+void transportBegin(uint32_t baud);
+// Changes the baud rate of a running transport (SoftwareSerial reallocates
+// its RX buffer)
+void transportSetBaudRate(uint32_t baud);
+uint32_t transportBaudRate();
+const char *transportName();
+// Time of one byte on the wire at the current baud rate in us
+uint32_t transportByteTime();
+
+size_t transportWrite(const uint8_t *data, size_t length);
+int transportAvailable();
+int transportRead();
+
+// Discards all received bytes
+void transportClear();
+
+const transportStats_t &transportGetStats();
+
+#ifdef TRANSPORT_FAKE
+// Bytes the fake projector answers with
+void transportFakeReceive(const uint8_t *data, size_t length);
+// Copies up to 'size' bytes sent since the last call, returns the count
+size_t transportFakeSent(uint8_t *data, size_t size);
+// Calls 'handler' with every write, so a fake projector can answer at once
+void transportFakeOnWrite(void (*handler)(const uint8_t *data, size_t length));
+#endif
+
+#ifdef TRANSPORT_TTY
+// Port opened by transportBegin()
+void transportTtySetDevice(const char *device);
+#endif
+
+#endif
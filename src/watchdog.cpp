@@ -0,0 +1,144 @@
+#include "watchdog.h"
+#include "clock.h"
+
+// The first 128 bytes of the RTC user memory are used by eboot for OTA
+static const uint32_t RTC_OFFSET = 32; // in 4 byte blocks
+static const uint32_t RTC_MAGIC = 0x57444732;
+
+static_assert(sizeof(watchdogData_t) <= 512 - RTC_OFFSET * 4, "watchdog data does not fit into RTC memory");
+static_assert(sizeof(traceEntry_t) % 4 == 0 && sizeof(stallEntry_t) % 4 == 0, "RTC entries must be 4 byte aligned");
+
+static watchdogData_t data;
+static watchdogData_t previous;
+static bool hasPrevious = false;
+
+// Writes a part of 'data' through to RTC memory
+static void rtcSave(const void *field, size_t size)
+{
+  size_t pos = (const uint8_t *)field - (const uint8_t *)&data;
+  ESP.rtcUserMemoryWrite(RTC_OFFSET + pos / 4, (uint32_t *)&data + pos / 4, (size + 3) & ~3);
+}
+
+static void addTrace(uint8_t phase, TraceEvent event, uint32_t time, uint32_t duration)
+{
+  traceEntry_t &entry = data.trace[data.traceHead];
+  entry.time = time;
+  entry.phase = phase;
+  entry.event = event;
+  entry.duration = duration > 0xFFFF ? 0xFFFF : duration;
+  rtcSave(&entry, sizeof(entry));
+
+  data.traceHead = (data.traceHead + 1) % WATCHDOG_TRACE_SIZE;
+  rtcSave(&data.traceHead, sizeof(data.traceHead));
+}
+
+static void addStall(uint8_t phase, uint32_t time, uint32_t duration)
+{
+  stallEntry_t &entry = data.stalls[data.stallHead];
+  entry.time = time;
+  entry.duration = duration;
+  entry.phase = phase;
+  entry.boot = data.bootCount;
+  entry.reserved = 0;
+  rtcSave(&entry, sizeof(entry));
+
+  data.stallHead = (data.stallHead + 1) % WATCHDOG_STALL_SIZE;
+  data.stallCount++;
+  rtcSave(&data.traceHead, sizeof(data.traceHead) + sizeof(data.stallHead) + sizeof(data.stallCount));
+}
+
+void watchdogBegin()
+{
+  ESP.rtcUserMemoryRead(RTC_OFFSET, (uint32_t *)&data, sizeof(data));
+
+  if (data.magic == RTC_MAGIC && data.traceHead < WATCHDOG_TRACE_SIZE && data.stallHead < WATCHDOG_STALL_SIZE)
+  {
+    previous = data;
+    hasPrevious = true;
+
+    // The innermost phase which was entered but not left before reset
+    if (data.openDepth > 0)
+    {
+      const traceEntry_t &entry = data.open[min(data.openDepth, (uint16_t)WATCHDOG_MAX_DEPTH) - 1];
+      addStall(entry.phase, entry.time, WATCHDOG_DURATION_UNKNOWN);
+    }
+  }
+  else
+  {
+    // Power on or invalid content
+    memset(&data, 0, sizeof(data));
+    data.magic = RTC_MAGIC;
+  }
+
+  data.bootCount++;
+  data.openDepth = 0;
+  memset(data.open, 0, sizeof(data.open));
+  memset(data.trace, 0, sizeof(data.trace));
+  data.traceHead = 0;
+  ESP.rtcUserMemoryWrite(RTC_OFFSET, (uint32_t *)&data, sizeof(data));
+
+  addTrace(0, TraceEvent::BOOT, clockMillis(), 0);
+}
+
+void watchdogEnter(uint8_t phase)
+{
+  if (data.openDepth < WATCHDOG_MAX_DEPTH)
+  {
+    traceEntry_t &entry = data.open[data.openDepth];
+    entry.time = clockMillis();
+    entry.phase = phase;
+    entry.event = TraceEvent::ENTER;
+    entry.duration = 0;
+    rtcSave(&entry, sizeof(entry));
+  }
+  data.openDepth++;
+  rtcSave(&data.openDepth, sizeof(data.openDepth));
+}
+
+void watchdogExit(uint8_t phase)
+{
+  uint32_t now = clockMillis();
+  uint32_t duration = 0;
+  if (data.openDepth > 0)
+  {
+    data.openDepth--;
+    rtcSave(&data.openDepth, sizeof(data.openDepth));
+    if (data.openDepth < WATCHDOG_MAX_DEPTH && data.open[data.openDepth].phase == phase)
+    {
+      duration = now - data.open[data.openDepth].time;
+    }
+  }
+
+  // Short phases would flush the ring within a few scheduler passes
+  if (duration >= WATCHDOG_TRACE_THRESHOLD)
+  {
+    addTrace(phase, TraceEvent::EXIT, now, duration);
+  }
+  if (duration > WATCHDOG_STALL_THRESHOLD)
+  {
+    addStall(phase, now, duration);
+  }
+}
+
+void watchdogReset()
+{
+  data.openDepth = 0;
+  rtcSave(&data.openDepth, sizeof(data.openDepth));
+  addTrace(0, TraceEvent::RESET, clockMillis(), 0);
+  ESP.reset();
+}
+
+const watchdogData_t &watchdogCurrent()
+{
+  return data;
+}
+
+const watchdogData_t &watchdogPrevious()
+{
+  return previous;
+}
+
+bool watchdogHasPrevious()
+{
+  return hasPrevious;
+}
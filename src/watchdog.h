@@ -0,0 +1,76 @@
+#ifndef watchdog_h
+#define watchdog_h
+
+#include <Arduino.h>
+
+// Software watchdog for the main loop. The running (nested) loop phases are
+// kept in a slot per nesting level, phases running longer than
+// WATCHDOG_TRACE_THRESHOLD are written to a small ring buffer and those
+// longer than WATCHDOG_STALL_THRESHOLD are recorded as stall. Everything is
+// kept in RTC memory and survives a soft reset.
+
+#define WATCHDOG_TRACE_SIZE 24
+#define WATCHDOG_STALL_SIZE 8
+#define WATCHDOG_MAX_DEPTH 4
+#define WATCHDOG_TRACE_THRESHOLD 20  // in ms, shorter phases are not traced
+#define WATCHDOG_STALL_THRESHOLD 500 // in ms
+#define WATCHDOG_DURATION_UNKNOWN 0xFFFFFFFF
+
+enum class TraceEvent : uint8_t
+{
+    ENTER, // phase still running (open slots only)
+    EXIT,
+    BOOT,
+    RESET // intentional reset by watchdogReset()
+};
+
+typedef struct
+{
+    uint32_t time;     // clockMillis() of the event
+    uint8_t phase;     // phase id, see tracePhaseName()
+    TraceEvent event;  // enter, exit, boot or reset marker
+    uint16_t duration; // in ms for exit events (capped)
+} traceEntry_t;
+
+typedef struct
+{
+    uint32_t time;     // clockMillis() when the stall ended
+    uint32_t duration; // in ms, WATCHDOG_DURATION_UNKNOWN if the device was reset during the phase
+    uint8_t phase;     // phase id
+    uint8_t boot;      // boot counter (lower 8 bits) at time of the stall
+    uint16_t reserved;
+} stallEntry_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t bootCount;
+    uint16_t traceHead; // next write position
+    uint16_t stallHead; // next write position
+    uint32_t stallCount;
+    uint16_t openDepth; // phases entered but not left, may exceed WATCHDOG_MAX_DEPTH
+    uint16_t reserved;
+    traceEntry_t open[WATCHDOG_MAX_DEPTH]; // enter events of the running phases
+    traceEntry_t trace[WATCHDOG_TRACE_SIZE];
+    stallEntry_t stalls[WATCHDOG_STALL_SIZE];
+} watchdogData_t;
+
+// Loads the buffers from RTC memory, keeps a copy of the last trace before
+// reset and records a stall if the reset happened inside a phase
+void watchdogBegin();
+
+void watchdogEnter(uint8_t phase);
+void watchdogExit(uint8_t phase);
+
+// Closes the running phases, marks the reset as intentional in the trace
+// and resets the device, the next boot does not report a stall
+void watchdogReset();
+
+// Trace and stalls of the current boot
+const watchdogData_t &watchdogCurrent();
+
+// Trace of the previous boot (only valid if watchdogHasPrevious())
+const watchdogData_t &watchdogPrevious();
+bool watchdogHasPrevious();
+
+#endif
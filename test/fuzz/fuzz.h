@@ -0,0 +1,46 @@
+#ifndef fuzz_h
+#define fuzz_h
+
+// Shared part of the fuzz targets. Every target defines
+// LLVMFuzzerTestOneInput(), built with libFuzzer or with standalone.cpp.
+
+#include <stdlib.h>
+#include "projector.h"
+
+// Stops the run like a sanitizer finding, so the input is kept
+#define FUZZ_CHECK(condition) \
+  do                          \
+  {                           \
+    if (!(condition))         \
+    {                         \
+      abort();                \
+    }                         \
+  } while (0)
+
+// Feeds the bytes to a parser of the model, also past the end of the
+// response, and decodes it with every function devicePoll() uses
+static inline void fuzzResponse(BeamerModel model, const uint8_t *data, size_t size)
+{
+  responseParser_t parser;
+  State state;
+  canonStatus_t status;
+  projectorParserBegin(parser, model);
+  for (size_t n = 0; n < size; n++)
+  {
+    projectorParserFeed(parser, data[n]);
+    FUZZ_CHECK(parser.length <= PROJECTOR_RESPONSE_MAX);
+  }
+  PollResult result = projectorParserResult(parser, state);
+  FUZZ_CHECK(result == PollResult::OK || state == State::UNKNOWN);
+  FUZZ_CHECK(!projectorCommandAccepted(parser) || projectorCommandReplied(parser));
+  projectorResponseValid(parser);
+  if (projectorCanonStatus(parser, status))
+  {
+    projectorCanonLampName(status.processing);
+    projectorCanonDisplayName(status.display);
+    projectorCanonInputName(status.input);
+    projectorCanonVideoName(status.video);
+  }
+}
+
+#endif
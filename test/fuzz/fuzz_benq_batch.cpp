@@ -0,0 +1,38 @@
+// Pipelined BenQ replies: the first byte selects the queued queries (count
+// in bits 0-1, first query in bits 2-7), the rest are the replies
+#include <string.h>
+#include "fuzz.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  if (size == 0)
+  {
+    return 0;
+  }
+  benqBatch_t batch;
+  projectorBenqBatchBegin(batch);
+  for (uint8_t i = 0; i <= (data[0] & 0x03); i++)
+  {
+    projectorBenqBatchAdd(batch, (BenqQuery)(((data[0] >> 2) + i) % (uint8_t)BenqQuery::COUNT));
+  }
+
+  for (size_t n = 1; n < size; n++)
+  {
+    uint8_t pending = batch.pendingCount;
+    BenqQuery query;
+    const char *value;
+    if (projectorBenqBatchFeed(batch, data[n], query, value))
+    {
+      // Every reply answers one of the pending queries
+      FUZZ_CHECK(batch.pendingCount == pending - 1);
+      FUZZ_CHECK(query < BenqQuery::COUNT);
+      if (value)
+      {
+        FUZZ_CHECK(strlen(value) <= PROJECTOR_RESPONSE_MAX);
+        projectorBenqValue(query, value);
+      }
+    }
+    FUZZ_CHECK(batch.pendingCount <= PROJECTOR_BENQ_BATCH_MAX);
+  }
+  return 0;
+}
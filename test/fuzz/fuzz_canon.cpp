@@ -0,0 +1,8 @@
+// Canon response parser: any byte sequence, fed like devicePoll() does
+#include "fuzz.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  fuzzResponse(BeamerModel::CANON, data, size);
+  return 0;
+}
@@ -0,0 +1,19 @@
+// JSON command on the MQTT command topic
+#include "fuzz.h"
+#include "status.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  mqttCommand_t cmd;
+  if (!statusParseCommand(data, size, cmd))
+  {
+    return 0;
+  }
+  FUZZ_CHECK(cmd.power == State::ON || cmd.power == State::OFF || cmd.power == State::UNKNOWN);
+  FUZZ_CHECK(!(cmd.captureStart && cmd.captureStop));
+  for (int8_t av : cmd.av)
+  {
+    FUZZ_CHECK(av >= -1 && av <= 1);
+  }
+  return 0;
+}
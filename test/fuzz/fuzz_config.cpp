@@ -0,0 +1,36 @@
+// Settings form dispatch: "name=value", both may contain any byte but 0
+#include <string.h>
+#include "fuzz.h"
+#include "config.h"
+
+#define TERMINATED(field) (strnlen(field, sizeof(field)) < sizeof(field))
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  char input[256];
+  if (size >= sizeof(input) || memchr(data, 0, size))
+  {
+    return 0;
+  }
+  memcpy(input, data, size);
+  input[size] = 0;
+  char *value = strchr(input, '=');
+  if (!value)
+  {
+    return 0;
+  }
+  *value++ = 0;
+
+  static configData_t cfg;
+  configDefaults(cfg);
+  configData_t before = cfg;
+  if (!configApply(cfg, input, value))
+  {
+    // A rejected value leaves the settings alone
+    FUZZ_CHECK(memcmp(&before, &cfg, sizeof(cfg)) == 0);
+  }
+  FUZZ_CHECK(TERMINATED(cfg.note) && TERMINATED(cfg.hostname) && TERMINATED(cfg.admin_password));
+  FUZZ_CHECK(TERMINATED(cfg.mqtt_server) && TERMINATED(cfg.mqtt_prefix) && TERMINATED(cfg.syslog_server));
+  FUZZ_CHECK(configMigrate(cfg));
+  return 0;
+}
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+# Seed corpus of the fuzz targets: the projector responses of the serial
+# transcripts (_docs/Documentation/transcripts) and the documented MQTT
+# commands and settings. Files are named by their SHA-1 like libFuzzer does.
+
+import glob
+import hashlib
+import os
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DOCS = os.path.join(HERE, "..", "..", "_docs", "Documentation")
+sys.path.insert(0, DOCS)
+
+import projectorsim  # noqa: E402
+
+COMMANDS = [
+	b'{"pwrstate":"on"}',
+	b'{"pwrstate":"off"}',
+	b'{"poweron":true}',
+	b'{"poweron":0}',
+	b'{"blank":"on","mute":"off"}',
+	b'{"status":"get","maxage":5000}',
+	b'{"capture":"start"}',
+	b'{"capture":"stop"}',
+]
+
+SETTINGS = [
+	b"hostname= beamer ",
+	b"note=Room 1",
+	b"beamermodel=canon",
+	b"beamerbaudrate=19200",
+	b"mqtt_port=1883",
+	b"led_brightness=255",
+	b"syslog_port=514",
+]
+
+# First byte of the batch target: 4 queries starting with POWER
+BATCH_ALL = b"\x03"
+
+
+def write(target, data):
+	directory = os.path.join(HERE, "corpus", target)
+	os.makedirs(directory, exist_ok=True)
+	with open(os.path.join(directory, hashlib.sha1(data).hexdigest()), "wb") as f:
+		f.write(data)
+
+
+def responses(path):
+	# Responses of a transcript, the chunks after each request joined
+	model, entries = projectorsim.read_transcript(path)
+	response = b""
+	for _, direction, _, data in entries:
+		if direction == ">":
+			if response:
+				yield model, response
+			response = b""
+		elif direction == "<":
+			response += data
+	if response:
+		yield model, response
+
+
+def main():
+	count = 0
+	for path in sorted(glob.glob(os.path.join(DOCS, "transcripts", "*.txt"))):
+		for model, response in responses(path):
+			write(model, response)
+			if model == "benq":
+				write("benq_batch", BATCH_ALL + response)
+			count += 1
+	for command in COMMANDS:
+		write("command", command)
+	for setting in SETTINGS:
+		write("config", setting)
+	print("%d responses, %d commands, %d settings" % (count, len(COMMANDS), len(SETTINGS)))
+
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,52 @@
+// Runs inputs through LLVMFuzzerTestOneInput() without libFuzzer, e.g.
+// with g++: every file named on the command line and every file in a
+// named directory. Used to replay the corpus and the regression inputs.
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static bool runFile(const std::string &path)
+{
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file)
+  {
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buffer[4096];
+  for (size_t n = fread(buffer, 1, sizeof(buffer), file); n > 0; n = fread(buffer, 1, sizeof(buffer), file))
+  {
+    data.insert(data.end(), buffer, buffer + n);
+  }
+  fclose(file);
+  LLVMFuzzerTestOneInput(data.data(), data.size());
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned int inputs = 0;
+  for (int i = 1; i < argc; i++)
+  {
+    DIR *dir = opendir(argv[i]);
+    if (!dir)
+    {
+      inputs += runFile(argv[i]);
+      continue;
+    }
+    for (struct dirent *entry = readdir(dir); entry; entry = readdir(dir))
+    {
+      if (entry->d_name[0] != '.')
+      {
+        inputs += runFile(std::string(argv[i]) + "/" + entry->d_name);
+      }
+    }
+    closedir(dir);
+  }
+  printf("%s: %u inputs\n", argv[0], inputs);
+  return 0;
+}
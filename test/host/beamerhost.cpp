@@ -0,0 +1,143 @@
+// Host build of the projector handling (src/device.cpp) on a serial port or
+// pseudo terminal, driven by test_projectorsim.py and soak.py --host
+// against projectorsim.py.
+//
+//   beamerhost <port> <benq|canon> <baud, 0 probes> [seconds]
+//
+// Commands on stdin, one per line: "power on", "power off", "blank on",
+// "blank off", "mute on", "mute off", "stats" or "quit". Every poll prints
+//
+//   poll <ms> <state> <result> <baud> <command status>
+//
+// every command "command <ms> <command> <status>" and "stats"
+//
+//   stats <ms> <polls> <failed polls> <allocations> <max. poll lateness in ms>
+#include <sys/select.h>
+#include <unistd.h>
+#include "device.h"
+#include "transport.h"
+#include "clock.h"
+#include "alloccount.h"
+
+static uint32_t maxLateness = 0; // since the last stats line
+
+static void printPoll()
+{
+  const deviceStats_t &stats = deviceGetStats();
+  State state = deviceState();
+  printf("poll %lu %s %s %lu %s\n", (unsigned long)clockMillis(),
+         state == State::ON ? "on" : state == State::OFF ? "off"
+                                                         : "unknown",
+         projectorPollResultName(stats.lastResult), (unsigned long)transportBaudRate(),
+         deviceCommandStatusName(devicePowerCommand().status));
+  fflush(stdout);
+}
+
+static void printStats()
+{
+  const deviceStats_t &stats = deviceGetStats();
+  printf("stats %lu %lu %lu %lu %lu\n", (unsigned long)clockMillis(), (unsigned long)stats.polls,
+         (unsigned long)(stats.pollTimeouts + stats.pollChecksumErrors + stats.pollParseErrors),
+         (unsigned long)allocCount(), (unsigned long)maxLateness);
+  fflush(stdout);
+  maxLateness = 0;
+}
+
+// Returns false on "quit" or the end of stdin
+static bool command(const char *line)
+{
+  char name[16];
+  char value[16];
+  if (sscanf(line, "%15s %15s", name, value) < 1 || strcmp(name, "quit") == 0)
+  {
+    return false;
+  }
+  bool on = strcmp(value, "on") == 0;
+  if (strcmp(name, "power") == 0)
+  {
+    deviceSetPower(on ? State::ON : State::OFF);
+    printf("command %lu power %s\n", (unsigned long)clockMillis(), deviceCommandStatusName(devicePowerCommand().status));
+  }
+  else if (strcmp(name, "stats") == 0)
+  {
+    printStats();
+    return true;
+  }
+  else if (strcmp(name, "blank") == 0 || strcmp(name, "mute") == 0)
+  {
+    AVControl control = name[0] == 'b' ? AVControl::BLANK : AVControl::MUTE;
+    deviceQueueAV(control, on);
+    deviceSendAV();
+    printf("command %lu %s %s\n", (unsigned long)clockMillis(), name, deviceCommandStatusName(deviceAVCommand(control).status));
+  }
+  else
+  {
+    printf("error unknown command %s\n", name);
+  }
+  fflush(stdout);
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 4)
+  {
+    fprintf(stderr, "usage: %s <port> <benq|canon> <baud> [seconds]\n", argv[0]);
+    return 2;
+  }
+  BeamerModel model = projectorModel(argv[2]);
+  if (model != BeamerModel::BENQ && model != BeamerModel::CANON)
+  {
+    fprintf(stderr, "unknown model %s\n", argv[2]);
+    return 2;
+  }
+  uint32_t duration = argc > 4 ? strtoul(argv[4], nullptr, 10) * 1000 : 0;
+
+  transportTtySetDevice(argv[1]);
+  deviceBegin(model, strtoul(argv[3], nullptr, 10));
+  uint32_t start = clockMillis();
+  uint32_t nextPoll = start;
+  char line[64];
+  size_t length = 0;
+  bool running = true;
+  while (running && (!duration || clockMillis() - start < duration))
+  {
+    int32_t wait = nextPoll - clockMillis();
+    if (wait <= 0)
+    {
+      if ((uint32_t)-wait > maxLateness)
+      {
+        maxLateness = -wait;
+      }
+      devicePoll();
+      printPoll();
+      nextPoll = clockMillis() + devicePollInterval();
+      continue;
+    }
+
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(STDIN_FILENO, &fds);
+    struct timeval timeout = {wait / 1000, (wait % 1000) * 1000};
+    if (select(STDIN_FILENO + 1, &fds, nullptr, nullptr, &timeout) <= 0)
+    {
+      continue;
+    }
+    char c;
+    if (read(STDIN_FILENO, &c, 1) != 1)
+    {
+      running = false;
+    }
+    else if (c == '\n')
+    {
+      line[length] = 0;
+      length = 0;
+      running = command(line);
+    }
+    else if (length < sizeof(line) - 1)
+    {
+      line[length++] = c;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,147 @@
+# Runs the host build of the projector handling (beamerhost.cpp, built with
+# make) against projectorsim.py on a pseudo terminal: polling, power cycle
+# with warm-up and cool-down, baud rate probing and a disturbed link.
+#
+#   pytest test/host
+#
+# Linux/macOS, needs g++, make and pytest.
+
+import os
+import queue
+import re
+import subprocess
+import sys
+import threading
+import time
+
+import pytest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SIMULATOR = os.path.join(HERE, "..", "..", "_docs", "Documentation", "projectorsim.py")
+HOST = os.path.join(HERE, "beamerhost")
+
+
+@pytest.fixture(scope="session", autouse=True)
+def build():
+	subprocess.run(["make", "-C", HERE, "beamerhost"], check=True, stdout=subprocess.DEVNULL)
+
+
+class Lines:
+	# Lines of a pipe, read in the background so waiting can time out
+	def __init__(self, pipe):
+		self.queue = queue.Queue()
+		threading.Thread(target=self.read, args=(pipe,), daemon=True).start()
+
+	def read(self, pipe):
+		for line in pipe:
+			self.queue.put(line.rstrip("\n"))
+
+	def wait(self, pattern, timeout):
+		# Returns the match of the first line matching pattern
+		end = time.monotonic() + timeout
+		while time.monotonic() < end:
+			try:
+				line = self.queue.get(timeout=end - time.monotonic())
+			except queue.Empty:
+				break
+			match = re.match(pattern, line)
+			if match:
+				return match
+		pytest.fail("no line '%s' within %g s" % (pattern, timeout))
+
+
+class Session:
+	def __init__(self, model, sim_args=(), baud=None):
+		self.simulator = subprocess.Popen(
+			[sys.executable, SIMULATOR, "--model", model, "--warmup", "1", "--cooldown", "1", "--seed", "1"] + list(sim_args),
+			stderr=subprocess.PIPE, text=True)
+		match = re.match(r"\S+ projector on (\S+) \((\d+) baud\)", self.simulator.stderr.readline())
+		assert match, "simulator did not start"
+		self.simulator_log = Lines(self.simulator.stderr)
+		self.host = subprocess.Popen(
+			[HOST, match.group(1), model, str(match.group(2) if baud is None else baud)],
+			stdin=subprocess.PIPE, stdout=subprocess.PIPE, text=True)
+		self.lines = Lines(self.host.stdout)
+
+	def send(self, command):
+		self.host.stdin.write(command + "\n")
+		self.host.stdin.flush()
+
+	def poll(self, state, timeout=5):
+		# Waits for a poll reporting the state, returns (result, baud, command status)
+		match = self.lines.wait(r"poll \d+ %s (.+) (\d+) (\w+)$" % state, timeout)
+		return match.group(1), int(match.group(2)), match.group(3)
+
+	def close(self):
+		if self.host.poll() is None:
+			self.send("quit")
+		for process in (self.host, self.simulator):
+			try:
+				process.wait(timeout=2)
+			except subprocess.TimeoutExpired:
+				process.kill()
+				process.wait()
+		self.simulator.terminate()
+		self.simulator.wait()
+
+
+@pytest.fixture
+def session():
+	sessions = []
+
+	def start(*args, **kwargs):
+		sessions.append(Session(*args, **kwargs))
+		return sessions[-1]
+
+	yield start
+	for s in sessions:
+		s.close()
+
+
+@pytest.mark.parametrize("model", ["canon", "benq"])
+def test_poll_reports_off(session, model):
+	s = session(model)
+	assert s.poll("off") == ("ok", 19200, "none")
+
+
+@pytest.mark.parametrize("model", ["canon", "benq"])
+def test_power_cycle(session, model):
+	s = session(model)
+	s.poll("off")
+	s.send("power on")
+	s.lines.wait(r"command \d+ power pending", 2)
+	assert s.poll("on")[2] == "confirmed"
+	s.poll("on")
+	s.send("power off")
+	s.lines.wait(r"command \d+ power pending", 2)
+	# Cooling down is still reported as the requested state
+	assert s.poll("off", timeout=10)[2] == "confirmed"
+
+
+def test_blank_and_mute(session):
+	s = session("benq", ["--state", "on"])
+	s.poll("on")
+	s.send("blank on")
+	s.lines.wait(r"command \d+ blank \w+", 2)
+	s.send("mute on")
+	s.lines.wait(r"command \d+ mute \w+", 2)
+	s.poll("on")
+
+
+def test_baud_rate_is_probed(session):
+	# Only garbage at the default rate until probing finds 57600
+	s = session("canon", ["--baud", "57600"], baud=0)
+	assert s.poll("off", timeout=20)[:2] == ("ok", 57600)
+
+
+def test_wrong_baud_rate_is_unknown(session):
+	s = session("canon", ["--baud", "57600"], baud=19200)
+	result, baud, _ = s.poll("unknown", timeout=20)
+	assert result != "ok" and baud == 19200
+
+
+def test_disturbed_link_recovers(session):
+	s = session("canon", ["--noise", "0.01", "--drop", "0.01"])
+	s.poll("off", timeout=10)
+	s.send("power on")
+	assert s.poll("on", timeout=20)[2] == "confirmed"
@@ -0,0 +1,193 @@
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+static uint64_t elapsedNanos()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+#ifdef CLOCK_VIRTUAL
+
+// The units under test may read millis() and micros() directly, e.g. for
+// the button edges, so they follow the virtual clock (clock.h)
+extern volatile uint32_t clockVirtualMillis;
+
+uint32_t millis()
+{
+  return clockVirtualMillis;
+}
+
+uint32_t micros()
+{
+  return clockVirtualMillis * 1000UL;
+}
+
+void delay(uint32_t ms)
+{
+  clockVirtualMillis += ms;
+}
+
+void delayMicroseconds(uint32_t us)
+{
+}
+
+#else
+
+uint32_t millis()
+{
+  return elapsedNanos() / 1000000;
+}
+
+uint32_t micros()
+{
+  return elapsedNanos() / 1000;
+}
+
+void delay(uint32_t ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+#endif
+
+void yield()
+{
+}
+
+#define PIN_COUNT 17
+
+static uint8_t pinLevels[PIN_COUNT] = {HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH, HIGH};
+static void (*pinHandlers[PIN_COUNT])() = {};
+static int pinModes[PIN_COUNT] = {};
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  if (pin < PIN_COUNT)
+  {
+    pinLevels[pin] = value ? HIGH : LOW;
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  return pin < PIN_COUNT ? pinLevels[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode)
+{
+  if (interrupt < PIN_COUNT)
+  {
+    pinHandlers[interrupt] = handler;
+    pinModes[interrupt] = mode;
+  }
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+  if (interrupt < PIN_COUNT)
+  {
+    pinHandlers[interrupt] = nullptr;
+  }
+}
+
+void hostPinLevel(uint8_t pin, uint8_t level)
+{
+  if (pin >= PIN_COUNT || pinLevels[pin] == level)
+  {
+    return;
+  }
+  pinLevels[pin] = level;
+  int mode = pinModes[pin];
+  if (pinHandlers[pin] && (mode == CHANGE || (mode == RISING && level == HIGH) || (mode == FALLING && level == LOW)))
+  {
+    pinHandlers[pin]();
+  }
+}
+
+void analogWrite(uint8_t pin, int value)
+{
+}
+
+size_t Print::write(const uint8_t *data, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    write(data[i]);
+  }
+  return length;
+}
+
+size_t Print::write(const char *text)
+{
+  return write((const uint8_t *)text, strlen(text));
+}
+
+size_t Print::print(const char *text)
+{
+  return write(text);
+}
+
+size_t Print::println(const char *text)
+{
+  return write(text) + write("\r\n");
+}
+
+size_t Print::printf(const char *format, ...)
+{
+  char line[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  return length > 0 ? write((const uint8_t *)line, min((size_t)length, sizeof(line) - 1)) : 0;
+}
+
+size_t HardwareSerial::write(uint8_t b)
+{
+  return fputc(b, stdout) == EOF ? 0 : 1;
+}
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+
+// The cycle counter of an 80 MHz ESP, wraps like the real one
+uint32_t EspClass::getCycleCount()
+{
+  return (uint32_t)(elapsedNanos() * getCpuFreqMHz() / 1000);
+}
+
+static uint32_t rtcMemory[128]; // 512 bytes user RTC memory
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size)
+{
+  if (offset * 4 + size > sizeof(rtcMemory))
+  {
+    return false;
+  }
+  memcpy(data, (uint8_t *)rtcMemory + offset * 4, size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size)
+{
+  if (offset * 4 + size > sizeof(rtcMemory))
+  {
+    return false;
+  }
+  memcpy((uint8_t *)rtcMemory + offset * 4, data, size);
+  return true;
+}
+
+EspClass ESP;
@@ -0,0 +1,60 @@
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <Arduino.h>
+
+// Host replacement of the ESP8266 EEPROM emulation, kept in RAM. commit()
+// counts the writes a flash sector would take.
+
+#define EEPROM_SHIM_SIZE 4096
+
+class EEPROMClass
+{
+public:
+  void begin(size_t size) { this->size = min(size, (size_t)EEPROM_SHIM_SIZE); }
+  bool commit()
+  {
+    commits++;
+    return size > 0;
+  }
+  bool end() { return commit(); }
+  size_t length() { return size; }
+  uint8_t read(int address) { return (size_t)address < size ? data[address] : 0; }
+  void write(int address, uint8_t value)
+  {
+    if ((size_t)address < size)
+    {
+      data[address] = value;
+    }
+  }
+
+  template <typename T>
+  T &get(int address, T &t)
+  {
+    if (address >= 0 && address + sizeof(T) <= size)
+    {
+      memcpy((uint8_t *)&t, data + address, sizeof(T));
+    }
+    return t;
+  }
+
+  template <typename T>
+  const T &put(int address, const T &t)
+  {
+    if (address >= 0 && address + sizeof(T) <= size)
+    {
+      memcpy(data + address, (const uint8_t *)&t, sizeof(T));
+    }
+    return t;
+  }
+
+  uint32_t commits = 0;
+
+private:
+  uint8_t data[EEPROM_SHIM_SIZE] = {0};
+  size_t size = 0;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef ESP8266WiFi_h
+#define ESP8266WiFi_h
+
+#include <Arduino.h>
+
+// Host replacement of the WiFi station. There is no network: the test sets
+// the link state and whether name lookups succeed.
+
+class IPAddress
+{
+public:
+  IPAddress(uint32_t address = 0) : address(address) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+  operator uint32_t() const { return address; }
+
+private:
+  uint32_t address;
+};
+
+typedef enum
+{
+  WL_IDLE_STATUS = 0,
+  WL_CONNECTED = 3,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+class ESP8266WiFiClass
+{
+public:
+  wl_status_t status() { return connected ? WL_CONNECTED : WL_DISCONNECTED; }
+  // Every name resolves to 'address' unless lookups are failing
+  int hostByName(const char *host, IPAddress &result)
+  {
+    lookups++;
+    result = address;
+    return resolving ? 1 : 0;
+  }
+
+  bool connected = true;
+  bool resolving = true;
+  IPAddress address = IPAddress(192, 168, 1, 2);
+  uint32_t lookups = 0;
+};
+
+inline ESP8266WiFiClass WiFi;
+
+#endif
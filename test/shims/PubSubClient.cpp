@@ -0,0 +1,35 @@
+#include "PubSubClient.h"
+
+bool PubSubClient::connect(const char *id, const char *user, const char *pass, const char *willTopic, uint8_t willQos, bool willRetain, const char *willMessage)
+{
+  return client.connect("broker", 1883);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained)
+{
+  // Like the library: the message must fit the buffer with its header
+  if (!connected() || length + strlen(topic) + 7 > bufferSize)
+  {
+    return false;
+  }
+  publishes++;
+  snprintf(lastTopic, sizeof(lastTopic), "%s", topic);
+  length = min(length, (unsigned int)MQTT_SHIM_MESSAGE_SIZE);
+  memcpy(lastPayload, payload, length);
+  lastPayload[length] = 0;
+  lastRetained = retained;
+  return true;
+}
+
+void PubSubClient::deliver(const char *topic, const char *payload)
+{
+  static char topicCopy[128];
+  static uint8_t payloadCopy[MQTT_SHIM_MESSAGE_SIZE];
+  if (callback)
+  {
+    snprintf(topicCopy, sizeof(topicCopy), "%s", topic);
+    size_t length = min(strlen(payload), sizeof(payloadCopy));
+    memcpy(payloadCopy, payload, length);
+    callback(topicCopy, payloadCopy, length);
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef PubSubClient_h
+#define PubSubClient_h
+
+#include <Arduino.h>
+#include <functional>
+#include "WiFiClient.h"
+
+// Host replacement of PubSubClient. Publishes are recorded (count and the
+// last message), deliver() passes a message to the callback like a
+// subscribed topic would.
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char *, uint8_t *, unsigned int)> callback
+#define MQTT_SHIM_MESSAGE_SIZE 1024
+
+class PubSubClient
+{
+public:
+  PubSubClient(Client &client) : client(client) {}
+  PubSubClient &setServer(const char *domain, uint16_t port) { return *this; }
+  PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE)
+  {
+    this->callback = callback;
+    return *this;
+  }
+  bool setBufferSize(uint16_t size)
+  {
+    bufferSize = size;
+    return true;
+  }
+  uint16_t getBufferSize() { return bufferSize; }
+
+  bool connect(const char *id, const char *user, const char *pass, const char *willTopic, uint8_t willQos, bool willRetain, const char *willMessage);
+  bool connected() { return client.connected(); }
+  void disconnect() { client.stop(); }
+  bool loop() { return connected(); }
+  int state() { return connected() ? 0 : -1; }
+  bool subscribe(const char *topic) { return connected(); }
+
+  bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained);
+  bool publish(const char *topic, const char *payload) { return publish(topic, (const uint8_t *)payload, strlen(payload), false); }
+  bool publish(const char *topic, const char *payload, bool retained) { return publish(topic, (const uint8_t *)payload, strlen(payload), retained); }
+
+  // Test side
+  void deliver(const char *topic, const char *payload);
+  uint32_t publishes = 0;
+  char lastTopic[128] = {0};
+  char lastPayload[MQTT_SHIM_MESSAGE_SIZE + 1] = {0};
+  bool lastRetained = false;
+
+private:
+  Client &client;
+  MQTT_CALLBACK_SIGNATURE;
+  uint16_t bufferSize = 256;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "SoftwareSerial.h"
+
+bool SoftwareSerial::overflow()
+{
+  bool result = overflowed;
+  overflowed = false;
+  return result;
+}
+
+size_t SoftwareSerial::write(uint8_t b)
+{
+  tx[txHead++ % SOFTWARESERIAL_BUFFER_SIZE] = b;
+  if (txHead - txTail > SOFTWARESERIAL_BUFFER_SIZE)
+  {
+    txTail++; // oldest byte lost
+  }
+  return 1;
+}
+
+int SoftwareSerial::available()
+{
+  return rxHead - rxTail;
+}
+
+int SoftwareSerial::read()
+{
+  return rxTail != rxHead ? rx[rxTail++ % SOFTWARESERIAL_BUFFER_SIZE] : -1;
+}
+
+int SoftwareSerial::peek()
+{
+  return rxTail != rxHead ? rx[rxTail % SOFTWARESERIAL_BUFFER_SIZE] : -1;
+}
+
+void SoftwareSerial::receive(const uint8_t *data, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    if (rxHead - rxTail >= SOFTWARESERIAL_BUFFER_SIZE)
+    {
+      overflowed = true;
+      return;
+    }
+    rx[rxHead++ % SOFTWARESERIAL_BUFFER_SIZE] = data[i];
+  }
+}
+
+size_t SoftwareSerial::sent(uint8_t *data, size_t size)
+{
+  size_t n = 0;
+  while (n < size && txTail != txHead)
+  {
+    data[n++] = tx[txTail++ % SOFTWARESERIAL_BUFFER_SIZE];
+  }
+  return n;
+}
@@ -0,0 +1,39 @@
+#ifndef SoftwareSerial_h
+#define SoftwareSerial_h
+
+#include <Arduino.h>
+
+// Host replacement of the ESP8266 SoftwareSerial with an RX and a TX
+// buffer. Tests feed the received bytes with receive() and take the sent
+// ones with sent().
+
+#define SOFTWARESERIAL_BUFFER_SIZE 256
+
+class SoftwareSerial : public Stream
+{
+public:
+  SoftwareSerial(int8_t rxPin, int8_t txPin) {}
+  void begin(uint32_t baud) { baudRate = baud; }
+  uint32_t baud() { return baudRate; }
+  bool overflow();
+
+  size_t write(uint8_t b) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+
+  // Test side
+  void receive(const uint8_t *data, size_t length);
+  size_t sent(uint8_t *data, size_t size);
+
+private:
+  uint32_t baudRate = 0;
+  uint8_t rx[SOFTWARESERIAL_BUFFER_SIZE];
+  uint32_t rxHead = 0, rxTail = 0;
+  uint8_t tx[SOFTWARESERIAL_BUFFER_SIZE];
+  uint32_t txHead = 0, txTail = 0;
+  bool overflowed = false;
+};
+
+#endif
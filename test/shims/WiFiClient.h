@@ -0,0 +1,37 @@
+#ifndef WiFiClient_h
+#define WiFiClient_h
+
+#include <Arduino.h>
+
+// Host replacement of the network client. There is no network: connect()
+// succeeds, written bytes are dropped and nothing is received.
+
+class Client : public Stream
+{
+public:
+  virtual int connect(const char *host, uint16_t port) = 0;
+  virtual uint8_t connected() = 0;
+  virtual void stop() = 0;
+};
+
+class WiFiClient : public Client
+{
+public:
+  int connect(const char *host, uint16_t port) override
+  {
+    open = true;
+    return 1;
+  }
+  uint8_t connected() override { return open; }
+  void stop() override { open = false; }
+  size_t write(uint8_t b) override { return open ? 1 : 0; }
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+
+private:
+  bool open = false;
+};
+
+#endif
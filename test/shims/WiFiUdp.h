@@ -0,0 +1,56 @@
+#ifndef WiFiUdp_h
+#define WiFiUdp_h
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+// Host replacement of the UDP socket. Sent packets are handed to the
+// handler set with hostUdpOnPacket(), nothing is received.
+
+typedef void (*hostUdpHandler_t)(IPAddress ip, uint16_t port, const char *data, size_t length);
+
+inline hostUdpHandler_t hostUdpHandler = nullptr;
+
+inline void hostUdpOnPacket(hostUdpHandler_t handler)
+{
+  hostUdpHandler = handler;
+}
+
+class WiFiUDP : public Print
+{
+public:
+  int beginPacket(IPAddress ip, uint16_t port)
+  {
+    this->ip = ip;
+    this->port = port;
+    length = 0;
+    return 1;
+  }
+  size_t write(uint8_t b) override
+  {
+    if (length >= sizeof(packet) - 1)
+    {
+      return 0;
+    }
+    packet[length++] = b;
+    return 1;
+  }
+  using Print::write;
+  int endPacket()
+  {
+    packet[length] = 0;
+    if (hostUdpHandler)
+    {
+      hostUdpHandler(ip, port, packet, length);
+    }
+    return 1;
+  }
+
+private:
+  IPAddress ip;
+  uint16_t port = 0;
+  char packet[512];
+  size_t length = 0;
+};
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef CONT_H_
+#define CONT_H_
+
+// Size of the loop stack of the ESP8266 core, see EspClass::getFreeContStack()
+#define CONT_STACKSIZE 4096
+
+#endif
@@ -0,0 +1,274 @@
+// The periodic paths must not touch the heap once running: poll, commands,
+// status message and a scheduler pass with the loop tasks. malloc() is
+// wrapped by the linker (build_flags) and counted by src/alloccount.cpp,
+// 'new' is routed through malloc() below so it is counted as well.
+#include <unity.h>
+#include <new>
+#include <ArduinoJson.h>
+#include "alloccount.h"
+#include "scheduler.h"
+#include "device.h"
+#include "status.h"
+#include "button.h"
+#include "leds.h"
+#include "capture.h"
+#include "transport.h"
+#include "clock.h"
+
+void *operator new(size_t size)
+{
+  void *ptr = malloc(size);
+  if (!ptr)
+  {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void *ptr, size_t size) noexcept
+{
+  free(ptr);
+}
+
+// Fake projector, Canon status and ACK or BenQ lines
+static uint8_t processing = 0x00;
+static bool answering = true;
+
+static uint8_t sum(const uint8_t *data, size_t length)
+{
+  uint8_t checksum = 0;
+  for (size_t n = 0; n < length; n++)
+  {
+    checksum += data[n];
+  }
+  return checksum;
+}
+
+static void canonAnswer(const uint8_t *data, size_t length)
+{
+  if (!answering)
+  {
+    return;
+  }
+  if (length == 7 && data[0] == 0x00 && data[1] == 0xbf)
+  {
+    uint8_t status[22] = {0x20, 0xbf, 0x01, 0x40, 0x10, 0x02, processing, 0x01, 0x01, 0xff, 0xff};
+    status[21] = sum(status, 21);
+    transportFakeReceive(status, sizeof(status));
+  }
+  else if (length == 6 && data[0] == 0x02)
+  {
+    uint8_t ack[6] = {0x22, data[1], 0x01, 0x40, 0x00};
+    ack[5] = sum(ack, 5);
+    transportFakeReceive(ack, sizeof(ack));
+    if (data[1] <= 0x01)
+    {
+      processing = data[1] == 0x00 ? 0x04 : 0x00;
+    }
+  }
+}
+
+static void benqAnswer(const uint8_t *data, size_t length)
+{
+  static const char REPLY[] = "\r\n*POW=ON#\r\n\r\n*SOUR=HDMI#\r\n\r\n*LTIM=1234#\r\n";
+  if (answering && length > 6 && memcmp(data, "\r*pow=", 6) == 0)
+  {
+    transportFakeReceive((const uint8_t *)REPLY, sizeof(REPLY) - 1);
+  }
+}
+
+static void poll()
+{
+  devicePoll();
+  clockAdvance(devicePollInterval());
+}
+
+// Loop tasks like in main.cpp, without the network
+static led_t led = LED(D0, false, false);
+
+static void taskPoll()
+{
+  devicePoll();
+}
+
+static void taskCommands()
+{
+  deviceSendAV();
+}
+
+static void taskButton()
+{
+  uint8_t count;
+  buttonPoll(count);
+}
+
+static void taskLEDs()
+{
+  ledSetPattern(led, deviceState() == State::ON ? LEDPattern::ON : LEDPattern::BLINK);
+  ledUpdate(led);
+}
+
+static void taskStatus()
+{
+  static StaticJsonDocument<1024> doc;
+  static char payload[1024];
+  doc.clear();
+  statusAddDevice(doc);
+  serializeJson(doc, payload, sizeof(payload));
+  deviceClearChanged();
+}
+
+static task_t tasks[] = {
+    SCHEDULER_TASK("avcmd", taskCommands, SCHEDULER_ON_DEMAND, 0),
+    SCHEDULER_TASK("poll", taskPoll, DEVICE_POLL_INTERVAL, 0),
+    SCHEDULER_TASK("button", taskButton, 10, 0),
+    SCHEDULER_TASK("leds", taskLEDs, 20, 0),
+    SCHEDULER_TASK("status", taskStatus, 1000, 0),
+};
+#define TASK_COUNT (sizeof(tasks) / sizeof(*tasks))
+
+void setUp()
+{
+  processing = 0x00;
+  answering = true;
+  transportFakeOnWrite(canonAnswer);
+  deviceBegin(BeamerModel::CANON, 19200);
+}
+
+void tearDown()
+{
+  transportFakeOnWrite(nullptr);
+}
+
+void test_allocations_are_counted()
+{
+  uint32_t allocs = allocCount();
+  void *volatile ptr = malloc(16);
+  free(ptr);
+  int *volatile value = new int(1);
+  delete value;
+  TEST_ASSERT_EQUAL_UINT32(allocs + 2, allocCount());
+}
+
+void test_poll_does_not_allocate()
+{
+  poll();
+  uint32_t allocs = allocCount();
+  for (int n = 0; n < 10; n++)
+  {
+    poll();
+  }
+  // Link lost, probing and recovery
+  answering = false;
+  for (int n = 0; n < DEVICE_LINK_FAIL_THRESHOLD + 2; n++)
+  {
+    poll();
+  }
+  answering = true;
+  poll();
+  TEST_ASSERT_EQUAL(State::OFF, deviceState());
+
+  transportFakeOnWrite(benqAnswer);
+  deviceBegin(BeamerModel::BENQ, 115200);
+  for (int n = 0; n < 10; n++)
+  {
+    poll();
+  }
+  TEST_ASSERT_EQUAL(State::ON, deviceState());
+  TEST_ASSERT_EQUAL_UINT32(allocs, allocCount());
+}
+
+void test_commands_do_not_allocate()
+{
+  poll();
+  uint32_t allocs = allocCount();
+  deviceSetPower(State::ON);
+  poll();
+  deviceQueueAV(AVControl::BLANK, true);
+  deviceQueueAV(AVControl::MUTE, true);
+  deviceSendAV();
+  poll();
+  TEST_ASSERT_EQUAL(CommandStatus::CONFIRMED, devicePowerCommand().status);
+  TEST_ASSERT_EQUAL_UINT32(allocs, allocCount());
+}
+
+void test_status_does_not_allocate()
+{
+  static StaticJsonDocument<1024> doc;
+  static char payload[1024];
+  poll();
+  deviceSetPower(State::ON);
+  deviceQueueAV(AVControl::BLANK, true);
+  deviceSendAV();
+
+  uint32_t allocs = allocCount();
+  doc.clear();
+  statusAddDevice(doc);
+  size_t length = serializeJson(doc, payload, sizeof(payload));
+  TEST_ASSERT_EQUAL_UINT32(allocs, allocCount());
+  TEST_ASSERT_GREATER_THAN_UINT32(0, length);
+  TEST_ASSERT_NOT_NULL(strstr(payload, "\"pwrcommand\":\"pending\""));
+}
+
+void test_loop_does_not_allocate()
+{
+  buttonBegin(D3, 10000);
+  ledBegin(led, 1023);
+  captureStart();
+  for (int n = 0; n < 10; n++)
+  {
+    schedulerRun(tasks, TASK_COUNT, 1000);
+  }
+
+  uint32_t allocs = allocCount();
+  uint32_t start = clockMillis();
+  bool commanded = false;
+  while (clockMillis() - start < 60000)
+  {
+    if (!commanded && clockMillis() - start >= 20000)
+    {
+      commanded = true;
+      deviceSetPower(State::ON);
+      deviceQueueAV(AVControl::BLANK, true);
+      schedulerTrigger(tasks[0]);
+    }
+    schedulerRun(tasks, TASK_COUNT, 1000);
+  }
+  captureStop();
+  TEST_ASSERT_EQUAL_UINT32(allocs, allocCount());
+  for (const task_t &task : tasks)
+  {
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, task.maxAllocs, task.name);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_allocations_are_counted);
+  RUN_TEST(test_poll_does_not_allocate);
+  RUN_TEST(test_commands_do_not_allocate);
+  RUN_TEST(test_status_does_not_allocate);
+  RUN_TEST(test_loop_does_not_allocate);
+  return UNITY_END();
+}
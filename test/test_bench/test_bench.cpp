@@ -0,0 +1,53 @@
+// Host run of the projector benchmark cases (bench.cpp), the same cases
+// /bench times on the device. Prints the results in the JSON format of
+// /bench, with BENCH_OUTPUT set they are written to that file as well.
+#include <unity.h>
+#include <stdlib.h>
+#include "bench.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_projector_cases()
+{
+  const char *path = getenv("BENCH_OUTPUT");
+  FILE *file = path ? fopen(path, "w") : nullptr;
+  if (file)
+  {
+    fprintf(file, "{\"host\":true,\"cpu_mhz\":%u,\"results\":[", ESP.getCpuFreqMHz());
+  }
+  for (size_t i = 0; i < BENCH_PROJECTOR_CASES; i++)
+  {
+    benchmark_t &bench = benchProjectorCases[i];
+    char result[160];
+    benchRun(bench);
+    benchFormat(bench, result, sizeof(result));
+    TEST_MESSAGE(result);
+    if (file)
+    {
+      fprintf(file, "%s%s", i ? "," : "", result);
+    }
+
+    // The parsers run for every received byte and must not allocate
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, bench.allocs, bench.name);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(benchAvgTime(bench), benchMinTime(bench));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(benchMaxTime(bench), benchAvgTime(bench));
+  }
+  if (file)
+  {
+    fprintf(file, "]}\n");
+    fclose(file);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_projector_cases);
+  return UNITY_END();
+}
@@ -0,0 +1,108 @@
+// Defaults, migration and settings form parsing of src/config.cpp
+#include <unity.h>
+#include <EEPROM.h>
+#include "config.h"
+
+static configData_t cfg;
+
+void setUp()
+{
+  configDefaults(cfg);
+}
+
+void tearDown()
+{
+}
+
+void test_defaults()
+{
+  TEST_ASSERT_EQUAL(CONFIG_VERSION, cfg.configversion);
+  TEST_ASSERT_EQUAL_STRING("admin", cfg.admin_username);
+  TEST_ASSERT_EQUAL_STRING("beamercontrol", cfg.mqtt_prefix);
+  TEST_ASSERT_EQUAL_UINT32(0, cfg.beamerbaudrate);
+  TEST_ASSERT_EQUAL(1883, cfg.mqtt_port);
+  TEST_ASSERT_TRUE(configMigrate(cfg));
+}
+
+void test_text_is_trimmed_and_truncated()
+{
+  TEST_ASSERT_TRUE(configApply(cfg, "hostname", "  beamer \t"));
+  TEST_ASSERT_EQUAL_STRING("beamer", cfg.hostname);
+
+  char longName[100];
+  memset(longName, 'x', sizeof(longName) - 1);
+  longName[sizeof(longName) - 1] = 0;
+  TEST_ASSERT_TRUE(configApply(cfg, "hostname", longName));
+  TEST_ASSERT_EQUAL(sizeof(cfg.hostname) - 1, strlen(cfg.hostname));
+}
+
+void test_numbers_must_fit_the_field()
+{
+  TEST_ASSERT_TRUE(configApply(cfg, "mqtt_port", " 8883 "));
+  TEST_ASSERT_EQUAL(8883, cfg.mqtt_port);
+  TEST_ASSERT_FALSE(configApply(cfg, "mqtt_port", "65536"));
+  TEST_ASSERT_FALSE(configApply(cfg, "mqtt_port", "-1"));
+  TEST_ASSERT_FALSE(configApply(cfg, "mqtt_port", "1883x"));
+  TEST_ASSERT_FALSE(configApply(cfg, "mqtt_port", ""));
+  TEST_ASSERT_EQUAL(8883, cfg.mqtt_port);
+
+  TEST_ASSERT_FALSE(configApply(cfg, "led_brightness", "256"));
+  TEST_ASSERT_TRUE(configApply(cfg, "led_brightness", "255"));
+  TEST_ASSERT_EQUAL(255, cfg.led_brightness);
+
+  TEST_ASSERT_TRUE(configApply(cfg, "beamerbaudrate", "4294967295"));
+  TEST_ASSERT_EQUAL_UINT32(4294967295UL, cfg.beamerbaudrate);
+  TEST_ASSERT_FALSE(configApply(cfg, "beamerbaudrate", "4294967296"));
+  TEST_ASSERT_FALSE(configApply(cfg, "beamerbaudrate", "18446744073709551616"));
+  TEST_ASSERT_EQUAL_UINT32(4294967295UL, cfg.beamerbaudrate);
+}
+
+void test_unknown_field()
+{
+  configData_t before = cfg;
+  TEST_ASSERT_FALSE(configApply(cfg, "configversion", "1"));
+  TEST_ASSERT_EQUAL_MEMORY(&before, &cfg, sizeof(cfg));
+}
+
+void test_migrate_version_6()
+{
+  cfg.configversion = 6;
+  memset(cfg.syslog_server, 0xff, sizeof(cfg.syslog_server));
+  cfg.syslog_port = 0xffff;
+  TEST_ASSERT_TRUE(configMigrate(cfg));
+  TEST_ASSERT_EQUAL(CONFIG_VERSION, cfg.configversion);
+  TEST_ASSERT_EQUAL_STRING("", cfg.syslog_server);
+  TEST_ASSERT_EQUAL(514, cfg.syslog_port);
+
+  cfg.configversion = 5;
+  TEST_ASSERT_FALSE(configMigrate(cfg));
+}
+
+void test_eeprom_round_trip()
+{
+  configApply(cfg, "note", "Room 1");
+  configApply(cfg, "syslog_port", "1514");
+  EEPROM.begin(1024);
+  EEPROM.put(0, cfg);
+  TEST_ASSERT_TRUE(EEPROM.commit());
+  EEPROM.end();
+
+  configData_t loaded;
+  EEPROM.begin(1024);
+  EEPROM.get(0, loaded);
+  TEST_ASSERT_TRUE(configMigrate(loaded));
+  TEST_ASSERT_EQUAL_STRING("Room 1", loaded.note);
+  TEST_ASSERT_EQUAL(1514, loaded.syslog_port);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_defaults);
+  RUN_TEST(test_text_is_trimmed_and_truncated);
+  RUN_TEST(test_numbers_must_fit_the_field);
+  RUN_TEST(test_unknown_field);
+  RUN_TEST(test_migrate_version_6);
+  RUN_TEST(test_eeprom_round_trip);
+  return UNITY_END();
+}
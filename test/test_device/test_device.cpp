@@ -0,0 +1,546 @@
+// Poll, hold-last-state and command confirmation of src/device.cpp against
+// a fake projector on the fake transport, on the virtual clock
+#include <unity.h>
+#include <ctype.h>
+#include <ArduinoJson.h>
+#include "device.h"
+#include "status.h"
+#include "transport.h"
+#include "capture.h"
+#include "clock.h"
+
+// Fake projector, answers in the write handler like a real one right after
+// the request
+static uint8_t processing = 0x00; // Canon DATA02: 00H off, 04H on, 06H error standby
+static bool blank = false;
+static bool answering = true;    // answers polls
+static uint32_t answerBaud = 0;  // answers only at this baud rate, 0 for any
+static bool rejecting = false;   // NAKs commands
+static bool switching = true;    // executes power commands
+static uint32_t powerCommands = 0;
+
+static uint8_t sum(const uint8_t *data, size_t length)
+{
+  uint8_t checksum = 0;
+  for (size_t n = 0; n < length; n++)
+  {
+    checksum += data[n];
+  }
+  return checksum;
+}
+
+static void canonAnswer(const uint8_t *data, size_t length)
+{
+  if (answerBaud && transportBaudRate() != answerBaud)
+  {
+    return;
+  }
+  if (length == 7 && data[0] == 0x00 && data[1] == 0xbf)
+  {
+    if (!answering)
+    {
+      return;
+    }
+    uint8_t status[22] = {0x20, 0xbf, 0x01, 0x40, 0x10, 0x02, processing, 0x01, 0x01, 0xff, 0xff, blank};
+    status[21] = sum(status, 21);
+    transportFakeReceive(status, sizeof(status));
+  }
+  else if (length == 6 && data[0] == 0x02)
+  {
+    if (rejecting)
+    {
+      uint8_t nak[8] = {0xa2, data[1], 0x01, 0x40, 0x02, 0x02, 0x0d};
+      nak[7] = sum(nak, 7);
+      transportFakeReceive(nak, sizeof(nak));
+      return;
+    }
+    uint8_t ack[6] = {0x22, data[1], 0x01, 0x40, 0x00};
+    ack[5] = sum(ack, 5);
+    transportFakeReceive(ack, sizeof(ack));
+    if (data[1] <= 0x01)
+    {
+      powerCommands++;
+      if (switching)
+      {
+        processing = data[1] == 0x00 ? 0x04 : 0x00;
+      }
+    }
+    else if (data[1] == 0x10 || data[1] == 0x11)
+    {
+      blank = data[1] == 0x10;
+    }
+  }
+}
+
+static void benqAnswer(const uint8_t *data, size_t length)
+{
+  // "\r*key=?#\r" or "\r*pow=on#\r"
+  char request[32];
+  if (length < 4 || length >= sizeof(request) || data[1] != '*')
+  {
+    return;
+  }
+  memcpy(request, data + 2, length - 2);
+  request[length - 2] = 0;
+  char *value = strchr(request, '=');
+  if (!value)
+  {
+    return;
+  }
+  *value++ = 0;
+  char *end = strchr(value, '#');
+  if (end)
+  {
+    *end = 0;
+  }
+
+  const char *reply = nullptr;
+  if (strcmp(request, "pow") == 0)
+  {
+    if (strcmp(value, "?") != 0)
+    {
+      processing = strcmp(value, "on") == 0 ? 0x04 : 0x00;
+    }
+    reply = processing == 0x04 ? "ON" : "OFF";
+  }
+  else if (strcmp(request, "sour") == 0)
+  {
+    reply = "HDMI";
+  }
+  else if (strcmp(request, "ltim") == 0)
+  {
+    reply = "1234";
+  }
+  else if (strcmp(request, "lampm") == 0)
+  {
+    reply = "ECO";
+  }
+  else
+  {
+    reply = "OFF";
+  }
+
+  char line[48];
+  for (char *c = request; *c; c++)
+  {
+    *c = toupper(*c);
+  }
+  int n = snprintf(line, sizeof(line), "\r\n*%s=%s#\r\n", request, reply);
+  transportFakeReceive((const uint8_t *)line, n);
+}
+
+void setUp()
+{
+  processing = 0x00;
+  blank = false;
+  answering = true;
+  answerBaud = 0;
+  rejecting = false;
+  switching = true;
+  powerCommands = 0;
+  transportFakeOnWrite(canonAnswer);
+  deviceBegin(BeamerModel::CANON, 19200);
+  clockAdvance(1000);
+}
+
+void tearDown()
+{
+  transportFakeOnWrite(nullptr);
+}
+
+static void poll()
+{
+  devicePoll();
+  clockAdvance(devicePollInterval());
+}
+
+void test_poll_reports_state()
+{
+  TEST_ASSERT_TRUE(devicePoll());
+  TEST_ASSERT_EQUAL(State::OFF, deviceState());
+  TEST_ASSERT_TRUE(deviceChanged() & (1UL << (uint8_t)Attribute::POWER));
+  TEST_ASSERT_EQUAL(PollResult::OK, deviceGetStats().lastResult);
+
+  deviceClearChanged();
+  TEST_ASSERT_FALSE(devicePoll());
+  processing = 0x04;
+  TEST_ASSERT_TRUE(devicePoll());
+  TEST_ASSERT_EQUAL(State::ON, deviceState());
+
+  int32_t lamp;
+  TEST_ASSERT_TRUE(cacheGet(Attribute::LAMP, lamp));
+  TEST_ASSERT_EQUAL(0x04, lamp);
+}
+
+void test_hold_last_state_until_probed()
+{
+  poll();
+  uint32_t confirmed = cacheEntry(Attribute::POWER).updated;
+  answering = false;
+
+  // The state is kept through DEVICE_LINK_FAIL_THRESHOLD - 1 missing answers
+  // and the probing of the fixed baud rate, aging from the last answer
+  for (int n = 0; n < DEVICE_LINK_FAIL_THRESHOLD; n++)
+  {
+    poll();
+    TEST_ASSERT_EQUAL(State::OFF, deviceState());
+    TEST_ASSERT_EQUAL_UINT32(confirmed, cacheEntry(Attribute::POWER).updated);
+  }
+  TEST_ASSERT_TRUE(deviceLink().probing);
+  TEST_ASSERT_EQUAL(PollResult::TIMEOUT, deviceGetStats().lastResult);
+
+  int32_t power;
+  TEST_ASSERT_FALSE(cacheGet(Attribute::POWER, power, DEVICE_POLL_INTERVAL));
+
+  poll();
+  TEST_ASSERT_EQUAL(State::UNKNOWN, deviceState());
+
+  answering = true;
+  uint32_t recoveries = deviceLink().recoveries;
+  poll();
+  TEST_ASSERT_EQUAL(State::OFF, deviceState());
+  TEST_ASSERT_FALSE(deviceLink().probing);
+  TEST_ASSERT_EQUAL_UINT32(recoveries + 1, deviceLink().recoveries);
+}
+
+void test_single_garbage_keeps_state()
+{
+  processing = 0x04;
+  poll();
+  answering = false;
+  poll();
+  answering = true;
+  poll();
+  TEST_ASSERT_EQUAL(State::ON, deviceState());
+  TEST_ASSERT_EQUAL(0, deviceLink().failStreak);
+  TEST_ASSERT_FALSE(deviceLink().probing);
+}
+
+void test_unknown_status_is_reported_at_once()
+{
+  poll();
+  processing = 0x07;
+  poll();
+  TEST_ASSERT_EQUAL(State::UNKNOWN, deviceState());
+}
+
+void test_probe_finds_baud_rate()
+{
+  answerBaud = 57600;
+  deviceBegin(BeamerModel::CANON, 0);
+  TEST_ASSERT_TRUE(deviceLink().probing);
+
+  for (int n = 0; n < 10 && deviceLink().probing; n++)
+  {
+    poll();
+  }
+  TEST_ASSERT_FALSE(deviceLink().probing);
+  TEST_ASSERT_EQUAL_UINT32(57600, transportBaudRate());
+  TEST_ASSERT_EQUAL(State::OFF, deviceState());
+}
+
+void test_power_on_is_optimistic_until_confirmed()
+{
+  poll();
+  switching = false;
+  deviceSetPower(State::ON);
+  TEST_ASSERT_EQUAL(State::ON, deviceState());
+  TEST_ASSERT_EQUAL(CommandStatus::PENDING, devicePowerCommand().status);
+  TEST_ASSERT_EQUAL_UINT32(DEVICE_CONFIRM_POLL_INTERVAL, devicePollInterval());
+
+  // Warm-up: the projector still reports off
+  poll();
+  TEST_ASSERT_EQUAL(State::ON, deviceState());
+  TEST_ASSERT_EQUAL(CommandStatus::PENDING, devicePowerCommand().status);
+
+  uint32_t confirmed = devicePowerCommand().confirmed;
+  processing = 0x04;
+  poll();
+  TEST_ASSERT_EQUAL(CommandStatus::CONFIRMED, devicePowerCommand().status);
+  TEST_ASSERT_EQUAL_UINT32(confirmed + 1, devicePowerCommand().confirmed);
+  TEST_ASSERT_EQUAL(State::ON, deviceState());
+  TEST_ASSERT_EQUAL_UINT32(DEVICE_POLL_INTERVAL, devicePollInterval());
+}
+
+void test_power_command_times_out()
+{
+  poll();
+  switching = false;
+  deviceSetPower(State::ON);
+  uint32_t failed = devicePowerCommand().failed;
+
+  clockAdvance(DEVICE_POWER_CONFIRM_TIMEOUT - 1000);
+  poll();
+  TEST_ASSERT_EQUAL(CommandStatus::PENDING, devicePowerCommand().status);
+
+  clockAdvance(1000);
+  poll();
+  TEST_ASSERT_EQUAL(CommandStatus::FAILED, devicePowerCommand().status);
+  TEST_ASSERT_EQUAL_UINT32(failed + 1, devicePowerCommand().failed);
+  TEST_ASSERT_EQUAL(State::OFF, deviceState());
+}
+
+void test_power_command_reply_does_not_reach_poll()
+{
+  poll();
+  deviceSetPower(State::ON);
+  uint32_t parseErrors = deviceGetStats().pollParseErrors + deviceGetStats().pollChecksumErrors;
+  poll();
+  TEST_ASSERT_EQUAL(PollResult::OK, deviceGetStats().lastResult);
+  TEST_ASSERT_EQUAL_UINT32(parseErrors, deviceGetStats().pollParseErrors + deviceGetStats().pollChecksumErrors);
+  TEST_ASSERT_EQUAL(CommandStatus::CONFIRMED, devicePowerCommand().status);
+}
+
+void test_av_command_confirmed_by_poll()
+{
+  poll();
+  deviceQueueAV(AVControl::BLANK, true);
+  TEST_ASSERT_TRUE(deviceAVQueued());
+  TEST_ASSERT_TRUE(deviceSendAV());
+  TEST_ASSERT_FALSE(deviceAVQueued());
+  TEST_ASSERT_EQUAL(CommandStatus::PENDING, deviceAVCommand(AVControl::BLANK).status);
+
+  poll();
+  TEST_ASSERT_EQUAL(CommandStatus::CONFIRMED, deviceAVCommand(AVControl::BLANK).status);
+  TEST_ASSERT_TRUE(deviceChanged() & (1UL << (uint8_t)Attribute::BLANK));
+}
+
+void test_av_command_rejected()
+{
+  poll();
+  rejecting = true;
+  uint32_t failed = deviceGetStats().avFailed;
+  deviceQueueAV(AVControl::MUTE, true);
+  deviceSendAV();
+  TEST_ASSERT_EQUAL(CommandStatus::FAILED, deviceAVCommand(AVControl::MUTE).status);
+  TEST_ASSERT_EQUAL_UINT32(failed + 1, deviceGetStats().avFailed);
+}
+
+void test_power_command_rejected()
+{
+  poll();
+  rejecting = true;
+  uint32_t failed = devicePowerCommand().failed;
+  deviceSetPower(State::ON);
+  TEST_ASSERT_EQUAL(CommandStatus::FAILED, devicePowerCommand().status);
+  TEST_ASSERT_EQUAL_UINT32(failed + 1, devicePowerCommand().failed);
+  TEST_ASSERT_EQUAL(State::OFF, deviceState());
+}
+
+void test_capture_timestamps()
+{
+  static const uint8_t FRAME[] = {0x00, 0xbf, 0x01, 0x00, 0x01, 0x02, 0xc3};
+  static const uint8_t REPLY[] = {0x20, 0xbf};
+  transportFakeOnWrite(nullptr);
+  captureStart();
+
+  // Sent bytes follow each other at the byte time of the baud rate
+  uint32_t start = micros();
+  transportWrite(FRAME, sizeof(FRAME));
+
+  // Received bytes are stamped when drained, not when the parser reads them
+  transportFakeReceive(REPLY, sizeof(REPLY));
+  clockAdvance(3);
+  uint32_t arrived = micros();
+  TEST_ASSERT_EQUAL(sizeof(REPLY), transportAvailable());
+  clockAdvance(10);
+  TEST_ASSERT_EQUAL(REPLY[0], transportRead());
+  TEST_ASSERT_EQUAL(REPLY[1], transportRead());
+  TEST_ASSERT_EQUAL(0, transportAvailable());
+  captureStop();
+
+  TEST_ASSERT_EQUAL(sizeof(FRAME) + sizeof(REPLY), captureCount());
+  TEST_ASSERT_EQUAL_UINT32(520, transportByteTime());
+  for (size_t i = 0; i < sizeof(FRAME); i++)
+  {
+    TEST_ASSERT_TRUE(captureEntry(i).sent);
+    TEST_ASSERT_EQUAL_UINT32(start + i * transportByteTime(), captureEntry(i).time);
+  }
+  for (size_t i = sizeof(FRAME); i < captureCount(); i++)
+  {
+    TEST_ASSERT_FALSE(captureEntry(i).sent);
+    TEST_ASSERT_EQUAL_UINT32(arrived, captureEntry(i).time);
+  }
+}
+
+void test_capture_baud_rates()
+{
+  static const uint8_t BYTE = 0x55;
+  transportFakeOnWrite(nullptr);
+  captureStart();
+
+  // Every byte keeps the rate it was sent at
+  transportWrite(&BYTE, 1);
+  transportSetBaudRate(57600);
+  transportSetBaudRate(9600);
+  transportWrite(&BYTE, 1);
+  TEST_ASSERT_EQUAL_UINT32(2, captureCount());
+  TEST_ASSERT_EQUAL_UINT32(19200, captureEntry(0).baud);
+  TEST_ASSERT_EQUAL_UINT32(9600, captureEntry(1).baud);
+
+  // Bytes older than the kept rate changes are dropped, not mislabeled
+  for (uint32_t n = 0; n < CAPTURE_RATE_CHANGES; n++)
+  {
+    transportSetBaudRate(n % 2 ? 19200 : 115200);
+    transportWrite(&BYTE, 1);
+  }
+  captureStop();
+  TEST_ASSERT_EQUAL_UINT32(CAPTURE_RATE_CHANGES, captureCount());
+  TEST_ASSERT_EQUAL_UINT32(2, captureOverwritten());
+  for (size_t i = 0; i < captureCount(); i++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(i % 2 ? 19200 : 115200, captureEntry(i).baud);
+  }
+}
+
+void test_benq_poll_with_attributes()
+{
+  transportFakeOnWrite(benqAnswer);
+  deviceBegin(BeamerModel::BENQ, 115200);
+  processing = 0x04;
+
+  // The low priority queries are asked in turn behind the power query
+  for (int n = 0; n < 3; n++)
+  {
+    poll();
+  }
+  TEST_ASSERT_EQUAL(State::ON, deviceState());
+  int32_t hours;
+  TEST_ASSERT_TRUE(cacheGet(Attribute::LAMP_HOURS, hours));
+  TEST_ASSERT_EQUAL(1234, hours);
+
+  deviceSetPower(State::OFF);
+  poll();
+  TEST_ASSERT_EQUAL(CommandStatus::CONFIRMED, devicePowerCommand().status);
+  TEST_ASSERT_EQUAL(State::OFF, deviceState());
+}
+
+// The status leaves stale attributes out, building it never polls
+void test_status_skips_stale_attributes()
+{
+  static StaticJsonDocument<1024> doc;
+  static char payload[1024];
+  poll();
+  uint32_t polls = deviceGetStats().polls;
+
+  doc.clear();
+  statusAddDevice(doc);
+  serializeJson(doc, payload, sizeof(payload));
+  TEST_ASSERT_NOT_NULL(strstr(payload, "\"lamp\""));
+
+  clockAdvance(500);
+  doc.clear();
+  statusAddDevice(doc, 100);
+  serializeJson(doc, payload, sizeof(payload));
+  TEST_ASSERT_NULL(strstr(payload, "\"lamp\""));
+
+  clockAdvance(cacheEntry(Attribute::LAMP).ttl);
+  doc.clear();
+  statusAddDevice(doc);
+  serializeJson(doc, payload, sizeof(payload));
+  TEST_ASSERT_NULL(strstr(payload, "\"lamp\""));
+  TEST_ASSERT_NOT_NULL(strstr(payload, "\"pwrstate\":\"unknown\""));
+  TEST_ASSERT_EQUAL_UINT32(polls, deviceGetStats().polls);
+}
+
+void test_demo_mode()
+{
+  deviceBegin(BeamerModel::DEMO, 19200);
+  poll();
+  TEST_ASSERT_EQUAL(State::UNKNOWN, deviceState());
+  deviceSetPower(State::ON);
+  poll();
+  TEST_ASSERT_EQUAL(CommandStatus::CONFIRMED, devicePowerCommand().status);
+  TEST_ASSERT_EQUAL(State::ON, deviceState());
+  TEST_ASSERT_EQUAL_UINT32(0, powerCommands);
+}
+
+// Random power commands, warm-up times and link outages. A command is
+// reported until the projector confirms it and fails exactly at the deadline.
+void test_random_command_schedules()
+{
+  uint32_t confirmations = 0, failures = 0;
+  srand(41);
+  for (int schedule = 0; schedule < 50; schedule++)
+  {
+    setUp();
+    switching = false;
+    uint32_t switchAt = 0;   // clockMillis() when the fake projector reaches the target
+    State switchTo = State::UNKNOWN;
+    poll();
+
+    for (int step = 0; step < 400; step++)
+    {
+      int event = rand() % 100;
+      if (event < 1)
+      {
+        switchTo = rand() % 2 ? State::ON : State::OFF;
+        deviceSetPower(switchTo);
+        TEST_ASSERT_EQUAL(switchTo, deviceState());
+        // Some commands are never executed
+        switchAt = rand() % 4 ? clockMillis() + rand() % (DEVICE_POWER_CONFIRM_TIMEOUT + 30000) : UINT32_MAX;
+      }
+      else if (event < 3)
+      {
+        answering = !answering;
+      }
+      else if (event < 6)
+      {
+        clockAdvance(rand() % 60000);
+      }
+      if (switchTo != State::UNKNOWN && switchAt != UINT32_MAX && (int32_t)(clockMillis() - switchAt) >= 0)
+      {
+        processing = switchTo == State::ON ? 0x04 : 0x00;
+      }
+
+      CommandStatus before = devicePowerCommand().status;
+      devicePoll();
+      const powerCommand_t &cmd = devicePowerCommand();
+      uint32_t elapsed = clockMillis() - cmd.start;
+      if (cmd.status == CommandStatus::PENDING)
+      {
+        TEST_ASSERT_LESS_THAN_UINT32(DEVICE_POWER_CONFIRM_TIMEOUT, elapsed);
+        TEST_ASSERT_EQUAL(cmd.target, deviceState());
+      }
+      else if (before == CommandStatus::PENDING && cmd.status == CommandStatus::CONFIRMED)
+      {
+        TEST_ASSERT_EQUAL(cmd.target == State::ON ? 0x04 : 0x00, processing);
+        TEST_ASSERT_EQUAL_UINT32(elapsed, cmd.time);
+        confirmations++;
+      }
+      else if (before == CommandStatus::PENDING && cmd.status == CommandStatus::FAILED)
+      {
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(DEVICE_POWER_CONFIRM_TIMEOUT, elapsed);
+        TEST_ASSERT_NOT_EQUAL(cmd.target, deviceState());
+        failures++;
+      }
+      clockAdvance(devicePollInterval());
+    }
+  }
+  // Both outcomes were covered
+  TEST_ASSERT_GREATER_THAN_UINT32(0, confirmations);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, failures);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_poll_reports_state);
+  RUN_TEST(test_hold_last_state_until_probed);
+  RUN_TEST(test_single_garbage_keeps_state);
+  RUN_TEST(test_unknown_status_is_reported_at_once);
+  RUN_TEST(test_probe_finds_baud_rate);
+  RUN_TEST(test_power_on_is_optimistic_until_confirmed);
+  RUN_TEST(test_power_command_times_out);
+  RUN_TEST(test_power_command_reply_does_not_reach_poll);
+  RUN_TEST(test_av_command_confirmed_by_poll);
+  RUN_TEST(test_av_command_rejected);
+  RUN_TEST(test_power_command_rejected);
+  RUN_TEST(test_capture_timestamps);
+  RUN_TEST(test_capture_baud_rates);
+  RUN_TEST(test_benq_poll_with_attributes);
+  RUN_TEST(test_status_skips_stale_attributes);
+  RUN_TEST(test_demo_mode);
+  RUN_TEST(test_random_command_schedules);
+  return UNITY_END();
+}
@@ -0,0 +1,91 @@
+// Syslog forwarding of src/log.cpp against a fake UDP sink: level and
+// message parsed back from the padded log lines, lookup on connect
+#include <unity.h>
+#include <WiFiUdp.h>
+#include "log.h"
+#include "clock.h"
+
+static char packets[8][LOG_LINE_SIZE + 64];
+static uint8_t packetCount;
+static IPAddress packetIP;
+static uint16_t packetPort;
+
+static void onPacket(IPAddress ip, uint16_t port, const char *data, size_t length)
+{
+  if (packetCount < sizeof(packets) / sizeof(*packets))
+  {
+    snprintf(packets[packetCount++], sizeof(packets[0]), "%s", data);
+  }
+  packetIP = ip;
+  packetPort = port;
+}
+
+void setUp()
+{
+  packetCount = 0;
+  WiFi.connected = true;
+  WiFi.resolving = true;
+  hostUdpOnPacket(onPacket);
+  logSetSyslog("syslog.local", 5514, "beamer");
+}
+
+void tearDown()
+{
+  hostUdpOnPacket(nullptr);
+  logSetSyslog("", 514, "");
+}
+
+void test_levels_and_messages_at_any_uptime()
+{
+  // 1, 4 and 6 digit seconds, the timestamp is padded to six digits
+  clockVirtualMillis = 5000;
+  logPrintf(LOG_LEVEL_WARN, PSTR("warning %d"), 1);
+  clockVirtualMillis = 1234000;
+  logPrintf(LOG_LEVEL_ERROR, PSTR("error %d"), 2);
+  clockVirtualMillis = 123456000;
+  logPrintf(LOG_LEVEL_INFO, PSTR("info %d"), 3);
+  logDrain();
+
+  TEST_ASSERT_EQUAL_UINT8(3, packetCount);
+  TEST_ASSERT_EQUAL_STRING("<132>beamer BeamerControl: warning 1", packets[0]);
+  TEST_ASSERT_EQUAL_STRING("<131>beamer BeamerControl: error 2", packets[1]);
+  TEST_ASSERT_EQUAL_STRING("<134>beamer BeamerControl: info 3", packets[2]);
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)WiFi.address, (uint32_t)packetIP);
+  TEST_ASSERT_EQUAL_UINT16(5514, packetPort);
+}
+
+void test_lookup_only_on_connect()
+{
+  uint32_t lookups = WiFi.lookups;
+  for (int n = 0; n < 10; n++)
+  {
+    logPrintf(LOG_LEVEL_INFO, PSTR("line %d"), n);
+    logDrain();
+  }
+  TEST_ASSERT_EQUAL_UINT32(lookups, WiFi.lookups);
+  TEST_ASSERT_EQUAL_UINT8(8, packetCount);
+
+  // A failed lookup stops forwarding until the next connect
+  WiFi.resolving = false;
+  logSyslogResolve();
+  packetCount = 0;
+  logPrintf(LOG_LEVEL_INFO, PSTR("lost"));
+  logDrain();
+  TEST_ASSERT_EQUAL_UINT8(0, packetCount);
+  TEST_ASSERT_EQUAL_UINT32(lookups + 1, WiFi.lookups);
+
+  WiFi.resolving = true;
+  logSyslogResolve();
+  logPrintf(LOG_LEVEL_INFO, PSTR("back"));
+  logDrain();
+  TEST_ASSERT_EQUAL_UINT8(1, packetCount);
+  TEST_ASSERT_EQUAL_STRING("<134>beamer BeamerControl: back", packets[0]);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_levels_and_messages_at_any_uptime);
+  RUN_TEST(test_lookup_only_on_connect);
+  return UNITY_END();
+}
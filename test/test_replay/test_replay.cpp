@@ -0,0 +1,284 @@
+// Plays the serial transcripts (_docs/Documentation/transcripts) through
+// src/device.cpp on the fake transport, like replay.py does with a board:
+// every request is answered with the recorded response and the polled
+// power state is checked against the "=" lines. Also reports the host
+// throughput of the poll path.
+#include <unity.h>
+#include <dirent.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "device.h"
+#include "transport.h"
+#include "clock.h"
+
+#ifndef TRANSCRIPT_DIR
+#define TRANSCRIPT_DIR "_docs/Documentation/transcripts"
+#endif
+#define THROUGHPUT_ROUNDS 200
+
+typedef struct
+{
+  uint32_t ms;            // time in the transcript
+  char direction;         // '>', '<' or '='
+  uint32_t baud;
+  std::string data;       // bytes, or the state of '=' lines
+} entry_t;
+
+typedef struct
+{
+  std::string name;
+  BeamerModel model;
+  std::vector<entry_t> entries;
+} transcript_t;
+
+// Low priority BenQ queries behind the power query, not part of the
+// transcripts (BENQ_ANSWERS in replay.py)
+static const char *const BENQ_ANSWERS[][2] = {
+    {"\r*sour=?#\r", "\r\n*SOUR=HDMI#\r\n"},
+    {"\r*ltim=?#\r", "\r\n*LTIM=1234#\r\n"},
+    {"\r*lampm=?#\r", "\r\n*LAMPM=ECO#\r\n"},
+    {"\r*blank=?#\r", "\r\n*BLANK=OFF#\r\n"},
+    {"\r*mute=?#\r", "\r\n*MUTE=OFF#\r\n"},
+    {"\r*freeze=?#\r", "\r\n*FREEZE=OFF#\r\n"},
+};
+
+static std::vector<transcript_t> transcripts;
+
+// Fake projector: answers the expected request with the recorded response
+static BeamerModel replayModel;
+static std::string received;
+static std::string request;
+static std::string answer;
+static uint32_t answeredBytes;
+
+static void replayAnswer(const uint8_t *data, size_t length)
+{
+  received.append((const char *)data, length);
+  if (replayModel == BeamerModel::BENQ)
+  {
+    for (const auto &query : BENQ_ANSWERS)
+    {
+      size_t index;
+      while ((index = received.find(query[0])) != std::string::npos)
+      {
+        received.erase(index, strlen(query[0]));
+        transportFakeReceive((const uint8_t *)query[1], strlen(query[1]));
+      }
+    }
+  }
+  if (!request.empty() && received.compare(0, request.size(), request) == 0)
+  {
+    received.erase(0, request.size());
+    request.clear();
+    transportFakeReceive((const uint8_t *)answer.data(), answer.size());
+    answeredBytes += answer.size();
+  }
+}
+
+static bool loadTranscript(const std::string &path, transcript_t &transcript)
+{
+  FILE *file = fopen(path.c_str(), "r");
+  if (!file)
+  {
+    return false;
+  }
+  transcript.model = BeamerModel::UNKNOWN;
+  char line[512];
+  while (fgets(line, sizeof(line), file))
+  {
+    char *rest;
+    if (strncmp(line, "# model ", 8) == 0)
+    {
+      line[strcspn(line, "\r\n")] = 0;
+      transcript.model = projectorModel(line + 8);
+      continue;
+    }
+    if (line[0] == '#' || line[0] == '\n')
+    {
+      continue;
+    }
+
+    entry_t entry;
+    entry.ms = strtod(line, &rest);
+    while (*rest == ' ')
+    {
+      rest++;
+    }
+    entry.direction = *rest++;
+    if (entry.direction == '=')
+    {
+      rest += strspn(rest, " ");
+      rest[strcspn(rest, "\r\n")] = 0;
+      entry.data = rest;
+    }
+    else
+    {
+      entry.baud = strtoul(rest, &rest, 10);
+      char *end;
+      for (unsigned long b = strtoul(rest, &end, 16); end != rest; b = strtoul(rest, &end, 16))
+      {
+        entry.data += (char)b;
+        rest = end;
+      }
+    }
+    transcript.entries.push_back(entry);
+  }
+  fclose(file);
+  return transcript.model == BeamerModel::BENQ || transcript.model == BeamerModel::CANON;
+}
+
+static const char *stateText(State state)
+{
+  return state == State::ON ? "on" : state == State::OFF ? "off"
+                                                           : "unknown";
+}
+
+// Plays one transcript, returns the number of "=" lines checked. With
+// 'check' unset only the poll path runs (throughput).
+static uint32_t replay(const transcript_t &transcript, bool check)
+{
+  uint32_t checked = 0;
+  replayModel = transcript.model;
+  received.clear();
+  request.clear();
+  transportFakeOnWrite(replayAnswer);
+  deviceBegin(transcript.model, transcript.entries.front().baud);
+  uint32_t start = clockMillis();
+
+  const std::vector<entry_t> &entries = transcript.entries;
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    const entry_t &entry = entries[i];
+    if (entry.direction == '=')
+    {
+      if (check)
+      {
+        // The polled state, a pending power command is reported optimistically
+        const cacheEntry_t &power = cacheEntry(Attribute::POWER);
+        char message[128];
+        snprintf(message, sizeof(message), "%s at %u ms", transcript.name.c_str(), (unsigned int)entry.ms);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(entry.data.c_str(), stateText(power.valid ? (State)power.value : State::UNKNOWN), message);
+        checked++;
+      }
+      continue;
+    }
+    if (entry.direction != '>')
+    {
+      continue;
+    }
+
+    // Requests follow the transcript time, responses belong to the request before
+    if ((int32_t)(start + entry.ms - clockMillis()) > 0)
+    {
+      clockVirtualMillis = start + entry.ms;
+    }
+    request = entry.data;
+    answer.clear();
+    for (size_t r = i + 1; r < entries.size() && entries[r].direction == '<'; r++)
+    {
+      answer += entries[r].data;
+    }
+
+    frame_t on = projectorPowerCommand(transcript.model, State::ON);
+    frame_t off = projectorPowerCommand(transcript.model, State::OFF);
+    if (entry.data.size() == on.length && memcmp(entry.data.data(), on.data, on.length) == 0)
+    {
+      deviceSetPower(State::ON);
+    }
+    else if (entry.data.size() == off.length && memcmp(entry.data.data(), off.data, off.length) == 0)
+    {
+      deviceSetPower(State::OFF);
+    }
+    else
+    {
+      devicePoll();
+    }
+    if (check)
+    {
+      char message[128];
+      snprintf(message, sizeof(message), "%s: request at %u ms not sent", transcript.name.c_str(), (unsigned int)entry.ms);
+      TEST_ASSERT_TRUE_MESSAGE(request.empty(), message);
+      TEST_ASSERT_TRUE_MESSAGE(received.empty(), "unexpected request");
+    }
+  }
+  transportFakeOnWrite(nullptr);
+  return checked;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_transcripts()
+{
+  uint32_t checked = 0;
+  for (const transcript_t &transcript : transcripts)
+  {
+    checked += replay(transcript, true);
+  }
+  char message[64];
+  snprintf(message, sizeof(message), "%u transcripts, %u states checked", (unsigned int)transcripts.size(), (unsigned int)checked);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, checked);
+}
+
+// Time of the poll path on the host per poll and per response byte. The
+// virtual clock does not move with it, timeouts cost only their loop.
+void test_throughput()
+{
+  uint32_t polls = deviceGetStats().polls;
+  answeredBytes = 0;
+  auto begin = std::chrono::steady_clock::now();
+  for (int round = 0; round < THROUGHPUT_ROUNDS; round++)
+  {
+    for (const transcript_t &transcript : transcripts)
+    {
+      replay(transcript, false);
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  polls = deviceGetStats().polls - polls;
+
+  char message[128];
+  snprintf(message, sizeof(message), "%u polls, %u bytes in %.3f s: %.0f polls/s, %.2f MB/s",
+           (unsigned int)polls, (unsigned int)answeredBytes, seconds, polls / seconds, answeredBytes / seconds / 1e6);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, polls);
+}
+
+int main(int argc, char **argv)
+{
+  DIR *dir = opendir(TRANSCRIPT_DIR);
+  if (dir)
+  {
+    for (struct dirent *file = readdir(dir); file; file = readdir(dir))
+    {
+      std::string name = file->d_name;
+      transcript_t transcript;
+      transcript.name = name;
+      if (name.size() > 4 && name.compare(name.size() - 4, 4, ".txt") == 0 && loadTranscript(TRANSCRIPT_DIR "/" + name, transcript))
+      {
+        transcripts.push_back(transcript);
+      }
+    }
+    closedir(dir);
+  }
+  std::sort(transcripts.begin(), transcripts.end(), [](const transcript_t &a, const transcript_t &b)
+            { return a.name < b.name; });
+
+  UNITY_BEGIN();
+  if (transcripts.empty())
+  {
+    printf("No transcripts in %s, run from the project directory\n", TRANSCRIPT_DIR);
+    return 1;
+  }
+  RUN_TEST(test_transcripts);
+  RUN_TEST(test_throughput);
+  return UNITY_END();
+}
@@ -0,0 +1,294 @@
+// Randomized schedules for the timing logic on the virtual clock: task
+// scheduler, cache TTL and button press detection. Every run uses fixed
+// seeds, a failing schedule can be reproduced from the seed.
+#include <unity.h>
+#include "scheduler.h"
+#include "cache.h"
+#include "button.h"
+#include "clock.h"
+
+#define TASKS 6
+#define TASK_MAX_DURATION 5 // in ms, 6 tasks can not use up the shortest period
+#define BUTTON_PIN D3
+#define BUTTON_LONGPRESS 2000
+
+static uint32_t randomBetween(uint32_t min, uint32_t max)
+{
+  return min + (uint32_t)rand() % (max - min + 1);
+}
+
+// Scheduler
+
+static task_t tasks[TASKS];
+static uint32_t durations[TASKS]; // virtual run time of each task in ms
+static uint32_t anchors[TASKS];   // clockMillis() of the run the expected times count from
+static uint32_t sinceAnchor[TASKS];
+static uint32_t maxDeviation;     // max. distance of a run from its expected time in ms
+static uint8_t running;
+
+static void taskBefore(uint8_t index)
+{
+  running = index;
+  task_t &task = tasks[index];
+  uint32_t now = clockMillis();
+  if (task.period > 0 && task.runs > 0)
+  {
+    // Runs keep the period without drifting, jitter stays within a pass
+    int32_t deviation = now - (anchors[index] + sinceAnchor[index] * task.period);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, deviation);
+    if ((uint32_t)deviation > maxDeviation)
+    {
+      maxDeviation = deviation;
+    }
+  }
+  else
+  {
+    anchors[index] = now;
+    sinceAnchor[index] = 0;
+  }
+  sinceAnchor[index]++;
+}
+
+static void taskRun()
+{
+  clockAdvance(durations[running]);
+}
+
+void test_scheduler_random_schedules()
+{
+  schedulerSetHooks(taskBefore, nullptr);
+  srand(28);
+  for (int schedule = 0; schedule < 200; schedule++)
+  {
+    // Some schedules run across the wrap of the ms counter
+    clockVirtualMillis = rand() % 4 ? rand() : UINT32_MAX - randomBetween(0, 5000);
+    uint8_t count = randomBetween(1, TASKS);
+    uint32_t passWork = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+      uint32_t period = rand() % 5 ? randomBetween(50, 2000) : 0;
+      tasks[i] = SCHEDULER_TASK("task", taskRun, period, 0);
+      durations[i] = randomBetween(0, TASK_MAX_DURATION);
+      passWork += durations[i];
+    }
+    maxDeviation = 0;
+
+    uint32_t passes = schedulerGetStats().passes;
+    uint32_t start = clockMillis();
+    while (clockMillis() - start < 20000)
+    {
+      if (rand() % 100 == 0 && tasks[0].runs > 0)
+      {
+        uint8_t i = rand() % count;
+        uint32_t period = randomBetween(50, 2000);
+        schedulerSetPeriod(tasks[i], period);
+        // Due after the new period at the latest, the next run is the new anchor
+        TEST_ASSERT_LESS_OR_EQUAL((int32_t)period, (int32_t)(tasks[i].nextRun - clockMillis()));
+        sinceAnchor[i] = 0;
+        anchors[i] = tasks[i].nextRun;
+      }
+      schedulerRun(tasks, count, 1000);
+    }
+    passes = schedulerGetStats().passes - passes;
+
+    // A task due during a pass waits for the rest of the pass and the next one
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(2 * passWork, maxDeviation);
+    for (uint8_t i = 0; i < count; i++)
+    {
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(2 * passWork, tasks[i].maxLateness);
+      if (tasks[i].period == 0)
+      {
+        TEST_ASSERT_EQUAL_UINT32(passes, tasks[i].runs);
+      }
+    }
+  }
+  schedulerSetHooks(nullptr, nullptr);
+}
+
+void test_scheduler_trigger()
+{
+  clockVirtualMillis = 1000;
+  tasks[0] = SCHEDULER_TASK("task", taskRun, 1000, 0);
+  running = 0;
+  durations[0] = 0;
+  schedulerRun(tasks, 1, 0);
+  clockAdvance(100);
+  schedulerRun(tasks, 1, 0);
+  TEST_ASSERT_EQUAL_UINT32(1, tasks[0].runs);
+
+  // Runs in the next pass, the period counts from there
+  schedulerTrigger(tasks[0]);
+  schedulerRun(tasks, 1, 0);
+  TEST_ASSERT_EQUAL_UINT32(2, tasks[0].runs);
+  TEST_ASSERT_EQUAL_UINT32(2100, tasks[0].nextRun);
+}
+
+void test_scheduler_on_demand()
+{
+  clockVirtualMillis = 1000;
+  tasks[0] = SCHEDULER_TASK("task", taskRun, SCHEDULER_ON_DEMAND, 0);
+  running = 0;
+  durations[0] = 0;
+
+  // Not run and not keeping the scheduler from idling until triggered
+  uint32_t passes = schedulerGetStats().passes;
+  schedulerRun(tasks, 1, 100);
+  schedulerRun(tasks, 1, 100);
+  TEST_ASSERT_EQUAL_UINT32(0, tasks[0].runs);
+  TEST_ASSERT_EQUAL_UINT32(1200, clockMillis());
+
+  schedulerTrigger(tasks[0]);
+  schedulerRun(tasks, 1, 100);
+  schedulerRun(tasks, 1, 100);
+  TEST_ASSERT_EQUAL_UINT32(1, tasks[0].runs);
+  TEST_ASSERT_EQUAL_UINT32(1400, clockMillis());
+  TEST_ASSERT_EQUAL_UINT32(passes + 4, schedulerGetStats().passes);
+}
+
+// Cache
+
+static uint32_t refreshes;
+
+static void requestRefresh()
+{
+  // Only counted, a reader must not get a value it did not accept
+  refreshes++;
+}
+
+void test_cache_random_ttl()
+{
+  bool valid[(size_t)Attribute::COUNT] = {};
+  int32_t values[(size_t)Attribute::COUNT];
+  uint32_t updated[(size_t)Attribute::COUNT];
+
+  cacheBegin(requestRefresh);
+  srand(46);
+  clockVirtualMillis = UINT32_MAX - 100000;
+  for (int step = 0; step < 20000; step++)
+  {
+    Attribute attr = (Attribute)(rand() % (int)Attribute::COUNT);
+    size_t a = (size_t)attr;
+    clockAdvance(randomBetween(0, 3000));
+    if (rand() % 2)
+    {
+      values[a] = rand() % 8;
+      cacheSet(attr, values[a]);
+      valid[a] = true;
+      updated[a] = clockMillis();
+      TEST_ASSERT_EQUAL_UINT32(0, cacheAge(attr));
+      continue;
+    }
+
+    uint32_t maxAge = rand() % 3 ? randomBetween(1, 12000) : 0;
+    uint32_t limit = maxAge ? maxAge : cacheEntry(attr).ttl;
+    bool fresh = valid[a] && clockMillis() - updated[a] <= limit;
+    // Stale values are requested, unless the reader takes the TTL or the
+    // model never reported the attribute
+    bool requested = !fresh && maxAge && (valid[a] || !cacheEntry(attr).optional);
+    uint32_t before = refreshes;
+
+    int32_t value = -1;
+    TEST_ASSERT_EQUAL(fresh, cacheGet(attr, value, maxAge));
+    TEST_ASSERT_EQUAL_UINT32(before + requested, refreshes);
+    if (fresh)
+    {
+      TEST_ASSERT_EQUAL(values[a], value);
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(limit, cacheAge(attr));
+    }
+    else
+    {
+      TEST_ASSERT_EQUAL(-1, value);
+    }
+  }
+  cacheBegin(nullptr);
+}
+
+// Button
+
+// Sets the level with contact bounce, the level is stable after 10 ms
+static void buttonEdge(uint8_t level)
+{
+  for (uint32_t bounces = randomBetween(0, 4); bounces > 0; bounces--)
+  {
+    hostPinLevel(BUTTON_PIN, level);
+    clockAdvance(randomBetween(0, 3));
+    hostPinLevel(BUTTON_PIN, !level);
+    clockAdvance(randomBetween(0, 2));
+  }
+  hostPinLevel(BUTTON_PIN, level);
+}
+
+// Polls like the button task for ms, returns the last event
+static ButtonEvent buttonWait(uint32_t ms, uint8_t &count, uint8_t &events)
+{
+  ButtonEvent last = ButtonEvent::NONE;
+  uint32_t start = clockMillis();
+  while (clockMillis() - start < ms)
+  {
+    uint8_t n;
+    ButtonEvent event = buttonPoll(n);
+    if (event != ButtonEvent::NONE)
+    {
+      last = event;
+      count = n;
+      events++;
+    }
+    clockAdvance(randomBetween(1, 10));
+  }
+  return last;
+}
+
+void test_button_random_presses()
+{
+  hostPinLevel(BUTTON_PIN, HIGH);
+  buttonBegin(BUTTON_PIN, BUTTON_LONGPRESS);
+  srand(31);
+  for (int sequence = 0; sequence < 300; sequence++)
+  {
+    uint8_t count = 0;
+    uint8_t events = 0;
+    if (rand() % 4 == 0)
+    {
+      buttonEdge(LOW);
+      TEST_ASSERT_EQUAL(ButtonEvent::LONG, buttonWait(BUTTON_LONGPRESS + 100, count, events));
+      TEST_ASSERT_EQUAL(1, events);
+      TEST_ASSERT_GREATER_OR_EQUAL_UINT32(BUTTON_LONGPRESS, buttonHeldTime());
+      buttonEdge(HIGH);
+      buttonWait(1000, count, events);
+      TEST_ASSERT_EQUAL(1, events);
+      continue;
+    }
+
+    uint8_t presses = randomBetween(1, 4);
+    for (uint8_t n = 0; n < presses; n++)
+    {
+      buttonEdge(LOW);
+      buttonWait(randomBetween(60, BUTTON_LONGPRESS - 200), count, events);
+      buttonEdge(HIGH);
+      buttonWait(n + 1 < presses ? randomBetween(60, BUTTON_MULTIPRESS_WINDOW - 100) : BUTTON_MULTIPRESS_WINDOW + 100, count, events);
+    }
+    TEST_ASSERT_EQUAL(1, events);
+    TEST_ASSERT_EQUAL(presses, count);
+    TEST_ASSERT_EQUAL_UINT32(0, buttonHeldTime());
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, buttonOverflows());
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_scheduler_random_schedules);
+  RUN_TEST(test_scheduler_trigger);
+  RUN_TEST(test_scheduler_on_demand);
+  RUN_TEST(test_cache_random_ttl);
+  RUN_TEST(test_button_random_presses);
+  return UNITY_END();
+}
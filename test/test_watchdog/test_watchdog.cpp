@@ -0,0 +1,108 @@
+// Loop trace and stall detection of src/watchdog.cpp across simulated
+// resets: RTC memory keeps its content, watchdogBegin() is the next boot
+#include <unity.h>
+#include "watchdog.h"
+#include "clock.h"
+
+enum : uint8_t
+{
+  PHASE_SHORT = 1,
+  PHASE_LONG,
+  PHASE_INNER
+};
+
+static void phase(uint8_t id, uint32_t duration)
+{
+  watchdogEnter(id);
+  clockAdvance(duration);
+  watchdogExit(id);
+}
+
+static uint8_t traced(const watchdogData_t &data, TraceEvent event)
+{
+  uint8_t count = 0;
+  for (const traceEntry_t &entry : data.trace)
+  {
+    if (entry.event == event && entry.time != 0)
+    {
+      count++;
+    }
+  }
+  return count;
+}
+
+void setUp()
+{
+  clockVirtualMillis = 1000;
+  watchdogBegin();
+}
+
+void tearDown()
+{
+}
+
+void test_short_phases_do_not_flood_the_trace()
+{
+  phase(PHASE_LONG, WATCHDOG_TRACE_THRESHOLD);
+  for (int n = 0; n < 10 * WATCHDOG_TRACE_SIZE; n++)
+  {
+    phase(PHASE_SHORT, 1);
+  }
+  const watchdogData_t &data = watchdogCurrent();
+  TEST_ASSERT_EQUAL_UINT8(1, traced(data, TraceEvent::EXIT));
+  TEST_ASSERT_EQUAL_UINT8(1, traced(data, TraceEvent::BOOT));
+  TEST_ASSERT_EQUAL_UINT16(0, data.openDepth);
+}
+
+void test_hang_is_recorded_as_stall()
+{
+  uint32_t stalls = watchdogCurrent().stallCount;
+  watchdogEnter(PHASE_LONG);
+  clockAdvance(5);
+  watchdogEnter(PHASE_INNER);
+  uint32_t start = clockMillis();
+  clockAdvance(3000);
+
+  // Watchdog reset inside the inner phase
+  watchdogBegin();
+  const watchdogData_t &data = watchdogCurrent();
+  TEST_ASSERT_EQUAL_UINT32(stalls + 1, data.stallCount);
+  const stallEntry_t &stall = data.stalls[(data.stallHead + WATCHDOG_STALL_SIZE - 1) % WATCHDOG_STALL_SIZE];
+  TEST_ASSERT_EQUAL_UINT8(PHASE_INNER, stall.phase);
+  TEST_ASSERT_EQUAL_UINT32(start, stall.time);
+  TEST_ASSERT_EQUAL_UINT32(WATCHDOG_DURATION_UNKNOWN, stall.duration);
+  TEST_ASSERT_TRUE(watchdogHasPrevious());
+  TEST_ASSERT_EQUAL_UINT16(2, watchdogPrevious().openDepth);
+  TEST_ASSERT_EQUAL_UINT16(0, data.openDepth);
+}
+
+void test_intentional_reset_is_no_stall()
+{
+  uint32_t stalls = watchdogCurrent().stallCount;
+  uint32_t resets = ESP.resets;
+  watchdogEnter(PHASE_LONG);
+  watchdogReset();
+  TEST_ASSERT_EQUAL_UINT32(resets + 1, ESP.resets);
+
+  watchdogBegin();
+  TEST_ASSERT_EQUAL_UINT32(stalls, watchdogCurrent().stallCount);
+  TEST_ASSERT_EQUAL_UINT8(1, traced(watchdogPrevious(), TraceEvent::RESET));
+  TEST_ASSERT_EQUAL_UINT16(0, watchdogPrevious().openDepth);
+}
+
+void test_long_phase_is_recorded_as_stall()
+{
+  uint32_t stalls = watchdogCurrent().stallCount;
+  phase(PHASE_LONG, WATCHDOG_STALL_THRESHOLD + 1);
+  TEST_ASSERT_EQUAL_UINT32(stalls + 1, watchdogCurrent().stallCount);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_short_phases_do_not_flood_the_trace);
+  RUN_TEST(test_hang_is_recorded_as_stall);
+  RUN_TEST(test_intentional_reset_is_no_stall);
+  RUN_TEST(test_long_phase_is_recorded_as_stall);
+  return UNITY_END();
+}